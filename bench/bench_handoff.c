@@ -0,0 +1,69 @@
+/* Cost of handing a sample from sampler thread to GTK thread: seqlock
+ * write and read of gpu_stats, with and without a concurrent writer, and
+ * sample ring push and drain. */
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include "stats_seqlock.h"
+#include "sample_ring.h"
+
+#define ROUNDS (1 << 21)
+
+static struct stats_seqlock seqlock;
+static struct sample_ring ring;
+static atomic_bool stop;
+
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static void *writer(void *arg) {
+	(void)arg;
+	struct gpu_stats s = {0};
+	while(!atomic_load_explicit(&stop, memory_order_relaxed)) {
+		s.sample_time_us++;
+		stats_seqlock_write(&seqlock, &s);
+	}
+	return NULL;
+}
+
+int main(void) {
+	struct gpu_stats in = {0}, out;
+	unsigned int sink = 0;
+
+	uint64_t start = monotonic_ns();
+	for(unsigned int i = 0; i < ROUNDS; ++i) {
+		in.sample_time_us = i;
+		stats_seqlock_write(&seqlock, &in);
+		sink += stats_seqlock_read(&seqlock, &out);
+	}
+	printf("%-40s %8.1f ns\n", "seqlock write + read", (double)(monotonic_ns() - start) / ROUNDS);
+
+	pthread_t thread;
+	pthread_create(&thread, NULL, writer, NULL);
+	start = monotonic_ns();
+	for(unsigned int i = 0; i < ROUNDS; ++i) {
+		sink += stats_seqlock_read(&seqlock, &out);
+	}
+	const uint64_t elapsed = monotonic_ns() - start;
+	atomic_store(&stop, true);
+	pthread_join(thread, NULL);
+	printf("%-40s %8.1f ns\n", "seqlock read, writer running", (double)elapsed / ROUNDS);
+
+	// a second of samples at a high rate per chart column
+	struct sample window[SAMPLE_RING_SIZE];
+	const struct sample s = { .gpu_pipe = 50, .shader_clock = 30 };
+	start = monotonic_ns();
+	for(unsigned int i = 0; i < ROUNDS; i += 256) {
+		for(unsigned int j = 0; j < 256; ++j) {
+			sample_ring_push(&ring, &s);
+		}
+		sink += (unsigned int)sample_ring_drain(&ring, window, SAMPLE_RING_SIZE);
+	}
+	printf("%-40s %8.1f ns\n", "sample ring push + drain", (double)(monotonic_ns() - start) / ROUNDS);
+
+	return sink == 0;
+}
@@ -0,0 +1,132 @@
+/* End-to-end ingest throughput: a thread writes radeontop dump lines into a
+ * pipe as fast as it can, the sampler side reads them with line_reader,
+ * parses every line and publishes it to seqlock and sample ring, the way
+ * the plugin does per sample. */
+#define _GNU_SOURCE	// pipe2, F_SETPIPE_SZ
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "line_reader.h"
+#include "radeontop_parse.h"
+#include "stats_seqlock.h"
+#include "sample_ring.h"
+
+#define LINES 2000000
+#define DISTINCT 1024
+
+static char text[DISTINCT * 320];
+static size_t text_len;
+static size_t lines_in_text;
+
+static struct line_reader lines;
+static struct stats_seqlock seqlock;
+static struct sample_ring ring;
+
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static void make_text(void) {
+	srand(1);
+	for(int i = 0; i < DISTINCT; ++i) {
+		const float gpu = (float)(rand() % 10000) / 100.0f;
+		text_len += (size_t)snprintf(text + text_len, sizeof(text) - text_len,
+			"%d.%d: bus 03, gpu %.2f%%, ee 0.00%%, vgt %.2f%%, ta %.2f%%, sx %.2f%%, "
+			"sh %.2f%%, spi %.2f%%, sc %.2f%%, pa %.2f%%, db %.2f%%, cb %.2f%%, "
+			"vram %.2f%% %.2fmb, gtt %.2f%% %.2fmb, mclk 100.00%% 1.750ghz, "
+			"sclk %.2f%% %.3fghz\n",
+			1700000000 + i, rand() % 1000000, gpu, gpu * 0.3f, gpu * 0.8f, gpu * 0.6f,
+			gpu * 0.9f, gpu * 0.9f, gpu * 0.5f, gpu * 0.2f, gpu * 0.6f, gpu * 0.6f,
+			5.72, 468.35, 0.47, 38.53, gpu, gpu / 40.0f);
+	}
+	lines_in_text = DISTINCT;
+}
+
+static void *writer(void *arg) {
+	const int fd = *(int *)arg;
+	for(size_t n = 0; n < LINES; n += lines_in_text) {
+		const char *p = text;
+		size_t left = text_len;
+		while(left) {
+			ssize_t r = write(fd, p, left);
+			if(r < 0) {
+				if(errno == EINTR) {
+					continue;
+				}
+				perror("write");
+				exit(1);
+			}
+			p += r;
+			left -= (size_t)r;
+		}
+	}
+	close(fd);
+	return NULL;
+}
+
+int main(void) {
+	make_text();
+
+	int fds[2];
+	if(pipe2(fds, O_CLOEXEC) != 0) {
+		perror("pipe2");
+		return 1;
+	}
+	fcntl(fds[0], F_SETPIPE_SZ, 1 << 20);	// best effort, as plugin gets default size
+
+	line_reader_init(&lines);
+	pthread_t thread;
+	pthread_create(&thread, NULL, writer, &fds[1]);
+
+	struct sample window[SAMPLE_RING_SIZE];
+	uint64_t published = 0, errors = 0, bytes = 0;
+	const uint64_t start = monotonic_ns();
+	while(1) {
+		const ssize_t r = line_reader_fill(&lines, fds[0]);
+		if(r <= 0) {
+			break;
+		}
+		bytes += (uint64_t)r;
+
+		const char *line;
+		size_t len;
+		while(line_reader_next(&lines, &line, &len)) {
+			struct gpu_stats stats;
+			if(!radeontop_parse_line(line, len, &stats)) {
+				errors++;
+				continue;
+			}
+			stats_seqlock_write(&seqlock, &stats);
+			const struct sample s = {
+				.time_us = stats.sample_time_us,
+				.gpu_pipe = stats.busy[GPU_BLOCK_GPU],
+				.shader_clock = stats.sclk,
+			};
+			if(!sample_ring_push(&ring, &s)) {
+				// stands in for GTK thread draining a chart column
+				sample_ring_drain(&ring, window, SAMPLE_RING_SIZE);
+				sample_ring_push(&ring, &s);
+			}
+			published++;
+		}
+	}
+	const double seconds = (double)(monotonic_ns() - start) / 1e9;
+	pthread_join(thread, NULL);
+	close(fds[0]);
+
+	printf("%-40s %8.0f lines/s\n", "pipe -> line_reader -> parse -> publish", published / seconds);
+	printf("%-40s %8.1f ns\n", "  per line", seconds * 1e9 / (double)published);
+	printf("%-40s %8.1f MB/s\n", "  input", (double)bytes / seconds / 1e6);
+	if(errors) {
+		fprintf(stderr, "%llu lines didn't parse\n", (unsigned long long)errors);
+		return 1;
+	}
+	return 0;
+}
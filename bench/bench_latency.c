@@ -0,0 +1,221 @@
+/* Write-to-publication latency and sampler CPU time of the radeontop ingest
+ * path: fake-radeontop stamps every line with the time it writes it, and
+ * the loop below runs the sampler's radeontop_child, radeontop_ingest,
+ * sample_timing and seqlock publication on it, as the plugin does per GPU.
+ * Latency is taken once the sample is published in gpu_stats; CPU time is
+ * that of this thread only, fake-radeontop's isn't counted.
+ * Then CPU time of sampler and fake-radeontop both, with the chart visible
+ * and paused (radeontop_child_pause(), as for a hidden chart), and how
+ * long the first sample takes after resume.
+ * Run from source directory: bench/bench_latency [seconds per scenario] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "radeontop_child.h"
+#include "radeontop_ingest.h"
+#include "stats_seqlock.h"
+
+#define MAX_RATE 10000
+#define PAUSE_RATE 1000
+
+struct scenario {
+	const char *name;
+	unsigned int rate;	// lines per second
+	const char *extra[5];	// more fake-radeontop options
+};
+
+static const struct scenario scenarios[] = {
+	{ "100 lines/s", 100, { NULL } },
+	{ "1000 lines/s", 1000, { NULL } },
+	{ "10000 lines/s", 10000, { NULL } },
+	{ "1000 lines/s, 200 more every 250 ms", 1000, { "-B", "200", "-P", "250", NULL } },
+	{ "1000 lines/s, 500 us jitter, 1% cut", 1000, { "-j", "500", "-x", "1", NULL } },
+};
+
+static struct stats_seqlock seqlock;
+static int32_t latency_us[MAX_RATE * 60 * 2];
+static size_t latencies;
+
+static uint64_t clock_ns(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static int compare(const void *a, const void *b) {
+	const int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+	return (x > y) - (x < y);
+}
+
+static double percentile(size_t n, double p) {
+	return n ? latency_us[(size_t)((double)(n - 1) * p)] : 0;
+}
+
+struct sampler {
+	struct radeontop_child child;
+	struct radeontop_ingest ingest;
+	struct sample_timing timing;
+	struct stderr_ring stderr_ring;
+};
+
+static bool spawn(struct sampler *s, const char *const *cmdline) {
+	*s = (struct sampler){0};
+	if(radeontop_child_spawn(&s->child, cmdline) != 0) {
+		fprintf(stderr, "can't run ./fake-radeontop, build it with make tools\n");
+		return false;
+	}
+	radeontop_ingest_start(&s->ingest);
+	return true;
+}
+
+/* waits up to timeout_ms for fake-radeontop and publishes what it wrote;
+ * returns samples published, or -1 once it has exited */
+static int pump(struct sampler *s, int timeout_ms) {
+	struct pollfd fds[3] = {
+		{ .fd = s->child.out_fd, .events = POLLIN },
+		{ .fd = s->child.err_fd, .events = POLLIN },
+		{ .fd = s->child.pidfd, .events = POLLIN },
+	};
+	const int ready = poll(fds, 3, timeout_ms);
+	if(ready <= 0) {
+		return ready == 0 || errno == EINTR ? 0 : -1;
+	}
+	if(fds[1].revents && s->child.err_fd >= 0) {
+		radeontop_child_drain_stderr(&s->child, &s->stderr_ring);
+	}
+	if(!fds[0].revents && !fds[2].revents) {
+		return 0;
+	}
+	int published = 0;
+	ssize_t r;
+	while((r = radeontop_ingest_fill(&s->ingest, s->child.out_fd)) > 0) {
+		struct gpu_stats stats;
+		while(radeontop_ingest_next(&s->ingest, &stats)) {
+			sample_timing_update(&s->timing, &stats);
+			stats_seqlock_write(&seqlock, &stats);
+			const uint64_t published_us = clock_ns(CLOCK_REALTIME) / 1000;
+			if(latencies < sizeof(latency_us) / sizeof(latency_us[0])) {
+				latency_us[latencies++] = (int32_t)((int64_t)published_us - (int64_t)stats.sample_time_us);
+			}
+			published++;
+		}
+	}
+	return r == 0 || (r < 0 && errno != EAGAIN) ? -1 : published;
+}
+
+static double children_cpu_s(void) {
+	struct rusage ru;
+	getrusage(RUSAGE_CHILDREN, &ru);
+	return (double)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) +
+		(double)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+/* runs fake-radeontop until it has written its lines; returns false if
+ * it couldn't be run */
+static bool run(const struct scenario *sc, unsigned int seconds) {
+	char rate[16], count[16];
+	snprintf(rate, sizeof(rate), "%u", sc->rate);
+	snprintf(count, sizeof(count), "%u", sc->rate * seconds);
+	const char *cmdline[16] = { "./fake-radeontop", "-r", rate, "-n", count };
+	size_t argc = 5;
+	for(size_t i = 0; sc->extra[i]; ++i) {
+		cmdline[argc++] = sc->extra[i];
+	}
+	cmdline[argc] = NULL;
+
+	struct sampler s;
+	if(!spawn(&s, cmdline)) {
+		return false;
+	}
+
+	latencies = 0;
+	const uint64_t cpu_start = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+	uint64_t progress_ns = clock_ns(CLOCK_MONOTONIC);
+	int r;
+	while((r = pump(&s, 5000)) >= 0) {
+		const uint64_t now_ns = clock_ns(CLOCK_MONOTONIC);
+		if(r > 0) {
+			progress_ns = now_ns;
+		} else if(now_ns - progress_ns >= 5000000000ull) {
+			fprintf(stderr, "fake-radeontop stopped writing\n");
+			break;
+		}
+	}
+	const uint64_t cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+	radeontop_child_stop(&s.child);
+
+	const size_t n = latencies;
+	qsort(latency_us, n, sizeof(latency_us[0]), compare);
+	printf("%-38s %7zu %7.0f %7.0f %7.0f %7.0f %9.3f %6llu\n", sc->name, n,
+			percentile(n, 0.5), percentile(n, 0.99), percentile(n, 0.999),
+			percentile(n, 1), n ? cpu_ns / 1e6 * 1000 / (double)n : 0,
+			(unsigned long long)s.ingest.parse_errors);
+	return true;
+}
+
+/* fake-radeontop at PAUSE_RATE lines/s for given seconds, paused right
+ * after start if paused; then resumed, for first sample after resume */
+static bool run_paused(bool paused, unsigned int seconds) {
+	char rate[16];
+	snprintf(rate, sizeof(rate), "%u", PAUSE_RATE);
+	const char *cmdline[] = { "./fake-radeontop", "-r", rate, NULL };
+	const double children_start = children_cpu_s();
+	struct sampler s;
+	if(!spawn(&s, cmdline)) {
+		return false;
+	}
+	radeontop_child_pause(&s.child, paused);
+
+	size_t samples = 0;
+	const uint64_t cpu_start = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+	const uint64_t end_ns = clock_ns(CLOCK_MONOTONIC) + seconds * 1000000000ull;
+	uint64_t now_ns;
+	while((now_ns = clock_ns(CLOCK_MONOTONIC)) < end_ns) {
+		const int r = pump(&s, (int)((end_ns - now_ns) / 1000000) + 1);
+		if(r < 0) {
+			fprintf(stderr, "fake-radeontop exited\n");
+			break;
+		}
+		samples += (size_t)r;
+	}
+	const uint64_t cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+
+	radeontop_child_pause(&s.child, false);
+	const uint64_t resume_ns = clock_ns(CLOCK_MONOTONIC);
+	int r;
+	while((r = pump(&s, 1000)) == 0 && clock_ns(CLOCK_MONOTONIC) - resume_ns < 5000000000ull) {
+	}
+	const double resume_ms = r > 0 ? (double)(clock_ns(CLOCK_MONOTONIC) - resume_ns) / 1e6 : -1;
+	radeontop_child_stop(&s.child);
+
+	printf("%-38s %7zu %9.3f %9.3f %9.2f\n", paused ? "paused" : "visible", samples,
+			(double)cpu_ns / 1e9, children_cpu_s() - children_start, resume_ms);
+	return true;
+}
+
+int main(int argc, char **argv) {
+	const unsigned int seconds = argc > 1 ? (unsigned int)atoi(argv[1]) : 2;
+	if(seconds < 1 || seconds > 60) {
+		fprintf(stderr, "usage: %s [seconds per scenario, 1 to 60]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%-38s %7s %7s %7s %7s %7s %9s %6s\n", "write to publication, us", "lines",
+			"p50", "p99", "p99.9", "max", "cpu ms/1k", "errors");
+	for(size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i) {
+		if(!run(&scenarios[i], seconds)) {
+			return 1;
+		}
+	}
+
+	printf("\n%-38s %7s %9s %9s %9s\n", "1000 lines/s, cpu s", "lines",
+			"sampler", "radeontop", "resume ms");
+	if(!run_paused(false, seconds) || !run_paused(true, seconds)) {
+		return 1;
+	}
+	return 0;
+}
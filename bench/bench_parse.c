@@ -0,0 +1,105 @@
+/* radeontop_parse_line() against the strstr/sscanf decoding it replaced,
+ * which fetched only gpu and sclk, and the same way extended to all fields
+ * the parser decodes. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "radeontop_parse.h"
+
+#define LINES 4096
+#define LINE_SIZE 320
+#define ROUNDS 200
+
+static char lines[LINES][LINE_SIZE];
+static size_t lengths[LINES];
+
+static const char *const labels[] = {
+	"gpu ", "ee ", "vgt ", "ta ", "sx ", "sh ", "spi ", "sc ", "pa ", "db ", "cb ",
+	"vram ", "gtt ", "mclk ", "sclk ",
+};
+
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/* as in gkrellmradeontop.c before radeontop_parse.c */
+static float radeontop_extract_stat(const char *str, const char *label) {
+	const char *m = strstr(str, label);
+	if(!m) {
+		fprintf(stderr, "no %s marker in radeontop output, output is \"%s\"\n", label, str);
+	} else {
+		float v = 0;
+		char fmt[64];
+		snprintf(fmt, sizeof(fmt), "%s %%f%%%%", label);
+		if(sscanf(m, fmt, &v) == 1) {
+			return v;
+		} else {
+			fprintf(stderr, "can't decode %s from string %s\n", label, m);
+		}
+	}
+
+	return 0;
+}
+
+static void make_lines(void) {
+	srand(1);
+	for(int i = 0; i < LINES; ++i) {
+		const float gpu = (float)(rand() % 10000) / 100.0f;
+		lengths[i] = (size_t)snprintf(lines[i], LINE_SIZE,
+			"%d.%d: bus 03, gpu %.2f%%, ee 0.00%%, vgt %.2f%%, ta %.2f%%, sx %.2f%%, "
+			"sh %.2f%%, spi %.2f%%, sc %.2f%%, pa %.2f%%, db %.2f%%, cb %.2f%%, "
+			"vram %.2f%% %.2fmb, gtt %.2f%% %.2fmb, mclk 100.00%% 1.750ghz, "
+			"sclk %.2f%% %.3fghz",
+			1700000000 + i, rand() % 1000000, gpu, gpu * 0.3f, gpu * 0.8f, gpu * 0.6f,
+			gpu * 0.9f, gpu * 0.9f, gpu * 0.5f, gpu * 0.2f, gpu * 0.6f, gpu * 0.6f,
+			5.72, 468.35, 0.47, 38.53, gpu, gpu / 40.0f);
+	}
+}
+
+static void report(const char *name, uint64_t elapsed_ns, float sink) {
+	const double n = (double)LINES * ROUNDS;
+	printf("%-40s %8.1f ns %10.0f lines/s\n", name, (double)elapsed_ns / n, n * 1e9 / (double)elapsed_ns);
+	if(sink < 0) {
+		puts("");	// keeps sink alive
+	}
+}
+
+int main(void) {
+	make_lines();
+	float sink = 0;
+
+	uint64_t start = monotonic_ns();
+	for(int r = 0; r < ROUNDS; ++r) {
+		for(int i = 0; i < LINES; ++i) {
+			struct gpu_stats s;
+			if(radeontop_parse_line(lines[i], lengths[i], &s)) {
+				sink += s.busy[GPU_BLOCK_GPU] + s.sclk;
+			}
+		}
+	}
+	report("radeontop_parse_line, all fields", monotonic_ns() - start, sink);
+
+	start = monotonic_ns();
+	for(int r = 0; r < ROUNDS; ++r) {
+		for(int i = 0; i < LINES; ++i) {
+			sink += radeontop_extract_stat(lines[i], "gpu ");
+			sink += radeontop_extract_stat(lines[i], "sclk ");
+		}
+	}
+	report("strstr + sscanf, gpu and sclk", monotonic_ns() - start, sink);
+
+	start = monotonic_ns();
+	for(int r = 0; r < ROUNDS / 4; ++r) {
+		for(int i = 0; i < LINES; ++i) {
+			for(size_t l = 0; l < sizeof(labels)/sizeof(labels[0]); ++l) {
+				sink += radeontop_extract_stat(lines[i], labels[l]);
+			}
+		}
+	}
+	report("strstr + sscanf, all fields", (monotonic_ns() - start) * 4, sink);
+
+	return 0;
+}
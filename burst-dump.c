@@ -0,0 +1,61 @@
+/* Prints a burst trace (gpuN-<time>.burst in plugin data directory) as CSV,
+ * one line per sample. Empty cells are fields backend didn't report. */
+#include <stdio.h>
+#include <stdlib.h>
+#include "burst.h"
+
+static const char *const block_names[GPU_BLOCK_COUNT] = {
+	"gpu", "ee", "vgt", "ta", "sx", "sh", "spi", "sc", "pa", "db", "cb",
+};
+
+static void cell(uint32_t valid, enum gpu_field field, const char *fmt, double v) {
+	putchar(',');
+	if(valid & GPU_FIELD_BIT(field)) {
+		printf(fmt, v);
+	}
+}
+
+int main(int argc, char **argv) {
+	if(argc != 2) {
+		fprintf(stderr, "usage: %s file.burst\n", argv[0]);
+		return 1;
+	}
+	FILE *f = fopen(argv[1], "rb");
+	if(!f) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	struct burst_header h;
+	if(fread(&h, sizeof(h), 1, f) != 1 || h.magic != BURST_MAGIC) {
+		fprintf(stderr, "%s is not a burst trace\n", argv[1]);
+		return 1;
+	}
+	if(h.version != BURST_VERSION || h.record_size != sizeof(struct burst_record)) {
+		fprintf(stderr, "%s is burst trace version %u, only version %u is read\n",
+				argv[1], h.version, BURST_VERSION);
+		return 1;
+	}
+	fprintf(stderr, "bus %02x, %u samples, %u didn't fit\n", h.bus, h.count, h.overflow);
+
+	printf("time_us,latency_us");
+	for(int i = 0; i < GPU_BLOCK_COUNT; ++i) {
+		printf(",%s", block_names[i]);
+	}
+	printf(",vram_mb,gtt_mb,sclk_mhz,mclk_mhz\n");
+
+	struct burst_record r;
+	for(uint32_t n = 0; n < h.count && fread(&r, sizeof(r), 1, f) == 1; ++n) {
+		printf("%llu,%d", (unsigned long long)(h.start_us + r.offset_us), r.latency_us);
+		for(int i = 0; i < GPU_BLOCK_COUNT; ++i) {
+			cell(r.valid, (enum gpu_field)i, "%.2f", r.busy[i] / 100.0);
+		}
+		cell(r.valid, GPU_FIELD_VRAM, "%.0f", r.vram_mb);
+		cell(r.valid, GPU_FIELD_GTT, "%.0f", r.gtt_mb);
+		cell(r.valid, GPU_FIELD_SCLK, "%.0f", r.sclk_mhz);
+		cell(r.valid, GPU_FIELD_MCLK, "%.0f", r.mclk_mhz);
+		putchar('\n');
+	}
+	fclose(f);
+	return 0;
+}
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "burst.h"
+
+void burst_reset(struct burst *b) {
+	memset(&b->header, 0, sizeof(b->header));
+	b->header.magic = BURST_MAGIC;
+	b->header.version = BURST_VERSION;
+	b->header.record_size = sizeof(struct burst_record);
+}
+
+/* v * scale rounded, clamped to 0 ... max; NaN is 0 */
+static uint32_t fixed(float v, float scale, uint32_t max) {
+	v = v * scale + 0.5f;
+	return !(v > 0) ? 0 : v >= (float)max ? max : (uint32_t)v;
+}
+
+void burst_add(struct burst *b, const struct gpu_stats *s) {
+	struct burst_header *h = &b->header;
+	if(h->count == BURST_MAX_SAMPLES) {
+		h->overflow++;
+		return;
+	}
+	if(!h->count) {
+		h->start_us = s->sample_time_us;
+		h->bus = s->bus;
+	}
+
+	struct burst_record *r = &b->records[h->count++];
+	r->offset_us = (uint32_t)(s->sample_time_us - h->start_us);
+	r->latency_us = s->latency_us;
+	for(int i = 0; i < GPU_BLOCK_COUNT; ++i) {
+		r->busy[i] = (uint16_t)fixed(s->busy[i], 100.0f, UINT16_MAX);
+	}
+	r->sclk_mhz = (uint16_t)fixed(s->sclk_ghz, 1000.0f, UINT16_MAX);
+	r->mclk_mhz = (uint16_t)fixed(s->mclk_ghz, 1000.0f, UINT16_MAX);
+	r->reserved = 0;
+	r->vram_mb = fixed(s->vram_mb, 1.0f, UINT32_MAX);
+	r->gtt_mb = fixed(s->gtt_mb, 1.0f, UINT32_MAX);
+	r->valid = s->valid & (GPU_FIELD_BIT(GPU_FIELD_SCLK + 1) - 1);
+}
+
+int burst_write(const struct burst *b, const char *path) {
+	FILE *f = fopen(path, "wb");
+	if(!f) {
+		fprintf(stderr, "can't create %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	const size_t n = b->header.count;
+	if(fwrite(&b->header, sizeof(b->header), 1, f) != 1 ||
+			fwrite(b->records, sizeof(b->records[0]), n, f) != n) {
+		fprintf(stderr, "can't write %s: %s\n", path, strerror(errno));
+		fclose(f);
+		return -1;
+	}
+	if(fclose(f) != 0) {
+		fprintf(stderr, "can't write %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
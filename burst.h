@@ -0,0 +1,56 @@
+#ifndef BURST_H
+#define BURST_H
+
+#include <stdint.h>
+#include "gpu_stats.h"
+
+/* Short high-rate trace, captured into a fixed buffer and written once
+ * capture is over.
+ *
+ * File layout (native endianness):
+ *   struct burst_header
+ *   struct burst_record[count]
+ * Percentages are stored in 0.01 % units, clocks in MHz, memory in MiB,
+ * rounded and clamped to what the field holds (655.35 %, 65535 MHz);
+ * fields not in valid were not reported by backend and are 0. Version 1
+ * had 16 bit memory fields, which saturated at 64 GiB. */
+
+#define BURST_MAGIC 0x54535242	// "BRST"
+#define BURST_VERSION 2
+#define BURST_MAX_SAMPLES 4096
+
+struct burst_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t record_size;
+	uint32_t count;
+	uint32_t overflow;	// samples that didn't fit
+	uint64_t start_us;	// wall clock of first sample
+	uint32_t bus;
+	uint32_t reserved;
+};
+
+struct burst_record {
+	uint32_t offset_us;	// sample time since start_us
+	int32_t latency_us;
+	uint16_t busy[GPU_BLOCK_COUNT];
+	uint16_t sclk_mhz, mclk_mhz;
+	uint16_t reserved;
+	uint32_t vram_mb, gtt_mb;
+	uint32_t valid;	// GPU_FIELD_BIT() of sample, up to GPU_FIELD_SCLK
+};
+
+struct burst {
+	struct burst_header header;
+	struct burst_record records[BURST_MAX_SAMPLES];
+};
+
+void burst_reset(struct burst *b);
+
+/* stores sample; doesn't allocate nor do I/O */
+void burst_add(struct burst *b, const struct gpu_stats *s);
+
+/* returns 0 on success */
+int burst_write(const struct burst *b, const char *path);
+
+#endif
@@ -0,0 +1,30 @@
+#include <ctype.h>
+#include <string.h>
+#include "cmdline.h"
+
+void cmdline_split(const char **out, size_t max, char *buf, const char *in) {
+	// TODO add support for quoted arguments with spaces inside
+	strcpy(buf, in);
+	size_t len = strlen(buf);
+	size_t idx = 0, cur_len = 0;
+	for(size_t i = 0; i < len+1; ++i) {
+		if(buf[i] == '\0' || isspace((unsigned char)buf[i])) {
+			buf[i] = '\0';
+			if(cur_len > 0) {
+				if(idx < max) {
+					out[idx] = &buf[i-cur_len];
+				}
+				idx++;
+			}
+			cur_len = 0;
+			continue;
+		}
+
+		cur_len++;
+	}
+	if(idx < max) {
+		out[idx] = 0;
+	} else {
+		out[max-1] = 0;
+	}
+}
@@ -0,0 +1,10 @@
+#ifndef CMDLINE_H
+#define CMDLINE_H
+
+#include <stddef.h>
+
+/* Splits in by whitespace into buf (at least strlen(in) + 1 bytes) and
+ * fills out with up to max - 1 pointers into it, NULL-terminated */
+void cmdline_split(const char **out, size_t max, char *buf, const char *in);
+
+#endif
@@ -0,0 +1,112 @@
+/* Context switches per second of a running process, by thread.
+ *
+ * Compares sampling in a thread with sampling in gkrellm main loop
+ * (main_loop config option): run gkrellm in each mode with the same
+ * backend and rate, e.g. fake-radeontop -r 100, and measure its pid.
+ * Counts come from voluntary_ctxt_switches and nonvoluntary_ctxt_switches
+ * of /proc/<pid>/task/<tid>/status. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#define MAX_TASKS 256
+
+struct task {
+	int tid;
+	char comm[32];
+	unsigned long voluntary, involuntary;
+};
+
+static void usage(const char *argv0) {
+	fprintf(stderr, "usage: %s [-s seconds] pid\n", argv0);
+	exit(1);
+}
+
+static int read_task(int pid, int tid, struct task *t) {
+	char path[64], line[128];
+	t->tid = tid;
+	t->comm[0] = '\0';
+	t->voluntary = t->involuntary = 0;
+
+	snprintf(path, sizeof(path), "/proc/%d/task/%d/comm", pid, tid);
+	FILE *f = fopen(path, "r");
+	if(!f) {
+		return -1;
+	}
+	if(fgets(t->comm, sizeof(t->comm), f)) {
+		t->comm[strcspn(t->comm, "\n")] = '\0';
+	}
+	fclose(f);
+
+	snprintf(path, sizeof(path), "/proc/%d/task/%d/status", pid, tid);
+	f = fopen(path, "r");
+	if(!f) {
+		return -1;
+	}
+	while(fgets(line, sizeof(line), f)) {
+		sscanf(line, "voluntary_ctxt_switches: %lu", &t->voluntary);
+		sscanf(line, "nonvoluntary_ctxt_switches: %lu", &t->involuntary);
+	}
+	fclose(f);
+	return 0;
+}
+
+static size_t read_tasks(int pid, struct task *tasks) {
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%d/task", pid);
+	DIR *d = opendir(path);
+	if(!d) {
+		perror(path);
+		exit(1);
+	}
+	size_t n = 0;
+	struct dirent *e;
+	while((e = readdir(d)) && n < MAX_TASKS) {
+		const int tid = atoi(e->d_name);
+		if(tid > 0 && read_task(pid, tid, &tasks[n]) == 0) {
+			n++;
+		}
+	}
+	closedir(d);
+	return n;
+}
+
+int main(int argc, char **argv) {
+	unsigned int seconds = 10;
+	int c;
+	while((c = getopt(argc, argv, "s:")) != -1) {
+		switch(c) {
+		case 's': seconds = (unsigned int)atoi(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+	if(optind + 1 != argc || !seconds) {
+		usage(argv[0]);
+	}
+	const int pid = atoi(argv[optind]);
+
+	static struct task before[MAX_TASKS], after[MAX_TASKS];
+	const size_t nbefore = read_tasks(pid, before);
+	sleep(seconds);
+	const size_t nafter = read_tasks(pid, after);
+
+	// threads that started or ended meanwhile are left out
+	double total_voluntary = 0, total_involuntary = 0;
+	printf("%8s %-16s %12s %12s\n", "tid", "comm", "voluntary/s", "involunt./s");
+	for(size_t i = 0; i < nafter; ++i) {
+		for(size_t j = 0; j < nbefore; ++j) {
+			if(before[j].tid != after[i].tid) {
+				continue;
+			}
+			const double v = (double)(after[i].voluntary - before[j].voluntary) / seconds;
+			const double nv = (double)(after[i].involuntary - before[j].involuntary) / seconds;
+			printf("%8d %-16s %12.1f %12.1f\n", after[i].tid, after[i].comm, v, nv);
+			total_voluntary += v;
+			total_involuntary += nv;
+		}
+	}
+	printf("%8s %-16s %12.1f %12.1f\n", "", "total", total_voluntary, total_involuntary);
+	return 0;
+}
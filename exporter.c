@@ -0,0 +1,455 @@
+#define _GNU_SOURCE	// accept4, MSG_MORE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <locale.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "exporter.h"
+
+#define METRIC_PREFIX "gkrellmradeontop_"
+#define EOF_LINE "# EOF\n"	// room for it is always kept in body
+
+static const char *const block_names[GPU_BLOCK_COUNT] = {
+	"gpu", "ee", "vgt", "ta", "sx", "sh", "spi", "sc", "pa", "db", "cb",
+};
+
+// radeontop reports clocks with MHz precision, drop float noise below it
+static double mhz(float ghz) {
+	return (double)(long)(ghz * 1000.0f + 0.5f);
+}
+
+static int listen_unix(struct exporter *e, const char *path) {
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	if(strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "exporter socket path is too long: %s\n", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	// only a stale socket from previous run is replaced, never a file
+	// the path was mistyped into
+	struct stat st;
+	if(lstat(path, &st) == 0) {
+		if(!S_ISSOCK(st.st_mode)) {
+			fprintf(stderr, "%s exists and isn't a socket, not replacing it\n", path);
+			errno = EEXIST;
+			return -1;
+		}
+		unlink(path);
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(fd < 0) {
+		return -1;
+	}
+	if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		close(fd);
+		return -1;
+	}
+	snprintf(e->unix_path, sizeof(e->unix_path), "%s", path);
+	return fd;
+}
+
+static int listen_tcp(const char *port) {
+	char *end;
+	errno = 0;
+	const long n = strtol(port, &end, 10);
+	if(errno || end == port || *end || n < 1 || n > 65535) {
+		fprintf(stderr, "invalid exporter port \"%s\"\n", port);
+		errno = EINVAL;
+		return -1;
+	}
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons((uint16_t)n),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(fd < 0) {
+		return -1;
+	}
+	const int one = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int exporter_open(struct exporter *e, const char *address) {
+	e->listen_fd = -1;
+	e->unix_path[0] = '\0';
+	e->header_len = e->body_len = 0;
+	e->truncated = false;
+	e->cut_responses = 0;
+	for(int i = 0; i < EXPORTER_MAX_CLIENTS; ++i) {
+		e->clients[i].fd = -1;
+		e->clients[i].out = NULL;
+	}
+
+	if(!address[0]) {
+		return 0;
+	}
+
+	int fd;
+	if(!strncmp(address, "unix:", 5)) {
+		fd = listen_unix(e, address + 5);
+	} else if(!strncmp(address, "tcp:", 4)) {
+		fd = listen_tcp(address + 4);
+	} else {
+		fprintf(stderr, "unknown exporter address \"%s\", expected unix:<path> or tcp:<port>\n", address);
+		return -1;
+	}
+
+	if(fd < 0 || listen(fd, EXPORTER_MAX_CLIENTS) != 0) {
+		fprintf(stderr, "can't listen on %s: %s\n", address, strerror(errno));
+		if(fd >= 0) {
+			close(fd);
+		}
+		return -1;
+	}
+	e->listen_fd = fd;
+	return 0;
+}
+
+static void drop_client(struct exporter *e, int i) {
+	close(e->clients[i].fd);
+	e->clients[i].fd = -1;
+	free(e->clients[i].out);
+	e->clients[i].out = NULL;
+}
+
+void exporter_close(struct exporter *e) {
+	for(int i = 0; i < EXPORTER_MAX_CLIENTS; ++i) {
+		if(e->clients[i].fd >= 0) {
+			drop_client(e, i);
+		}
+	}
+	if(e->listen_fd >= 0) {
+		close(e->listen_fd);
+		e->listen_fd = -1;
+	}
+	if(e->unix_path[0]) {
+		unlink(e->unix_path);
+		e->unix_path[0] = '\0';
+	}
+}
+
+/* appends a line to body; a line that doesn't fit is dropped whole */
+static void append(struct exporter *e, const char *fmt, ...) {
+	const size_t room = sizeof(e->body) - sizeof(EOF_LINE) - e->body_len;
+	va_list ap;
+	va_start(ap, fmt);
+	// what was cut off is overwritten by next line or EOF_LINE
+	int r = vsnprintf(e->body + e->body_len, room + 1, fmt, ap);
+	va_end(ap);
+	if(r >= 0 && (size_t)r <= room) {
+		e->body_len += (size_t)r;
+	} else if(!e->truncated) {
+		fprintf(stderr, "exporter response doesn't fit in %d bytes, leaving out metrics\n",
+				EXPORTER_BUF_SIZE);
+		e->truncated = true;
+	}
+}
+
+static void family(struct exporter *e, const char *name, const char *type, const char *unit, const char *help) {
+	append(e, "# TYPE " METRIC_PREFIX "%s %s\n", name, type);
+	if(unit) {
+		append(e, "# UNIT " METRIC_PREFIX "%s %s\n", name, unit);
+	}
+	append(e, "# HELP " METRIC_PREFIX "%s %s\n", name, help);
+}
+
+void exporter_render(struct exporter *e, const struct exporter_gpu *gpus, int count, uint64_t cpu_ns) {
+	if(e->listen_fd < 0) {
+		return;
+	}
+
+	// gkrellm runs with user locale, OpenMetrics wants '.' as decimal point
+	static locale_t c_locale;
+	if(!c_locale) {
+		c_locale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+	}
+	locale_t old = uselocale(c_locale);
+
+	e->body_len = 0;
+
+	family(e, "busy_ratio", "gauge", "ratio", "Fraction of time GPU block was busy.");
+	for(int i = 0; i < count; ++i) {
+		const struct gpu_stats *st = gpus[i].stats;
+		for(int b = 0; b < GPU_BLOCK_COUNT; ++b) {
+			if(st->valid & GPU_FIELD_BIT(b)) {
+				append(e, METRIC_PREFIX "busy_ratio{gpu=\"%d\",block=\"%s\"} %.4f\n",
+						gpus[i].id, block_names[b], st->busy[b] / 100.0);
+			}
+		}
+	}
+
+	family(e, "memory_used_bytes", "gauge", "bytes", "GPU memory in use.");
+	for(int i = 0; i < count; ++i) {
+		const struct gpu_stats *st = gpus[i].stats;
+		if(st->valid & GPU_FIELD_BIT(GPU_FIELD_VRAM)) {
+			append(e, METRIC_PREFIX "memory_used_bytes{gpu=\"%d\",pool=\"vram\"} %.0f\n",
+					gpus[i].id, st->vram_mb * 1048576.0);
+		}
+		if(st->valid & GPU_FIELD_BIT(GPU_FIELD_GTT)) {
+			append(e, METRIC_PREFIX "memory_used_bytes{gpu=\"%d\",pool=\"gtt\"} %.0f\n",
+					gpus[i].id, st->gtt_mb * 1048576.0);
+		}
+	}
+
+	family(e, "clock_hertz", "gauge", "hertz", "Current GPU clock.");
+	for(int i = 0; i < count; ++i) {
+		const struct gpu_stats *st = gpus[i].stats;
+		if(st->valid & GPU_FIELD_BIT(GPU_FIELD_SCLK)) {
+			append(e, METRIC_PREFIX "clock_hertz{gpu=\"%d\",clock=\"shader\"} %.0f\n",
+					gpus[i].id, mhz(st->sclk_ghz) * 1e6);
+		}
+		if(st->valid & GPU_FIELD_BIT(GPU_FIELD_MCLK)) {
+			append(e, METRIC_PREFIX "clock_hertz{gpu=\"%d\",clock=\"memory\"} %.0f\n",
+					gpus[i].id, mhz(st->mclk_ghz) * 1e6);
+		}
+	}
+
+	family(e, "sample_latency_seconds", "gauge", "seconds", "Delay between sample and its receiving.");
+	for(int i = 0; i < count; ++i) {
+		append(e, METRIC_PREFIX "sample_latency_seconds{gpu=\"%d\"} %.6f\n",
+				gpus[i].id, gpus[i].stats->latency_us / 1e6);
+	}
+
+	family(e, "power_watts", "gauge", "watts", "Average GPU power draw.");
+	for(int i = 0; i < count; ++i) {
+		const struct gpu_stats *st = gpus[i].stats;
+		if(st->valid & GPU_FIELD_BIT(GPU_FIELD_POWER)) {
+			append(e, METRIC_PREFIX "power_watts{gpu=\"%d\"} %.3f\n", gpus[i].id, st->power_w);
+		}
+	}
+
+	static const char *const temp_names[GPU_TEMP_COUNT] = { "edge", "junction", "mem" };
+	family(e, "temperature_celsius", "gauge", "celsius", "GPU temperature.");
+	for(int i = 0; i < count; ++i) {
+		const struct gpu_stats *st = gpus[i].stats;
+		for(int t = 0; t < GPU_TEMP_COUNT; ++t) {
+			if(st->valid & GPU_FIELD_BIT(GPU_FIELD_TEMP + t)) {
+				append(e, METRIC_PREFIX "temperature_celsius{gpu=\"%d\",sensor=\"%s\"} %.1f\n",
+						gpus[i].id, temp_names[t], st->temp_c[t]);
+			}
+		}
+	}
+
+	family(e, "fan_rpm", "gauge", NULL, "GPU fan speed, revolutions per minute.");
+	for(int i = 0; i < count; ++i) {
+		const struct gpu_stats *st = gpus[i].stats;
+		if(st->valid & GPU_FIELD_BIT(GPU_FIELD_FAN)) {
+			append(e, METRIC_PREFIX "fan_rpm{gpu=\"%d\"} %.0f\n", gpus[i].id, st->fan_rpm);
+		}
+	}
+
+	family(e, "throttled", "gauge", NULL, "1 while GPU is pegged with low shader clock, by likely reason.");
+	for(int i = 0; i < count; ++i) {
+		const struct gpu_stats *st = gpus[i].stats;
+		if(st->valid & GPU_FIELD_BIT(GPU_FIELD_THROTTLE)) {
+			append(e, METRIC_PREFIX "throttled{gpu=\"%d\",reason=\"any\"} %d\n",
+					gpus[i].id, (st->throttle & GPU_THROTTLE_CLOCK) != 0);
+			append(e, METRIC_PREFIX "throttled{gpu=\"%d\",reason=\"thermal\"} %d\n",
+					gpus[i].id, (st->throttle & GPU_THROTTLE_THERMAL) != 0);
+			append(e, METRIC_PREFIX "throttled{gpu=\"%d\",reason=\"power\"} %d\n",
+					gpus[i].id, (st->throttle & GPU_THROTTLE_POWER) != 0);
+		}
+	}
+
+	family(e, "suspended", "gauge", NULL, "1 while GPU is runtime suspended and isn't sampled.");
+	for(int i = 0; i < count; ++i) {
+		append(e, METRIC_PREFIX "suspended{gpu=\"%d\"} %d\n", gpus[i].id, gpus[i].off);
+	}
+
+#define COUNTER(name, help, expr) \
+	family(e, name, "counter", NULL, help); \
+	for(int i = 0; i < count; ++i) { \
+		append(e, METRIC_PREFIX name "_total{gpu=\"%d\"} %llu\n", \
+				gpus[i].id, (unsigned long long)(expr)); \
+	}
+
+	COUNTER("samples", "Samples received.", gpus[i].samples);
+	COUNTER("parse_errors", "Lines that couldn't be decoded.", gpus[i].parse_errors);
+	COUNTER("restarts", "Backend restarts.", gpus[i].restarts);
+	COUNTER("sample_gaps", "Samples that came late.", gpus[i].stats->gaps);
+	COUNTER("dropped_samples", "Samples estimated missing.", gpus[i].stats->dropped);
+#undef COUNTER
+
+	static const char *const layer_names[EXPORTER_LAYERS] = { "chart", "panel", "hwmon" };
+	family(e, "redraws", "counter", NULL, "Chart, panel and hwmon chart redraws, and those skipped as nothing changed.");
+	for(int i = 0; i < count; ++i) {
+		for(int l = 0; l < EXPORTER_LAYERS; ++l) {
+			append(e, METRIC_PREFIX "redraws_total{gpu=\"%d\",layer=\"%s\",result=\"performed\"} %llu\n",
+					gpus[i].id, layer_names[l], (unsigned long long)gpus[i].redraws[l]);
+			append(e, METRIC_PREFIX "redraws_total{gpu=\"%d\",layer=\"%s\",result=\"skipped\"} %llu\n",
+					gpus[i].id, layer_names[l], (unsigned long long)gpus[i].redraws_skipped[l]);
+		}
+	}
+
+	family(e, "exporter_cut_responses", "counter", NULL, "Scrapes that went away before whole response was sent.");
+	append(e, METRIC_PREFIX "exporter_cut_responses_total %llu\n", (unsigned long long)e->cut_responses);
+
+	family(e, "sampler_cpu_seconds", "counter", "seconds", "CPU time used by sampler thread.");
+	append(e, METRIC_PREFIX "sampler_cpu_seconds_total %.6f\n", cpu_ns / 1e9);
+
+	memcpy(e->body + e->body_len, EOF_LINE, sizeof(EOF_LINE) - 1);
+	e->body_len += sizeof(EOF_LINE) - 1;
+
+	e->header_len = (size_t)snprintf(e->header, sizeof(e->header),
+			"HTTP/1.0 200 OK\r\n"
+			"Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+			"Content-Length: %zu\r\n"
+			"Connection: close\r\n\r\n", e->body_len);
+
+	uselocale(old);
+}
+
+int exporter_pollfds(struct exporter *e, struct pollfd *fds) {
+	if(e->listen_fd < 0) {
+		return 0;
+	}
+	int n = 0;
+	fds[n++] = (struct pollfd){ .fd = e->listen_fd, .events = POLLIN };
+	for(int i = 0; i < EXPORTER_MAX_CLIENTS; ++i) {
+		// entries are kept positional, poll() ignores negative fds
+		fds[n++] = (struct pollfd){
+			.fd = e->clients[i].fd,
+			.events = e->clients[i].out ? POLLOUT : POLLIN,
+		};
+	}
+	return n;
+}
+
+/* drops client whose response send() failed, unless it would block */
+static bool send_failed(struct exporter *e, int i) {
+	if(errno == EAGAIN || errno == EINTR) {
+		return false;
+	}
+	e->cut_responses++;
+	drop_client(e, i);
+	return true;
+}
+
+static void respond(struct exporter *e, int i, bool http) {
+	struct iovec iov[2] = {
+		{ .iov_base = e->header, .iov_len = http ? e->header_len : 0 },
+		{ .iov_base = e->body, .iov_len = e->body_len },
+	};
+	const struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+	const size_t len = iov[0].iov_len + iov[1].iov_len;
+	ssize_t r = sendmsg(e->clients[i].fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if(r < 0) {
+		if(send_failed(e, i)) {
+			return;
+		}
+		r = 0;
+	}
+	if((size_t)r == len) {
+		drop_client(e, i);
+		return;
+	}
+
+	// body is rendered again by next sample, so keep a copy of what is left
+	char *out = malloc(len - (size_t)r);
+	if(!out) {
+		e->cut_responses++;
+		drop_client(e, i);
+		return;
+	}
+	size_t off = (size_t)r, n = 0;
+	for(int v = 0; v < 2; ++v) {
+		if(off < iov[v].iov_len) {
+			memcpy(out + n, (const char *)iov[v].iov_base + off, iov[v].iov_len - off);
+			n += iov[v].iov_len - off;
+			off = 0;
+		} else {
+			off -= iov[v].iov_len;
+		}
+	}
+	e->clients[i].out = out;
+	e->clients[i].out_len = n;
+	e->clients[i].out_sent = 0;
+}
+
+static void client_writable(struct exporter *e, int i) {
+	const size_t left = e->clients[i].out_len - e->clients[i].out_sent;
+	const ssize_t r = send(e->clients[i].fd, e->clients[i].out + e->clients[i].out_sent,
+			left, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if(r < 0) {
+		send_failed(e, i);
+		return;
+	}
+	e->clients[i].out_sent += (size_t)r;
+	if((size_t)r == left) {
+		drop_client(e, i);
+	}
+}
+
+static void client_readable(struct exporter *e, int i) {
+	size_t *len = &e->clients[i].req_len;
+	char *req = e->clients[i].req;
+
+	ssize_t r = recv(e->clients[i].fd, req + *len, sizeof(e->clients[i].req) - 1 - *len, MSG_DONTWAIT);
+	if(r < 0) {
+		if(errno != EAGAIN && errno != EINTR) {
+			drop_client(e, i);
+		}
+		return;
+	}
+	if(r == 0) {
+		// no request at all means plain text client
+		respond(e, i, *len > 0);
+		return;
+	}
+	*len += (size_t)r;
+	req[*len] = '\0';
+
+	if(strstr(req, "\r\n\r\n") || strstr(req, "\n\n") || *len == sizeof(e->clients[i].req) - 1) {
+		respond(e, i, true);
+	}
+}
+
+void exporter_handle(struct exporter *e, const struct pollfd *fds, int n) {
+	if(n == 0) {
+		return;
+	}
+
+	for(int i = 0; i < EXPORTER_MAX_CLIENTS && 1 + i < n; ++i) {
+		if(e->clients[i].fd < 0 || !fds[1 + i].revents) {
+			continue;
+		}
+		if(e->clients[i].out) {
+			client_writable(e, i);
+		} else {
+			client_readable(e, i);
+		}
+	}
+
+	if(fds[0].revents & POLLIN) {
+		int fd;
+		while((fd = accept4(e->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+			int i;
+			for(i = 0; i < EXPORTER_MAX_CLIENTS && e->clients[i].fd >= 0; ++i);
+			if(i == EXPORTER_MAX_CLIENTS) {
+				close(fd);	// busy
+				continue;
+			}
+			e->clients[i].fd = fd;
+			e->clients[i].req_len = 0;
+		}
+	}
+}
@@ -0,0 +1,71 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gpu_stats.h"
+
+/* OpenMetrics text exporter. Everything runs on the sampler thread: the
+ * response is rendered after new samples, at most every 100 ms however
+ * many arrive (sampler decides), and a scrape only writes that buffer out.
+ * Listens on "unix:<path>" or "tcp:<port>" (127.0.0.1 only).
+ * HTTP clients get HTTP/1.0 response; a client that half-closes without
+ * sending a request gets bare metrics text. */
+
+#define EXPORTER_MAX_CLIENTS 8
+#define EXPORTER_BUF_SIZE 16384
+
+enum exporter_layer {
+	EXPORTER_LAYER_CHART,
+	EXPORTER_LAYER_PANEL,
+	EXPORTER_LAYER_HWMON,
+	EXPORTER_LAYERS
+};
+
+struct exporter_gpu {
+	int id;
+	const struct gpu_stats *stats;
+	uint64_t samples;
+	uint64_t parse_errors;
+	uint64_t restarts;
+	bool off;	// runtime suspended
+	uint64_t redraws[EXPORTER_LAYERS];
+	uint64_t redraws_skipped[EXPORTER_LAYERS];
+};
+
+struct exporter {
+	int listen_fd;
+	char unix_path[108];	// to unlink on close
+
+	struct {
+		int fd;
+		size_t req_len;
+		char req[512];
+		// rest of a response socket didn't take at once, sent on POLLOUT
+		char *out;
+		size_t out_len, out_sent;
+	} clients[EXPORTER_MAX_CLIENTS];
+
+	size_t header_len, body_len;
+	bool truncated;	// body didn't fit once, reported
+	uint64_t cut_responses;	// clients gone before whole response was sent
+	char header[256];
+	char body[EXPORTER_BUF_SIZE];
+};
+
+/* returns 0 on success; empty address leaves exporter disabled */
+int exporter_open(struct exporter *e, const char *address);
+void exporter_close(struct exporter *e);
+
+/* cpu_ns is CPU time used by sampler thread so far */
+void exporter_render(struct exporter *e, const struct exporter_gpu *gpus, int count, uint64_t cpu_ns);
+
+/* adds listening socket and clients to fds, returns number of added
+ * entries (at most 1 + EXPORTER_MAX_CLIENTS) */
+int exporter_pollfds(struct exporter *e, struct pollfd *fds);
+/* handles events of entries filled by exporter_pollfds() */
+void exporter_handle(struct exporter *e, const struct pollfd *fds, int n);
+
+#endif
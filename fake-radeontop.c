@@ -0,0 +1,165 @@
+/* Synthetic "radeontop -d -" for benchmarking ingest without a GPU.
+ *
+ * Writes radeontop-like dump lines stamped with the time they are written,
+ * so latency reported by the plugin is the write to publication delay.
+ * Load and clocks follow a random walk. Accepts radeontop -d and -t
+ * (ignored), so it could replace radeontop in plugin command line. */
+#define _GNU_SOURCE	// clock_nanosleep
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+struct options {
+	double rate;	// lines per second
+	unsigned int jitter_us;	// +- random delay of every line
+	unsigned int burst;	// extra lines written back to back
+	unsigned int burst_ms;	// every that often
+	unsigned int truncate_pct;	// lines cut short
+	unsigned int stall_ms;	// pause output for that long
+	unsigned int stall_s;	// every that often
+	unsigned long count;	// stop after that many lines, 0 = never
+	unsigned int bus;
+	unsigned int seed;
+};
+
+static void usage(const char *argv0) {
+	fprintf(stderr,
+		"usage: %s [-r lines/s] [-j jitter_us] [-B lines -P period_ms]\n"
+		"       [-x truncate_pct] [-s stall_ms -S period_s] [-n count] [-b bus] [-z seed]\n",
+		argv0);
+	exit(1);
+}
+
+static uint64_t clock_ns(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t deadline_ns) {
+	struct timespec ts = {
+		.tv_sec = (time_t)(deadline_ns / 1000000000),
+		.tv_nsec = (long)(deadline_ns % 1000000000),
+	};
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+static float walk(float v, float step, float lo, float hi) {
+	v += step * ((float)rand() / (float)RAND_MAX * 2.0f - 1.0f);
+	return v < lo ? lo : v > hi ? hi : v;
+}
+
+static void write_all(const char *buf, size_t len) {
+	while(len) {
+		ssize_t r = write(STDOUT_FILENO, buf, len);
+		if(r < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			exit(errno == EPIPE ? 0 : 1);
+		}
+		buf += r;
+		len -= (size_t)r;
+	}
+}
+
+static void write_line(const struct options *opt) {
+	static float gpu = 20, vram_mb = 500, gtt_mb = 40, sclk = 0.5f;
+	gpu = walk(gpu, 5, 0, 100);
+	vram_mb = walk(vram_mb, 8, 100, 8000);
+	gtt_mb = walk(gtt_mb, 1, 10, 2000);
+	sclk = walk(sclk, 0.05f, 0.2f, 2.5f);
+	const float sh = gpu * 0.9f, cb = gpu * 0.6f;
+
+	char line[512];
+	const uint64_t now_us = clock_ns(CLOCK_REALTIME) / 1000;
+	// radeontop doesn't zero-pad microseconds either
+	int len = snprintf(line, sizeof(line),
+		"%llu.%llu: bus %02x, gpu %.2f%%, ee %.2f%%, vgt %.2f%%, ta %.2f%%, "
+		"sx %.2f%%, sh %.2f%%, spi %.2f%%, sc %.2f%%, pa %.2f%%, db %.2f%%, "
+		"cb %.2f%%, vram %.2f%% %.2fmb, gtt %.2f%% %.2fmb, "
+		"mclk %.2f%% %.3fghz, sclk %.2f%% %.3fghz\n",
+		(unsigned long long)(now_us / 1000000), (unsigned long long)(now_us % 1000000),
+		opt->bus, gpu, 0.0, gpu * 0.3f, gpu * 0.8f, cb, sh, sh, gpu * 0.5f,
+		gpu * 0.2f, cb, cb, vram_mb / 81.92f, vram_mb, gtt_mb / 40.96f, gtt_mb,
+		100.0, 1.750, sclk / 2.5f * 100.0f, sclk);
+
+	if(opt->truncate_pct && (unsigned int)rand() % 100 < opt->truncate_pct) {
+		len = rand() % len;
+		line[len++] = '\n';
+	}
+	write_all(line, (size_t)len);
+}
+
+int main(int argc, char **argv) {
+	struct options opt = {
+		.rate = 1,
+		.burst_ms = 1000,
+		.stall_s = 10,
+		.bus = 3,
+		.seed = (unsigned int)getpid(),
+	};
+
+	int c;
+	while((c = getopt(argc, argv, "d:t:r:j:B:P:x:s:S:n:b:z:")) != -1) {
+		switch(c) {
+		case 'd': case 't': break;	// radeontop dump target and ticks
+		case 'r': opt.rate = atof(optarg); break;
+		case 'j': opt.jitter_us = (unsigned int)atoi(optarg); break;
+		case 'B': opt.burst = (unsigned int)atoi(optarg); break;
+		case 'P': opt.burst_ms = (unsigned int)atoi(optarg); break;
+		case 'x': opt.truncate_pct = (unsigned int)atoi(optarg); break;
+		case 's': opt.stall_ms = (unsigned int)atoi(optarg); break;
+		case 'S': opt.stall_s = (unsigned int)atoi(optarg); break;
+		case 'n': opt.count = strtoul(optarg, NULL, 10); break;
+		case 'b': opt.bus = (unsigned int)strtoul(optarg, NULL, 16); break;
+		case 'z': opt.seed = (unsigned int)atoi(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+	if(opt.rate <= 0 || !opt.burst_ms || !opt.stall_s) {
+		usage(argv[0]);
+	}
+	srand(opt.seed);
+
+	printf("Dumping to -, until termination.\n");
+	fflush(stdout);
+
+	const uint64_t period_ns = (uint64_t)(1e9 / opt.rate);
+	uint64_t next = clock_ns(CLOCK_MONOTONIC);
+	uint64_t next_burst = next + opt.burst_ms * 1000000ull;
+	uint64_t next_stall = next + opt.stall_s * 1000000000ull;
+
+	for(unsigned long n = 0; !opt.count || n < opt.count; ++n) {
+		uint64_t at = next;
+		if(opt.jitter_us) {
+			at += (uint64_t)(rand() % (2 * opt.jitter_us + 1)) * 1000;
+			at -= opt.jitter_us * 1000ull;
+		}
+		sleep_until(at);
+		write_line(&opt);
+		next += period_ns;
+
+		const uint64_t now = clock_ns(CLOCK_MONOTONIC);
+		if(opt.burst && now >= next_burst) {
+			for(unsigned int i = 0; i < opt.burst; ++i) {
+				write_line(&opt);
+			}
+			next_burst += opt.burst_ms * 1000000ull;
+		}
+		if(opt.stall_ms && now >= next_stall) {
+			// lines that were due during stall are skipped, as a real stall would
+			sleep_until(now + opt.stall_ms * 1000000ull);
+			next = clock_ns(CLOCK_MONOTONIC);
+			next_stall = next + opt.stall_s * 1000000000ull;
+		}
+		if(next + 100000000 < now) {
+			next = now;	// way behind, don't write a huge backlog at once
+		}
+	}
+	return 0;
+}
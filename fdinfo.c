@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "fdinfo.h"
+
+// what is kept from one fdinfo file
+struct fdinfo_values {
+	bool amdgpu;
+	char pdev[16];
+	uint64_t client_id;
+	uint64_t gfx_ns, compute_ns;
+	uint64_t vram_bytes, gtt_bytes;
+};
+
+static bool parse_int(const char *p, int *out) {
+	int v = 0;
+	if(!*p) {
+		return false;
+	}
+	for(; *p; ++p) {
+		if(*p < '0' || *p > '9' || v > (0x7fffffff - 9) / 10) {
+			return false;
+		}
+		v = v * 10 + (*p - '0');
+	}
+	*out = v;
+	return true;
+}
+
+static int cmp_int(const void *a, const void *b) {
+	const int x = *(const int *)a, y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+/* "<n> [KiB|MiB|GiB]", no unit means bytes */
+static uint64_t parse_size(const char *p) {
+	char *unit;
+	uint64_t v = strtoull(p, &unit, 10);
+	while(*unit == ' ') {
+		unit++;
+	}
+	if(!strncmp(unit, "KiB", 3)) {
+		v <<= 10;
+	} else if(!strncmp(unit, "MiB", 3)) {
+		v <<= 20;
+	} else if(!strncmp(unit, "GiB", 3)) {
+		v <<= 30;
+	}
+	return v;
+}
+
+/* returns true if fd is an amdgpu client */
+static bool read_fdinfo(const struct fdinfo_scanner *s, int pid, int fd, struct fdinfo_values *v) {
+	char path[320], buf[4096];
+	snprintf(path, sizeof(path), "%s/%d/fdinfo/%d", s->root, pid, fd);
+	int f = open(path, O_RDONLY | O_CLOEXEC);
+	if(f < 0) {
+		return false;
+	}
+	ssize_t r = read(f, buf, sizeof(buf) - 1);
+	close(f);
+	if(r <= 0) {
+		return false;
+	}
+	buf[r] = '\0';
+
+	memset(v, 0, sizeof(*v));
+	for(char *line = buf; *line; ) {
+		char *eol = strchr(line, '\n');
+		if(eol) {
+			*eol = '\0';
+		}
+		char *val = strchr(line, ':');
+		if(val) {
+			*val++ = '\0';
+			while(*val == ' ' || *val == '\t') {
+				val++;
+			}
+			if(!strcmp(line, "drm-driver")) {
+				v->amdgpu = !strcmp(val, "amdgpu");
+			} else if(!strcmp(line, "drm-pdev")) {
+				snprintf(v->pdev, sizeof(v->pdev), "%s", val);
+			} else if(!strcmp(line, "drm-client-id")) {
+				v->client_id = strtoull(val, NULL, 10);
+			} else if(!strcmp(line, "drm-engine-gfx")) {
+				v->gfx_ns = strtoull(val, NULL, 10);
+			} else if(!strcmp(line, "drm-engine-compute")) {
+				v->compute_ns = strtoull(val, NULL, 10);
+			} else if(!strcmp(line, "drm-memory-vram") || !strcmp(line, "drm-resident-vram")) {
+				// older and newer name of the same thing
+				v->vram_bytes = parse_size(val);
+			} else if(!strcmp(line, "drm-memory-gtt") || !strcmp(line, "drm-resident-gtt")) {
+				v->gtt_bytes = parse_size(val);
+			}
+		}
+		if(!eol) {
+			break;
+		}
+		line = eol + 1;
+	}
+	return v->amdgpu;
+}
+
+static void read_comm(const struct fdinfo_scanner *s, int pid, char *comm, size_t size) {
+	char path[320];
+	snprintf(path, sizeof(path), "%s/%d/comm", s->root, pid);
+	comm[0] = '\0';
+	int f = open(path, O_RDONLY | O_CLOEXEC);
+	if(f < 0) {
+		return;
+	}
+	ssize_t r = read(f, comm, size - 1);
+	close(f);
+	comm[r > 0 ? r : 0] = '\0';
+	comm[strcspn(comm, "\n")] = '\0';
+}
+
+static float ratio(uint64_t prev, uint64_t cur, double dt_ns) {
+	return cur > prev ? (float)((double)(cur - prev) / dt_ns) : 0.0f;
+}
+
+/* stores values read at now_ns, with busy ratios since previous read */
+static void update_fd(struct fdinfo_fd *e, const struct fdinfo_values *v, uint64_t now_ns) {
+	if(!e->fresh && e->client_id == v->client_id && now_ns > e->read_ns) {
+		const double dt = (double)(now_ns - e->read_ns);
+		e->gfx = ratio(e->gfx_ns, v->gfx_ns, dt);
+		e->compute = ratio(e->compute_ns, v->compute_ns, dt);
+	} else {
+		e->gfx = e->compute = 0;
+	}
+	e->fresh = false;
+	e->client_id = v->client_id;
+	memcpy(e->pdev, v->pdev, sizeof(e->pdev));
+	e->read_ns = now_ns;
+	e->gfx_ns = v->gfx_ns;
+	e->compute_ns = v->compute_ns;
+	e->vram_bytes = v->vram_bytes;
+	e->gtt_bytes = v->gtt_bytes;
+}
+
+static struct fdinfo_fd *find_fd(struct fdinfo_scanner *s, int pid, int fd) {
+	struct fdinfo_fd *free_entry = NULL;
+	for(size_t i = 0; i < FDINFO_MAX_FDS; ++i) {
+		struct fdinfo_fd *e = &s->fds[i];
+		if(e->pid == pid && e->fd == fd) {
+			return e;
+		} else if(!e->pid && !free_entry) {
+			free_entry = e;
+		}
+	}
+	if(free_entry) {
+		*free_entry = (struct fdinfo_fd){ .pid = pid, .fd = fd, .fresh = true };
+	}
+	return free_entry;
+}
+
+static void drop_pid(struct fdinfo_scanner *s, int pid) {
+	for(size_t i = 0; i < FDINFO_MAX_FDS; ++i) {
+		if(s->fds[i].pid == pid) {
+			s->fds[i].pid = 0;
+		}
+	}
+}
+
+/* lists fd table of a process, tracking its amdgpu fds. Only DRM device
+ * nodes have their fdinfo read */
+static void list_fds(struct fdinfo_scanner *s, int pid, uint64_t now_ns) {
+	char path[320];
+	snprintf(path, sizeof(path), "%s/%d/fd", s->root, pid);
+	DIR *dir = opendir(path);
+	if(dir) {
+		struct dirent *de;
+		while((de = readdir(dir))) {
+			int fd;
+			if(!parse_int(de->d_name, &fd)) {
+				continue;
+			}
+			char link[352], target[64];
+			snprintf(link, sizeof(link), "%s/%d", path, fd);
+			ssize_t n = readlink(link, target, sizeof(target) - 1);
+			if(n < 9 || memcmp(target, "/dev/dri/", 9)) {
+				continue;
+			}
+
+			struct fdinfo_values v;
+			if(!read_fdinfo(s, pid, fd, &v)) {
+				continue;
+			}
+			struct fdinfo_fd *e = find_fd(s, pid, fd);
+			if(!e) {
+				continue;	// table is full
+			}
+			if(e->fresh) {
+				read_comm(s, pid, e->comm, sizeof(e->comm));
+			}
+			e->seen_scan = s->scan;
+			update_fd(e, &v, now_ns);
+		}
+		closedir(dir);
+	}
+
+	// closed since last listing
+	for(size_t i = 0; i < FDINFO_MAX_FDS; ++i) {
+		if(s->fds[i].pid == pid && s->fds[i].seen_scan != s->scan) {
+			s->fds[i].pid = 0;
+		}
+	}
+}
+
+/* replaces process table with current content of root, keeping state of
+ * processes that are still there */
+static void update_procs(struct fdinfo_scanner *s) {
+	size_t npids = 0;
+	DIR *dir = opendir(s->root);
+	if(dir) {
+		struct dirent *de;
+		while(npids < FDINFO_MAX_PROCS && (de = readdir(dir))) {
+			if(parse_int(de->d_name, &s->pids[npids])) {
+				npids++;
+			}
+		}
+		closedir(dir);
+	}
+	qsort(s->pids, npids, sizeof(s->pids[0]), cmp_int);
+
+	size_t i = 0, m = 0;
+	for(size_t j = 0; j < npids; ++j) {
+		for(; i < s->nprocs && s->procs[i].pid < s->pids[j]; ++i) {
+			drop_pid(s, s->procs[i].pid);
+		}
+		if(i < s->nprocs && s->procs[i].pid == s->pids[j]) {
+			s->merged[m++] = s->procs[i++];
+		} else {
+			s->merged[m++] = (struct fdinfo_proc){ .pid = s->pids[j], .rescan_at = s->scan };
+		}
+	}
+	for(; i < s->nprocs; ++i) {
+		drop_pid(s, s->procs[i].pid);
+	}
+	memcpy(s->procs, s->merged, m * sizeof(s->procs[0]));
+	s->nprocs = m;
+}
+
+/* index of first process with pid not less than given */
+static size_t lower_bound(const struct fdinfo_scanner *s, int pid) {
+	size_t lo = 0, hi = s->nprocs;
+	while(lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if(s->procs[mid].pid < pid) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+static struct fdinfo_proc *find_proc(struct fdinfo_scanner *s, int pid) {
+	size_t i = lower_bound(s, pid);
+	return i < s->nprocs && s->procs[i].pid == pid ? &s->procs[i] : NULL;
+}
+
+void fdinfo_init(struct fdinfo_scanner *s, const char *root) {
+	memset(s, 0, sizeof(*s));
+	snprintf(s->root, sizeof(s->root), "%s", root);
+}
+
+void fdinfo_scan(struct fdinfo_scanner *s, uint64_t now_ns) {
+	s->scan++;
+	update_procs(s);
+
+	// round robin from where budget ran out last time, so that processes
+	// with high pids aren't starved by frequent listings of low ones
+	unsigned int budget = FDINFO_LIST_BUDGET;
+	const size_t first = lower_bound(s, s->list_from);
+	s->list_from = 0;
+	for(size_t k = 0; k < s->nprocs; ++k) {
+		struct fdinfo_proc *p = &s->procs[(first + k) % s->nprocs];
+		if((int32_t)(p->rescan_at - s->scan) > 0) {
+			continue;
+		}
+		if(!budget) {
+			s->list_from = p->pid;
+			break;
+		}
+		budget--;
+		list_fds(s, p->pid, now_ns);
+
+		// most processes open GPU at start if ever, so listings get rarer
+		const uint32_t interval = 1u << p->backoff;
+		if(interval < FDINFO_RESCAN_SCANS) {
+			p->backoff++;
+		}
+		p->rescan_at = s->scan + interval + (uint32_t)p->pid % interval;
+	}
+
+	for(size_t i = 0; i < FDINFO_MAX_FDS; ++i) {
+		struct fdinfo_fd *e = &s->fds[i];
+		if(!e->pid || e->seen_scan == s->scan) {
+			continue;
+		}
+		struct fdinfo_values v;
+		if(read_fdinfo(s, e->pid, e->fd, &v)) {
+			e->seen_scan = s->scan;
+			update_fd(e, &v, now_ns);
+			continue;
+		}
+		// closed, or fd number reused for something else
+		struct fdinfo_proc *p = find_proc(s, e->pid);
+		if(p) {
+			p->rescan_at = s->scan + 1;
+			p->backoff = 0;
+		}
+		e->pid = 0;
+	}
+}
+
+static int cmp_client(const void *a, const void *b) {
+	const struct fdinfo_client *x = a, *y = b;
+	const float bx = x->gfx + x->compute, by = y->gfx + y->compute;
+	if(bx != by) {
+		return bx < by ? 1 : -1;
+	}
+	return (x->vram_bytes < y->vram_bytes) - (x->vram_bytes > y->vram_bytes);
+}
+
+size_t fdinfo_top(const struct fdinfo_scanner *s, const char *pdev,
+		struct fdinfo_client *out, size_t max) {
+	struct fdinfo_client all[FDINFO_MAX_FDS];
+	size_t n = 0;
+
+	for(size_t i = 0; i < FDINFO_MAX_FDS; ++i) {
+		const struct fdinfo_fd *e = &s->fds[i];
+		if(!e->pid || (pdev[0] && strcmp(pdev, e->pdev))) {
+			continue;
+		}
+		// dup()ed or passed fd of a client that is already counted
+		bool counted = false;
+		for(size_t k = 0; k < i && !counted; ++k) {
+			const struct fdinfo_fd *o = &s->fds[k];
+			counted = o->pid && o->client_id == e->client_id && !strcmp(o->pdev, e->pdev);
+		}
+		if(counted) {
+			continue;
+		}
+
+		size_t c = 0;
+		while(c < n && all[c].pid != e->pid) {
+			c++;
+		}
+		if(c == n) {
+			all[n++] = (struct fdinfo_client){ .pid = e->pid };
+			memcpy(all[c].comm, e->comm, sizeof(all[c].comm));
+		}
+		all[c].gfx += e->gfx;
+		all[c].compute += e->compute;
+		all[c].vram_bytes += e->vram_bytes;
+		all[c].gtt_bytes += e->gtt_bytes;
+	}
+
+	qsort(all, n, sizeof(all[0]), cmp_client);
+	n = n < max ? n : max;
+	memcpy(out, all, n * sizeof(out[0]));
+	return n;
+}
@@ -0,0 +1,74 @@
+#ifndef FDINFO_H
+#define FDINFO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Per-process amdgpu usage from DRM fdinfo (drm-engine-*, drm-memory-*
+ * keys of <root>/<pid>/fdinfo/<fd>).
+ *
+ * Scan is incremental: every scan lists <root>, but fd table of a process
+ * is only listed when it is new and then at growing intervals (1, 2, 4...
+ * up to FDINFO_RESCAN_SCANS scans), and at most FDINFO_LIST_BUDGET
+ * processes per scan. Between listings only fdinfo of fds already known to
+ * be amdgpu clients is re-read. Engine busy ratios are deltas of engine
+ * time between two reads of the same client. */
+
+#define FDINFO_DEFAULT_ROOT "/proc"
+#define FDINFO_MAX_PROCS 8192	// processes beyond that are ignored
+#define FDINFO_MAX_FDS 128	// amdgpu fds tracked, over all processes
+#define FDINFO_RESCAN_SCANS 16
+#define FDINFO_LIST_BUDGET 256
+
+struct fdinfo_client {
+	int pid;
+	char comm[16];
+	float gfx, compute;	// busy ratio since previous scan
+	uint64_t vram_bytes, gtt_bytes;
+};
+
+struct fdinfo_proc {
+	int pid;
+	uint32_t rescan_at;	// scan number of next fd table listing
+	uint8_t backoff;	// log2 of listing interval
+};
+
+struct fdinfo_fd {
+	int pid;	// 0 if entry is free
+	int fd;
+	uint32_t seen_scan;	// scan that last read it
+	bool fresh;	// no previous read to compute delta from
+	char comm[16];
+	char pdev[16];	// PCI address, e.g. 0000:03:00.0
+	uint64_t client_id;
+	uint64_t read_ns;	// when counters below were read
+	uint64_t gfx_ns, compute_ns;
+	uint64_t vram_bytes, gtt_bytes;
+	float gfx, compute;
+};
+
+struct fdinfo_scanner {
+	char root[256];
+	uint32_t scan;	// number of scans so far
+	int list_from;	// pid that didn't fit into last listing budget
+
+	size_t nprocs;
+	struct fdinfo_proc procs[FDINFO_MAX_PROCS];	// sorted by pid
+	struct fdinfo_proc merged[FDINFO_MAX_PROCS];
+	int pids[FDINFO_MAX_PROCS];
+
+	struct fdinfo_fd fds[FDINFO_MAX_FDS];
+};
+
+void fdinfo_init(struct fdinfo_scanner *s, const char *root);
+
+/* updates known clients; now_ns is CLOCK_MONOTONIC */
+void fdinfo_scan(struct fdinfo_scanner *s, uint64_t now_ns);
+
+/* fills out with up to max busiest clients of GPU at pdev (any GPU if pdev
+ * is empty), one entry per process; returns their number */
+size_t fdinfo_top(const struct fdinfo_scanner *s, const char *pdev,
+		struct fdinfo_client *out, size_t max);
+
+#endif
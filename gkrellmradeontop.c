@@ -5,7 +5,28 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include "subprocess.h"
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include "cmdline.h"
+#include "gpu_stats.h"
+#include "gpu_sysfs.h"
+#include "stats_seqlock.h"
+#include "sample_ring.h"
+#include "history.h"
+#include "rollup.h"
+#include "exporter.h"
+#include "gpu_shm.h"
+#include "supervisor.h"
+#include "gpu_pm.h"
+#include "fdinfo.h"
+#include "gpu_grbm.h"
+#include "radeontop_ingest.h"
+#include "radeontop_child.h"
+#include "burst.h"
+#include "stream_record.h"
+#include "sample_log.h"
 
 #define PLUGIN_NAME "gkrellmradeontop"
 #define PLUGIN_DESC "show AMD GPU load chart"
@@ -17,17 +38,228 @@
 #define MIN_GRID_RES 10
 #define MAX_GRID_RES 100
 
+#define MAX_GPUS 4
+
 #define CMDLINE_MAX_LEN 1024
 #define RADEONTOP_DEFAULT_CMDLINE "/usr/bin/radeontop -d - -t 1"
+#define SYSFS_DEFAULT_INTERVAL_MS 1000
+
+// shift-click on chart relaunches sysfs or GRBM backend at high rate for
+// BURST_MS and saves every sample to a file
+#define BURST_MS 5000
+#define BURST_INTERVAL_MS 10	// sysfs and GRBM sample interval
+#define BURST_GRBM_TICK_MS 1
+
+// radeontop is restarted if it printed nothing for HANG_INTERVALS intervals
+#define HANG_INTERVALS 10
+#define HANG_MIN_MS 10000
+
+// exporter response is rendered for every sample, but not more often than this
+#define EXPORTER_RENDER_MIN_MS 100
+
+// runtime_status of a GPU with runtime PM is re-read that often
+#define PM_CHECK_MS 1000
+// Sampling keeps GPU awake itself. Once it was idle for PM_IDLE_MIN_MS,
+// sampling is held for autosuspend delay so it could suspend; if it didn't,
+// wait before next try doubles up to PM_IDLE_MAX_MS
+#define PM_IDLE_MIN_MS 30000
+#define PM_IDLE_MAX_MS 600000
+#define PM_IDLE_BUSY 1	// percent
+#define PM_PROBE_MARGIN_MS 2000
+
+// hwmon is read that often, independently of backend, and merged into samples
+#define HWMON_INTERVAL_MS 1000
+#define HWMON_FIELDS (GPU_FIELD_BIT(GPU_FIELD_FAN + 1) - GPU_FIELD_BIT(GPU_FIELD_POWER))
+
+// GPU busier than THROTTLE_BUSY percent with sclk under THROTTLE_SCLK percent
+// of max for THROTTLE_MIN_MS is throttled
+#define THROTTLE_BUSY 90
+#define THROTTLE_SCLK 80
+#define THROTTLE_MIN_MS 2000
+#define THROTTLE_TEMP_MARGIN 5	// degrees under critical
+#define THROTTLE_POWER_RATIO 0.95f
+
+// processes using GPU are looked up that often, busiest ones are shown
+#define CLIENTS_SCAN_MS 2000
+#define CLIENTS_TOP 5
+
+// stats are reset if nothing arrived for STALE_INTERVALS sample intervals
+#define STALE_INTERVALS 3
+#define STALE_MIN_MS 500
+#define STALE_DEFAULT_MS 2000	// until interval is known
+
+// sample log is rotated at that size, that many old files are kept
+#define LOG_MAX_BYTES (64 * 1024 * 1024)
+#define LOG_KEEP 4
+
+enum backend {
+	BACKEND_RADEONTOP,
+	BACKEND_SYSFS,
+	BACKEND_GRBM,
+};
+
+enum sampler_state {
+	SAMPLER_STOPPED,	// (re)started at next_action_ms
+	SAMPLER_RADEONTOP,
+	SAMPLER_SYSFS,		// next sample at next_action_ms
+	SAMPLER_GRBM,		// next register read at next_action_ms
+};
+
+// values shown as extra info, in displayed precision
+struct extra_info_key {
+	int sclk, busy;
+	int latency;	// 0.1 ms
+	unsigned int gaps;
+};
+
+struct gpu_instance {
+	int id;
+
+	gboolean extra_info;
+	int resolution;	// charted rollup level
+
+	GkrellmChart *chart;
+	GkrellmChartconfig *chart_config;
+	GkrellmKrell *krell;
+
+	// power and temperature, second row
+	GkrellmChart *hwmon_chart;
+	GkrellmChartconfig *hwmon_chart_config;
+
+	// owned by sampler thread
+	struct {
+		enum sampler_state state;
+		uint64_t next_action_ms;
+
+		struct radeontop_child child;
+		struct radeontop_ingest ingest;
+		struct stream_writer record;	// thread is 0 if not recording
+		char record_path[256];	// record is open for
+		uint64_t last_output_ms;
+
+		bool paused;	// radeontop is SIGSTOPped, sysfs isn't sampled
+
+		// runtime PM, status_fd is -1 if GPU doesn't have it
+		struct gpu_pm pm;
+		uint64_t pm_check_ms;	// next runtime_status read
+		bool gpu_off;	// GPU is suspended, backend is stopped
+		uint64_t idle_since_ms;	// 0 if GPU is busy
+		uint64_t probe_end_ms;	// sampling is held to let GPU suspend, 0 if not
+		uint32_t probe_wait_ms;	// idle time before next probe
+
+		char pdev[16];	// PCI address of card, to match fdinfo clients
 
-//#define DBGPRINTF(fmt, ...) fprintf(stderr, (fmt), __VA_ARGS__)
-#define DBGPRINTF(fmt, ...)
+		bool hwmon_found;
+		struct gpu_hwmon hwmon;
+		uint64_t hwmon_next_ms;
+		struct gpu_stats hwmon_stats;	// only hwmon fields are used
+		uint64_t pegged_since_ms;	// busy with low sclk since, 0 if not
 
-struct gpu_stats {
-	time_t stats_timestamp;
+		struct supervisor supervisor;
+		struct stderr_ring stderr_ring;
 
-	unsigned int gpu_pipe;
-	unsigned int shader_clock;
+		struct gpu_sysfs sysfs;
+		int interval_ms;
+
+		struct gpu_grbm grbm;
+		int tick_ms;	// between register reads
+		uint64_t grbm_sample_ms;	// next sample of counted reads
+
+		uint64_t burst_end_ms;	// 0 if not capturing
+		char burst_path[256];
+		struct burst burst;
+
+		struct sample_timing timing;
+
+		// for exporter, with ingest.parse_errors
+		struct gpu_stats last;
+		uint64_t samples;
+		uint64_t restarts;
+	} sampler;
+
+	// nobody looks at chart, set by GTK thread
+	atomic_bool pause;
+	bool obscured;	// chart is covered, e.g. by screen locker
+
+	// written by sampler thread, message under gpu_mon.mutex
+	atomic_int backend_state;	// enum supervisor_state
+	char backend_message[128];
+	atomic_bool gpu_off;	// runtime suspended
+	atomic_bool bursting;
+
+	// burst capture requested by GTK thread, under gpu_mon.mutex
+	bool burst_request;
+	char burst_path[256];
+
+	// busiest processes, written by sampler thread under gpu_mon.mutex
+	struct fdinfo_client clients[CLIENTS_TOP];
+	size_t client_count;
+	unsigned int clients_generation;
+
+	struct stats_seqlock gpu_stats;
+	struct gpu_stats gpu_stats_copy;
+	unsigned int gpu_stats_generation;	// of gpu_stats_copy
+
+	// every sample since last chart column
+	struct sample_ring samples;
+
+	// persistent copy of samples, written by sampler thread
+	struct history history;
+
+	// coarse history for zoomed out chart, GTK thread only
+	struct rollup rollup;
+
+	// what is currently drawn, GTK thread only
+	struct {
+		bool krell_valid;
+		gulong krell_value;
+
+		bool info_valid;	// info_key and info_text are up to date
+		struct extra_info_key info_key;
+		gchar info_text[64];
+
+		gchar hwmon_text[160];
+		gulong hwmon_column[2];	// last stored power and temperature
+		int hwmon_flat;	// columns in a row equal to hwmon_column
+
+		int backend_state;
+		bool gpu_off;
+		bool bursting;
+		unsigned int clients_generation;	// shown in tooltip
+
+		// read by exporter
+		_Atomic uint64_t performed[EXPORTER_LAYERS];
+		_Atomic uint64_t skipped[EXPORTER_LAYERS];
+	} redraw;
+
+	struct {
+		GtkWidget *radeontop_cmdline_entry;
+		char radeontop_cmdline[CMDLINE_MAX_LEN];
+		GtkWidget *record_entry;
+		char record[256];	// raw radeontop output goes there, unless empty
+
+		GtkWidget *backend_combo;
+		GtkWidget *sysfs_card_entry;
+		GtkWidget *sysfs_interval_spin;
+		GtkWidget *grbm_ticks_spin;
+		int backend;
+		char sysfs_card[64];
+		int sysfs_interval_ms;
+		int grbm_ticks;	// register reads per second
+		char grbm_device[64];	// empty for render node of sysfs_card
+	} options;
+};
+
+#define SAMPLER_MAX_FDS (1 + 3 * MAX_GPUS + 1 + EXPORTER_MAX_CLIENTS)
+
+// poll set of sampler loop, rebuilt every round
+struct sampler_loop {
+	int gpu_count;
+	struct pollfd fds[SAMPLER_MAX_FDS];
+	nfds_t nfds;
+	nfds_t exporter_fds;	// index of first exporter fd
+	int gpu_fds[MAX_GPUS];	// index of stdout/stderr/pidfd in fds, or -1
+	uint64_t last_render_ms;
 };
 
 static struct {
@@ -36,186 +268,1268 @@ static struct {
 	char name[64];
 	char panel_label[64];
 
-	gboolean extra_info;
-
 	GtkWidget *vbox;
-	GkrellmChart *chart;
-	GkrellmChartconfig *chart_config;
-	GkrellmKrell *krell;
 
+	// protects process lifecycle and options; stats go through seqlock
 	pthread_mutex_t mutex;
 	struct {
 		pthread_t thread;
-		struct subprocess_s subprocess;
-		bool subprocess_running;
+		GSource *source;	// instead of thread, with options.main_loop
+		bool main_loop;	// sampling in GTK main loop, see start_sampling()
 		bool stop_thread;
+		bool reload;	// options changed, restart backends
+		int wake_fd;	// eventfd, signalled on stop/reload
+
+		// owned by sampler thread
+		struct sampler_loop loop;
+		struct exporter exporter;
+		char exporter_address[256];	// currently listening on
+		bool exporter_dirty;	// samples arrived since last render
+
+		struct gpu_shm_writer shm;
+
+		struct sample_log log;
+
+		bool clients;	// options.clients as of last (re)load
+		struct fdinfo_scanner fdinfo;
+		uint64_t fdinfo_next_ms;
 	} radeontop;
 
-	struct gpu_stats gpu_stats, gpu_stats_copy;
+	// number of GPU instances created; options.gpu_count applies on restart
+	int gpu_count;
+	struct gpu_instance gpus[MAX_GPUS];
 
 	struct {
-		GtkWidget *radeontop_cmdline_entry;
-		char radeontop_cmdline[CMDLINE_MAX_LEN];
+		GtkWidget *gpu_count_spin;
+		int gpu_count;
+		char sysfs_root[256];
+		char proc_root[256];
+
+		GtkWidget *clients_check;
+		gboolean clients;
+
+		GtkWidget *hwmon_chart_check;
+		gboolean hwmon_chart;
+
+		GtkWidget *reduction_combo;
+		int reduction;	// enum sample_reduction
+
+		GtkWidget *history_check;
+		gboolean history;
+
+		GtkWidget *pause_hidden_check;
+		gboolean pause_hidden;
+
+		GtkWidget *main_loop_check;
+		gboolean main_loop;	// sample in GTK main loop if nothing there would block
+
+		GtkWidget *exporter_entry;
+		char exporter[256];	// "unix:<path>", "tcp:<port>" or empty
+
+		GtkWidget *shm_entry;
+		char shm[64];	// segment name or empty
+
+		GtkWidget *log_entry;
+		char log[256];	// sample log path or empty
 	} options;
 } gpu_mon;
 
 static gint style_id;
 
-static GkrellmMonitor *gpu_plugin_mon_ptr;
+static GkrellmMonitor *gpu_plugin_mon_ptr;
+
+static uint64_t clock_ns(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t monotonic_ms(void) {
+	return clock_ns(CLOCK_MONOTONIC) / 1000000;
+}
+
+/* gpu_mon.mutex is only needed while there is a sampler thread */
+static void lock_shared(void) {
+	if(!gpu_mon.radeontop.main_loop) {
+		pthread_mutex_lock(&gpu_mon.mutex);
+	}
+}
+
+static void unlock_shared(void) {
+	if(!gpu_mon.radeontop.main_loop) {
+		pthread_mutex_unlock(&gpu_mon.mutex);
+	}
+}
+
+static void wakeup_thread(void) {
+	const uint64_t one = 1;
+	if(write(gpu_mon.radeontop.wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+		fprintf(stderr, "can't wake up radeontop thread: %s\n", strerror(errno));
+	}
+}
+
+static void sampler_loop_finish(void);
+
+static void stop_helper_process(void) {
+	if(gpu_mon.radeontop.source) {
+		g_source_destroy(gpu_mon.radeontop.source);
+		g_source_unref(gpu_mon.radeontop.source);
+		gpu_mon.radeontop.source = NULL;
+		sampler_loop_finish();
+		gpu_mon.radeontop.main_loop = false;
+	} else if(gpu_mon.radeontop.thread) {
+		lock_shared();
+		gpu_mon.radeontop.stop_thread = true;
+		unlock_shared();
+		wakeup_thread();
+
+		pthread_join(gpu_mon.radeontop.thread, NULL);
+		gpu_mon.radeontop.thread = 0;
+	}
+}
+
+/* history stays mapped while plugin is disabled, so it is written again
+ * once sampling is restarted */
+static void plugin_exit(void) {
+	stop_helper_process();
+	for(int i = 0; i < gpu_mon.gpu_count; ++i) {
+		history_close(&gpu_mon.gpus[i].history);
+	}
+}
+
+static void set_backend_state(struct gpu_instance *gpu, enum supervisor_state state, const char *message) {
+	lock_shared();
+	g_strlcpy(gpu->backend_message, message, sizeof(gpu->backend_message));
+	unlock_shared();
+	atomic_store_explicit(&gpu->backend_state, state, memory_order_relaxed);
+}
+
+/* flags GPU that stays pegged while its shader clock is low, with reasons
+ * hwmon could tell */
+static void update_throttle(struct gpu_instance *gpu, struct gpu_stats *stats) {
+	const uint32_t need = GPU_FIELD_BIT(GPU_BLOCK_GPU) | GPU_FIELD_BIT(GPU_FIELD_SCLK);
+	if((stats->valid & need) != need) {
+		gpu->sampler.pegged_since_ms = 0;
+		return;
+	}
+	stats->valid |= GPU_FIELD_BIT(GPU_FIELD_THROTTLE);
+
+	const uint64_t now = stats->recv_time_ns / 1000000;
+	if(stats->busy[GPU_BLOCK_GPU] < THROTTLE_BUSY || stats->sclk >= THROTTLE_SCLK) {
+		gpu->sampler.pegged_since_ms = 0;
+		return;
+	}
+	if(!gpu->sampler.pegged_since_ms) {
+		gpu->sampler.pegged_since_ms = now;
+	}
+	if(now - gpu->sampler.pegged_since_ms < THROTTLE_MIN_MS) {
+		return;
+	}
+
+	stats->throttle = GPU_THROTTLE_CLOCK;
+	const int t = stats->valid & GPU_FIELD_BIT(GPU_FIELD_TEMP + GPU_TEMP_JUNCTION) ?
+		GPU_TEMP_JUNCTION : GPU_TEMP_EDGE;
+	if((stats->valid & GPU_FIELD_BIT(GPU_FIELD_TEMP + t)) && stats->temp_crit_c[t] > 0 &&
+			stats->temp_c[t] >= stats->temp_crit_c[t] - THROTTLE_TEMP_MARGIN) {
+		stats->throttle |= GPU_THROTTLE_THERMAL;
+	}
+	if((stats->valid & GPU_FIELD_BIT(GPU_FIELD_POWER)) && stats->power_cap_w > 0 &&
+			stats->power_w >= stats->power_cap_w * THROTTLE_POWER_RATIO) {
+		stats->throttle |= GPU_THROTTLE_POWER;
+	}
+}
+
+/* adds latest hwmon readings to sample */
+static void merge_hwmon(struct gpu_instance *gpu, struct gpu_stats *stats) {
+	const struct gpu_stats *hw = &gpu->sampler.hwmon_stats;
+	stats->power_w = hw->power_w;
+	stats->power_cap_w = hw->power_cap_w;
+	memcpy(stats->temp_c, hw->temp_c, sizeof(stats->temp_c));
+	memcpy(stats->temp_crit_c, hw->temp_crit_c, sizeof(stats->temp_crit_c));
+	stats->fan_rpm = hw->fan_rpm;
+	stats->fan_max_rpm = hw->fan_max_rpm;
+	stats->valid |= hw->valid & HWMON_FIELDS;
+}
+
+static void publish_stats(struct gpu_instance *gpu, struct gpu_stats *stats) {
+	sample_timing_update(&gpu->sampler.timing, stats);
+	merge_hwmon(gpu, stats);
+	update_throttle(gpu, stats);
+	stats_seqlock_write(&gpu->gpu_stats, stats);
+
+	const struct sample sample = {
+		.time_us = stats->recv_time_ns / 1000,
+		.gpu_pipe = stats->busy[GPU_BLOCK_GPU],
+		.shader_clock = stats->sclk,
+	};
+	sample_ring_push(&gpu->samples, &sample);
+
+	history_append(&gpu->history, stats->sample_time_us, sample.gpu_pipe, sample.shader_clock);
+
+	gpu_shm_publish(&gpu_mon.radeontop.shm, gpu->id, stats);
+
+	if(atomic_load_explicit(&gpu->backend_state, memory_order_relaxed) != SUPERVISOR_UP) {
+		set_backend_state(gpu, SUPERVISOR_UP, "");
+	}
+
+	if(stats->busy[GPU_BLOCK_GPU] < PM_IDLE_BUSY) {
+		if(!gpu->sampler.idle_since_ms) {
+			gpu->sampler.idle_since_ms = stats->recv_time_ns / 1000000;
+		}
+	} else {
+		gpu->sampler.idle_since_ms = 0;
+		gpu->sampler.probe_wait_ms = PM_IDLE_MIN_MS;
+	}
+
+	if(gpu->sampler.burst_end_ms) {
+		burst_add(&gpu->sampler.burst, stats);
+	}
+
+	if(gpu_mon.radeontop.log.thread) {
+		sample_log_push(&gpu_mon.radeontop.log, (unsigned int)gpu->id, stats);
+	}
+
+	gpu->sampler.last = *stats;
+	gpu->sampler.samples++;
+	gpu_mon.radeontop.exporter_dirty = true;
+}
+
+/* reads, parses and publishes everything available on radeontop stdout.
+ * Returns false on EOF or read error */
+static bool sampler_read(struct gpu_instance *gpu, uint64_t now) {
+	struct radeontop_ingest *in = &gpu->sampler.ingest;
+
+	while(1) {
+		ssize_t r = radeontop_ingest_fill(in, gpu->sampler.child.out_fd);
+		if(r < 0) {
+			return errno == EAGAIN;
+		} else if(r == 0) {
+			return false;
+		}
+		// what was just read ends the buffer
+		stream_writer_chunk(&gpu->sampler.record, clock_ns(CLOCK_MONOTONIC),
+				in->lines.buf + in->lines.end - r, (size_t)r);
+		gpu->sampler.last_output_ms = now;
+		supervisor_running(&gpu->sampler.supervisor, now);
+
+		struct gpu_stats stats;
+		while(radeontop_ingest_next(in, &stats)) {
+			publish_stats(gpu, &stats);
+		}
+	}
+}
+
+/* keeps tail of radeontop stderr for error report */
+static void sampler_drain_stderr(struct gpu_instance *gpu) {
+	radeontop_child_drain_stderr(&gpu->sampler.child, &gpu->sampler.stderr_ring);
+}
+
+static void sampler_stop(struct gpu_instance *gpu);
+
+/* stops backend after it failed and schedules restart with backoff */
+static void sampler_failed(struct gpu_instance *gpu, uint64_t now, const char *reason) {
+	if(gpu->sampler.state == SAMPLER_RADEONTOP && gpu->sampler.child.err_fd >= 0) {
+		sampler_drain_stderr(gpu);
+	}
+	sampler_stop(gpu);
+	gpu->sampler.restarts++;
+
+	struct supervisor *sv = &gpu->sampler.supervisor;
+	const uint64_t delay = supervisor_failed(sv, now);
+	gpu->sampler.next_action_ms = now + delay;
+
+	char last[sizeof(gpu->backend_message)];
+	stderr_ring_last_line(&gpu->sampler.stderr_ring, last, sizeof(last));
+	fprintf(stderr, "%s for GPU %d%s%s, %srestarting in %.1f seconds\n",
+			reason, gpu->id, last[0] ? ": " : "", last,
+			sv->crash_loop ? "crash loop, " : "", delay / 1000.0);
+	set_backend_state(gpu, sv->crash_loop ? SUPERVISOR_CRASH_LOOP : SUPERVISOR_DOWN,
+			last[0] ? last : reason);
+}
+
+/* starts configured backend; on failure schedules retry */
+static void sampler_start(struct gpu_instance *gpu, uint64_t now) {
+	char cmdline_buf[CMDLINE_MAX_LEN];
+	const char *cmdline[128];
+	char root[sizeof(gpu_mon.options.sysfs_root)];
+	char card[sizeof(gpu->options.sysfs_card)];
+	char device[sizeof(gpu->options.grbm_device)];
+
+	lock_shared();
+	int backend = gpu->options.backend;
+	cmdline_split(cmdline, sizeof(cmdline)/sizeof(cmdline[0]),
+			cmdline_buf, gpu->options.radeontop_cmdline);
+	g_strlcpy(root, gpu_mon.options.sysfs_root, sizeof(root));
+	g_strlcpy(card, gpu->options.sysfs_card, sizeof(card));
+	g_strlcpy(device, gpu->options.grbm_device, sizeof(device));
+	gpu->sampler.interval_ms = MAX(gpu->options.sysfs_interval_ms, 10);
+	gpu->sampler.tick_ms = MAX(1000 / MAX(gpu->options.grbm_ticks, 1), 1);
+	unlock_shared();
+
+	if(gpu->sampler.burst_end_ms) {
+		gpu->sampler.interval_ms = BURST_INTERVAL_MS;
+		gpu->sampler.tick_ms = BURST_GRBM_TICK_MS;
+	}
+
+	// new producer, its clock starts over
+	gpu->sampler.timing.last_sample_us = 0;
+	gpu->sampler.stderr_ring.written = 0;
+	supervisor_started(&gpu->sampler.supervisor, now);
+
+	if(backend == BACKEND_SYSFS) {
+		if(gpu_sysfs_open(&gpu->sampler.sysfs, root, card) != 0) {
+			sampler_failed(gpu, now, "can't open amdgpu sysfs");
+			return;
+		}
+		gpu->sampler.state = SAMPLER_SYSFS;
+		gpu->sampler.next_action_ms = now;
+		return;
+	}
+	if(backend == BACKEND_GRBM) {
+		if(gpu_grbm_open(&gpu->sampler.grbm, device, root, card) != 0) {
+			sampler_failed(gpu, now, "can't read GPU registers");
+			return;
+		}
+		gpu->sampler.state = SAMPLER_GRBM;
+		gpu->sampler.next_action_ms = now;
+		gpu->sampler.grbm_sample_ms = now + (uint64_t)gpu->sampler.interval_ms;
+		return;
+	}
+
+	if(radeontop_child_spawn(&gpu->sampler.child, cmdline) != 0) {
+		sampler_failed(gpu, now, "can't launch radeontop");
+		return;
+	}
+	gpu->sampler.last_output_ms = now;
+
+	radeontop_ingest_start(&gpu->sampler.ingest);
+	gpu->sampler.state = SAMPLER_RADEONTOP;
+}
+
+static void sampler_stop(struct gpu_instance *gpu) {
+	if(gpu->sampler.state == SAMPLER_RADEONTOP) {
+		radeontop_child_stop(&gpu->sampler.child);
+	} else if(gpu->sampler.state == SAMPLER_SYSFS) {
+		gpu_sysfs_close(&gpu->sampler.sysfs);
+	} else if(gpu->sampler.state == SAMPLER_GRBM) {
+		gpu_grbm_close(&gpu->sampler.grbm);
+	}
+	gpu->sampler.state = SAMPLER_STOPPED;
+}
+
+static uint64_t sampler_hang_deadline(const struct gpu_instance *gpu) {
+	return gpu->sampler.last_output_ms +
+		MAX((uint64_t)gpu->sampler.timing.interval_us * HANG_INTERVALS / 1000, HANG_MIN_MS);
+}
+
+/* applies pause requested by GTK thread or runtime PM probe. Backend keeps
+ * running, so resume takes no longer than radeontop's next dump */
+static void sampler_pause(struct gpu_instance *gpu, uint64_t now) {
+	const bool pause = atomic_load_explicit(&gpu->pause, memory_order_relaxed) ||
+		gpu->sampler.probe_end_ms;
+	if(pause == gpu->sampler.paused) {
+		return;
+	}
+	gpu->sampler.paused = pause;
+
+	if(gpu->sampler.state == SAMPLER_RADEONTOP) {
+		radeontop_child_pause(&gpu->sampler.child, pause);
+	}
+	if(!pause) {
+		// neither a hang nor a gap
+		gpu->sampler.last_output_ms = now;
+		gpu->sampler.timing.last_sample_us = 0;
+		if(gpu->sampler.state == SAMPLER_SYSFS) {
+			gpu->sampler.next_action_ms = now;
+		} else if(gpu->sampler.state == SAMPLER_GRBM) {
+			// reads counted before pause are stale
+			struct gpu_stats stale;
+			gpu_grbm_sample(&gpu->sampler.grbm, &stale);
+			gpu->sampler.next_action_ms = now;
+			gpu->sampler.grbm_sample_ms = now + (uint64_t)gpu->sampler.interval_ms;
+		}
+	}
+}
+
+/* reads GRBM_STATUS once, and publishes percentages when sample is due */
+static void sampler_grbm(struct gpu_instance *gpu, uint64_t now) {
+	if(!gpu_grbm_tick(&gpu->sampler.grbm)) {
+		sampler_failed(gpu, now, "can't read GRBM_STATUS");
+		return;
+	}
+
+	if(now >= gpu->sampler.grbm_sample_ms) {
+		struct gpu_stats stats;
+		if(gpu_grbm_sample(&gpu->sampler.grbm, &stats)) {
+			publish_stats(gpu, &stats);
+			supervisor_running(&gpu->sampler.supervisor, now);
+		}
+		gpu->sampler.grbm_sample_ms += (uint64_t)gpu->sampler.interval_ms;
+		if(gpu->sampler.grbm_sample_ms <= now) {
+			gpu->sampler.grbm_sample_ms = now + (uint64_t)gpu->sampler.interval_ms;
+		}
+	}
+
+	gpu->sampler.next_action_ms += (uint64_t)gpu->sampler.tick_ms;
+	if(gpu->sampler.next_action_ms <= now) {
+		// late reads are skipped, percentages are over reads actually done
+		gpu->sampler.next_action_ms = now + (uint64_t)gpu->sampler.tick_ms;
+	}
+}
+
+/* runs timed work (sysfs sample, register read, restart, hang check) that is due */
+static void sampler_timeout(struct gpu_instance *gpu, uint64_t now) {
+	if(gpu->sampler.paused || gpu->sampler.gpu_off) {
+		return;	// restart too is held until resume
+	}
+	if(gpu->sampler.state == SAMPLER_RADEONTOP) {
+		if(now >= sampler_hang_deadline(gpu)) {
+			sampler_failed(gpu, now, "radeontop is not responding");
+		}
+		return;
+	}
+	if(now < gpu->sampler.next_action_ms) {
+		return;
+	}
+
+	if(gpu->sampler.state == SAMPLER_STOPPED) {
+		sampler_start(gpu, now);
+		if(gpu->sampler.state == SAMPLER_STOPPED || gpu->sampler.state == SAMPLER_RADEONTOP) {
+			return;
+		}
+	}
+	if(gpu->sampler.state == SAMPLER_GRBM) {
+		sampler_grbm(gpu, now);
+		return;
+	}
+
+	struct gpu_stats stats;
+	if(gpu_sysfs_sample(&gpu->sampler.sysfs, &stats)) {
+		publish_stats(gpu, &stats);
+		supervisor_running(&gpu->sampler.supervisor, now);
+	}
+	gpu->sampler.next_action_ms += (uint64_t)gpu->sampler.interval_ms;
+	if(gpu->sampler.next_action_ms <= now) {
+		// fell behind (e.g. after suspend), don't try to catch up
+		gpu->sampler.next_action_ms = now + (uint64_t)gpu->sampler.interval_ms;
+	}
+}
+
+/* starts burst capture if GTK thread asked for it: backend is relaunched
+ * at high rate and every sample goes to preallocated sampler.burst */
+static void sampler_burst_start(struct gpu_instance *gpu, uint64_t now) {
+	lock_shared();
+	const bool start = gpu->burst_request && !gpu->sampler.burst_end_ms && !gpu->sampler.gpu_off &&
+		gpu->options.backend != BACKEND_RADEONTOP;
+	gpu->burst_request = false;
+	if(start) {
+		g_strlcpy(gpu->sampler.burst_path, gpu->burst_path, sizeof(gpu->sampler.burst_path));
+	}
+	unlock_shared();
+
+	if(!start) {
+		return;
+	}
+	burst_reset(&gpu->sampler.burst);
+	sampler_stop(gpu);
+	gpu->sampler.burst_end_ms = now + BURST_MS;
+	gpu->sampler.next_action_ms = now;
+	atomic_store_explicit(&gpu->bursting, true, memory_order_relaxed);
+}
+
+/* once burst is over, relaunches backend at configured rate and writes
+ * captured samples */
+static void sampler_burst_end(struct gpu_instance *gpu, uint64_t now) {
+	if(!gpu->sampler.burst_end_ms || now < gpu->sampler.burst_end_ms) {
+		return;
+	}
+	gpu->sampler.burst_end_ms = 0;
+	sampler_stop(gpu);
+	gpu->sampler.next_action_ms = now;
+	atomic_store_explicit(&gpu->bursting, false, memory_order_relaxed);
+
+	const struct burst_header *h = &gpu->sampler.burst.header;
+	if(burst_write(&gpu->sampler.burst, gpu->sampler.burst_path) == 0) {
+		fprintf(stderr, "burst of %u samples (%u more didn't fit) for GPU %d saved to %s\n",
+				h->count, h->overflow, gpu->id, gpu->sampler.burst_path);
+	}
+}
+
+/* starts recording radeontop output to configured file, or stops it;
+ * recording goes on across backend restarts while path stays the same */
+static void sampler_record_open(struct gpu_instance *gpu) {
+	char path[sizeof(gpu->options.record)];
+	lock_shared();
+	g_strlcpy(path, gpu->options.record, sizeof(path));
+	unlock_shared();
+
+	if(gpu->sampler.record.thread && !strcmp(path, gpu->sampler.record_path)) {
+		return;
+	}
+	stream_writer_close(&gpu->sampler.record);
+	g_strlcpy(gpu->sampler.record_path, path, sizeof(gpu->sampler.record_path));
+	if(path[0]) {
+		stream_writer_open(&gpu->sampler.record, path);
+	}
+}
+
+/* (re)opens runtime_status and looks up PCI address of configured card */
+static void sampler_card_open(struct gpu_instance *gpu, uint64_t now) {
+	char root[sizeof(gpu_mon.options.sysfs_root)];
+	char card[sizeof(gpu->options.sysfs_card)];
+	lock_shared();
+	g_strlcpy(root, gpu_mon.options.sysfs_root, sizeof(root));
+	g_strlcpy(card, gpu->options.sysfs_card, sizeof(card));
+	unlock_shared();
+
+	gpu_sysfs_pdev(root, card, gpu->sampler.pdev, sizeof(gpu->sampler.pdev));
+	if(gpu->sampler.hwmon_found) {
+		gpu_hwmon_close(&gpu->sampler.hwmon);
+	}
+	// reading power could take milliseconds, not done in GTK main loop
+	gpu->sampler.hwmon_found = !gpu_mon.radeontop.main_loop &&
+		gpu_hwmon_open(&gpu->sampler.hwmon, root, card) == 0;
+	gpu->sampler.hwmon_next_ms = now;
+	memset(&gpu->sampler.hwmon_stats, 0, sizeof(gpu->sampler.hwmon_stats));
+	gpu->sampler.pegged_since_ms = 0;
+	gpu_pm_close(&gpu->sampler.pm);
+	gpu_pm_open(&gpu->sampler.pm, root, card);
+	gpu->sampler.pm_check_ms = now;	// before backend is started
+	gpu->sampler.gpu_off = false;
+	gpu->sampler.idle_since_ms = gpu->sampler.probe_end_ms = 0;
+	gpu->sampler.probe_wait_ms = PM_IDLE_MIN_MS;
+	atomic_store_explicit(&gpu->gpu_off, false, memory_order_relaxed);
+}
+
+/* reads hwmon if it is due. Not while paused or GPU is off: older kernels
+ * resume GPU to answer */
+static void sampler_hwmon(struct gpu_instance *gpu, uint64_t now) {
+	if(!gpu->sampler.hwmon_found || gpu->sampler.paused || gpu->sampler.gpu_off ||
+			now < gpu->sampler.hwmon_next_ms) {
+		return;
+	}
+	struct gpu_stats hw = {0};
+	gpu_hwmon_sample(&gpu->sampler.hwmon, &hw);
+	gpu->sampler.hwmon_stats = hw;
+
+	gpu->sampler.hwmon_next_ms += HWMON_INTERVAL_MS;
+	if(gpu->sampler.hwmon_next_ms <= now) {
+		gpu->sampler.hwmon_next_ms = now + HWMON_INTERVAL_MS;
+	}
+}
+
+/* Follows runtime PM of GPU: backend is stopped while GPU is suspended, so
+ * it isn't woken up just to be sampled, and started again once GPU is
+ * active. Sampling of an idle GPU is held now and then to let it suspend. */
+static void sampler_pm(struct gpu_instance *gpu, uint64_t now) {
+	if(gpu->sampler.pm.status_fd < 0 || now < gpu->sampler.pm_check_ms) {
+		return;
+	}
+	gpu->sampler.pm_check_ms = now + PM_CHECK_MS;
+
+	const enum gpu_pm_status status = gpu_pm_status(&gpu->sampler.pm);
+	if(gpu->sampler.gpu_off) {
+		if(status == GPU_PM_ACTIVE) {
+			gpu->sampler.gpu_off = false;
+			gpu->sampler.idle_since_ms = 0;
+			gpu->sampler.next_action_ms = now;
+			atomic_store_explicit(&gpu->gpu_off, false, memory_order_relaxed);
+		}
+		return;
+	}
+
+	if(status == GPU_PM_SUSPENDED) {
+		sampler_stop(gpu);
+		gpu->sampler.gpu_off = true;
+		gpu->sampler.probe_end_ms = 0;
+		gpu->sampler.probe_wait_ms = PM_IDLE_MIN_MS;
+		// nothing is running, so there is nothing to supervise either
+		supervisor_init(&gpu->sampler.supervisor, gpu->sampler.supervisor.random);
+		set_backend_state(gpu, SUPERVISOR_UP, "");
+		atomic_store_explicit(&gpu->gpu_off, true, memory_order_relaxed);
+	} else if(gpu->sampler.probe_end_ms) {
+		if(now >= gpu->sampler.probe_end_ms) {
+			// something else keeps it awake
+			gpu->sampler.probe_end_ms = gpu->sampler.idle_since_ms = 0;
+			gpu->sampler.probe_wait_ms = MIN(gpu->sampler.probe_wait_ms * 2, PM_IDLE_MAX_MS);
+		}
+	} else if(status == GPU_PM_ACTIVE && gpu->sampler.idle_since_ms && !gpu->sampler.burst_end_ms &&
+			now - gpu->sampler.idle_since_ms >= gpu->sampler.probe_wait_ms) {
+		gpu->sampler.probe_end_ms = now + gpu->sampler.pm.autosuspend_ms + PM_PROBE_MARGIN_MS;
+	}
+}
+
+/* (re)opens exporter if its configured address has changed */
+static void exporter_update(void) {
+	char address[sizeof(gpu_mon.options.exporter)];
+	lock_shared();
+	g_strlcpy(address, gpu_mon.options.exporter, sizeof(address));
+	unlock_shared();
+
+	struct exporter *e = &gpu_mon.radeontop.exporter;
+	if(!strcmp(address, gpu_mon.radeontop.exporter_address) && e->listen_fd >= 0) {
+		return;
+	}
+	exporter_close(e);
+	g_strlcpy(gpu_mon.radeontop.exporter_address, address, sizeof(address));
+	exporter_open(e, address);
+	gpu_mon.radeontop.exporter_dirty = true;
+}
+
+/* (re)creates shared memory segment if its configured name has changed */
+static void shm_update(int gpu_count) {
+	char name[sizeof(gpu_mon.options.shm)];
+	lock_shared();
+	g_strlcpy(name, gpu_mon.options.shm, sizeof(name));
+	unlock_shared();
+
+	struct gpu_shm_writer *w = &gpu_mon.radeontop.shm;
+	if(w->header && !strcmp(name, w->name)) {
+		return;
+	}
+	gpu_shm_destroy(w);
+	if(name[0]) {
+		gpu_shm_create(w, name, gpu_count);
+	}
+}
+
+/* (re)starts sample log writer if its configured path has changed */
+static void log_update(void) {
+	char path[sizeof(gpu_mon.options.log)];
+	lock_shared();
+	g_strlcpy(path, gpu_mon.options.log, sizeof(path));
+	unlock_shared();
+
+	struct sample_log *log = &gpu_mon.radeontop.log;
+	if(log->thread && !strcmp(path, log->path)) {
+		return;
+	}
+	sample_log_stop(log);
+	if(path[0]) {
+		sample_log_start(log, path, LOG_MAX_BYTES, LOG_KEEP);
+	}
+}
+
+static void exporter_update_metrics(int gpu_count) {
+	gpu_mon.radeontop.exporter_dirty = false;
+	if(gpu_mon.radeontop.exporter.listen_fd < 0) {
+		return;
+	}
+
+	struct exporter_gpu gpus[MAX_GPUS];
+	for(int i = 0; i < gpu_count; ++i) {
+		const struct gpu_instance *gpu = &gpu_mon.gpus[i];
+		gpus[i] = (struct exporter_gpu){
+			.id = gpu->id,
+			.stats = &gpu->sampler.last,
+			.samples = gpu->sampler.samples,
+			.parse_errors = gpu->sampler.ingest.parse_errors,
+			.restarts = gpu->sampler.restarts,
+			.off = gpu->sampler.gpu_off,
+		};
+		for(int l = 0; l < EXPORTER_LAYERS; ++l) {
+			gpus[i].redraws[l] = atomic_load_explicit(&gpu->redraw.performed[l], memory_order_relaxed);
+			gpus[i].redraws_skipped[l] = atomic_load_explicit(&gpu->redraw.skipped[l], memory_order_relaxed);
+		}
+	}
+	exporter_render(&gpu_mon.radeontop.exporter, gpus, gpu_count,
+			clock_ns(CLOCK_THREAD_CPUTIME_ID));
+}
+
+/* restarts process scanner with current options, clearing shown clients */
+static void clients_update(int gpu_count) {
+	char root[sizeof(gpu_mon.options.proc_root)];
+	lock_shared();
+	g_strlcpy(root, gpu_mon.options.proc_root, sizeof(root));
+	gpu_mon.radeontop.clients = gpu_mon.options.clients;
+	for(int i = 0; i < gpu_count; ++i) {
+		gpu_mon.gpus[i].client_count = 0;
+		gpu_mon.gpus[i].clients_generation++;
+	}
+	unlock_shared();
+
+	fdinfo_init(&gpu_mon.radeontop.fdinfo, root);
+	gpu_mon.radeontop.fdinfo_next_ms = 0;
+}
+
+/* rescans processes using GPU, if it is time, and publishes busiest ones of
+ * every GPU. Returns ms until next scan, -1 while no chart could show them */
+static int clients_scan(int gpu_count, uint64_t now) {
+	bool paused = true;
+	for(int i = 0; i < gpu_count; ++i) {
+		paused = paused && gpu_mon.gpus[i].sampler.paused;
+	}
+	if(!gpu_mon.radeontop.clients || paused) {
+		return -1;
+	}
+	if(now < gpu_mon.radeontop.fdinfo_next_ms) {
+		return (int)(gpu_mon.radeontop.fdinfo_next_ms - now);
+	}
+	gpu_mon.radeontop.fdinfo_next_ms = now + CLIENTS_SCAN_MS;
+
+	struct fdinfo_scanner *s = &gpu_mon.radeontop.fdinfo;
+	fdinfo_scan(s, clock_ns(CLOCK_MONOTONIC));
+	for(int i = 0; i < gpu_count; ++i) {
+		struct gpu_instance *gpu = &gpu_mon.gpus[i];
+		struct fdinfo_client top[CLIENTS_TOP];
+		size_t n = fdinfo_top(s, gpu->sampler.pdev, top, CLIENTS_TOP);
+
+		lock_shared();
+		memcpy(gpu->clients, top, n * sizeof(top[0]));
+		gpu->client_count = n;
+		gpu->clients_generation++;
+		unlock_shared();
+	}
+	return CLIENTS_SCAN_MS;
+}
+
+static void drain_wakeups(void) {
+	uint64_t cnt;
+	while(read(gpu_mon.radeontop.wake_fd, &cnt, sizeof(cnt)) > 0);
+}
+
+/* Services every GPU instance from one poll set: wakeup eventfd, stdout
+ * pipe and pidfd of each radeontop child and exporter sockets, with timeout
+ * of the nearest sysfs sample or restart, so neither a stalled nor a dead
+ * child could delay stop. Driven either by radeontop_thread or by a GSource
+ * in GTK main loop. */
+static void sampler_loop_init(void) {
+	struct sampler_loop *loop = &gpu_mon.radeontop.loop;
+	loop->gpu_count = gpu_mon.gpu_count;
+	loop->last_render_ms = 0;
+
+	struct gpu_stats zero = {0};
+	const uint64_t now = monotonic_ms();
+	for(int i = 0; i < loop->gpu_count; ++i) {
+		struct gpu_instance *gpu = &gpu_mon.gpus[i];
+		stats_seqlock_write(&gpu->gpu_stats, &zero);
+		gpu->sampler.last = zero;
+		gpu->sampler.state = SAMPLER_STOPPED;
+		gpu->sampler.paused = false;
+		sampler_card_open(gpu, now);
+		sampler_record_open(gpu);
+		supervisor_init(&gpu->sampler.supervisor, (uint32_t)clock_ns(CLOCK_MONOTONIC) + (uint32_t)i);
+		atomic_store_explicit(&gpu->backend_state, SUPERVISOR_UP, memory_order_relaxed);
+		gpu->sampler.next_action_ms = now;
+	}
+
+	gpu_mon.radeontop.exporter.listen_fd = -1;
+	gpu_mon.radeontop.exporter_address[0] = '\0';
+	exporter_update();
+	gpu_mon.radeontop.shm.header = NULL;
+	shm_update(loop->gpu_count);
+	log_update();
+	clients_update(loop->gpu_count);
+}
+
+/* runs timed work that is due and fills poll set; returns poll timeout */
+static int sampler_loop_prepare(void) {
+	struct sampler_loop *loop = &gpu_mon.radeontop.loop;
+	const int gpu_count = loop->gpu_count;
+	struct pollfd *fds = loop->fds;
+	const uint64_t now = monotonic_ms();
+	int timeout = -1;
+	nfds_t nfds = 0;
+
+	fds[nfds++] = (struct pollfd){ .fd = gpu_mon.radeontop.wake_fd, .events = POLLIN };
+	for(int i = 0; i < gpu_count; ++i) {
+		struct gpu_instance *gpu = &gpu_mon.gpus[i];
+
+		sampler_pm(gpu, now);
+		sampler_burst_end(gpu, now);
+		sampler_pause(gpu, now);
+		sampler_timeout(gpu, now);
+		sampler_hwmon(gpu, now);
+
+		loop->gpu_fds[i] = -1;
+		uint64_t deadline = gpu->sampler.next_action_ms;
+		if(gpu->sampler.state == SAMPLER_RADEONTOP) {
+			loop->gpu_fds[i] = (int)nfds;
+			fds[nfds++] = (struct pollfd){ .fd = gpu->sampler.child.out_fd, .events = POLLIN };
+			fds[nfds++] = (struct pollfd){ .fd = gpu->sampler.child.err_fd, .events = POLLIN };
+			fds[nfds++] = (struct pollfd){ .fd = gpu->sampler.child.pidfd, .events = POLLIN };
+			deadline = sampler_hang_deadline(gpu);
+		}
+		int t = (int)(deadline - now);
+		if(!gpu->sampler.paused && !gpu->sampler.gpu_off && (timeout < 0 || t < timeout)) {
+			timeout = t;
+		}
+		t = (int)(gpu->sampler.pm_check_ms - now);
+		if(gpu->sampler.pm.status_fd >= 0 && (timeout < 0 || t < timeout)) {
+			timeout = t;
+		}
+		t = (int)(gpu->sampler.burst_end_ms - now);
+		if(gpu->sampler.burst_end_ms && (timeout < 0 || t < timeout)) {
+			timeout = t;
+		}
+		t = (int)(gpu->sampler.hwmon_next_ms - now);
+		if(gpu->sampler.hwmon_found && !gpu->sampler.paused && !gpu->sampler.gpu_off &&
+				(timeout < 0 || t < timeout)) {
+			timeout = t;
+		}
+	}
+
+	const int scan_in = clients_scan(gpu_count, now);
+	if(scan_in >= 0 && (timeout < 0 || scan_in < timeout)) {
+		timeout = scan_in;
+	}
+
+	if(gpu_mon.radeontop.exporter_dirty) {
+		const uint64_t render_at = loop->last_render_ms + EXPORTER_RENDER_MIN_MS;
+		if(now >= render_at) {
+			exporter_update_metrics(gpu_count);
+			loop->last_render_ms = now;
+		} else if(timeout < 0 || (int)(render_at - now) < timeout) {
+			timeout = (int)(render_at - now);
+		}
+	}
+	loop->exporter_fds = nfds;
+	nfds += (nfds_t)exporter_pollfds(&gpu_mon.radeontop.exporter, fds + nfds);
+	loop->nfds = nfds;
+	return timeout;
+}
+
+/* handles revents of poll set; returns false once asked to stop */
+static bool sampler_loop_dispatch(void) {
+	struct sampler_loop *loop = &gpu_mon.radeontop.loop;
+	const int gpu_count = loop->gpu_count;
+	struct pollfd *fds = loop->fds;
+	const uint64_t now = monotonic_ms();
+
+	if(fds[0].revents) {
+		drain_wakeups();
+
+		lock_shared();
+		bool stop = gpu_mon.radeontop.stop_thread;
+		bool reload = gpu_mon.radeontop.reload;
+		gpu_mon.radeontop.reload = false;
+		unlock_shared();
+
+		if(stop) {
+			return false;
+		}
+		if(reload) {
+			for(int i = 0; i < gpu_count; ++i) {
+				struct gpu_instance *gpu = &gpu_mon.gpus[i];
+				sampler_stop(gpu);
+				sampler_card_open(gpu, now);
+				sampler_record_open(gpu);
+				gpu->sampler.next_action_ms = now;
+				// new settings deserve a fresh start
+				supervisor_init(&gpu->sampler.supervisor, gpu->sampler.supervisor.random);
+				set_backend_state(gpu, SUPERVISOR_UP, "");
+			}
+			exporter_update();
+			shm_update(gpu_count);
+			log_update();
+			clients_update(gpu_count);
+			return true;
+		}
+		for(int i = 0; i < gpu_count; ++i) {
+			sampler_burst_start(&gpu_mon.gpus[i], now);
+		}
+	}
+
+	for(int i = 0; i < gpu_count; ++i) {
+		const int idx = loop->gpu_fds[i];
+		if(idx < 0) {
+			continue;
+		}
+		struct gpu_instance *gpu = &gpu_mon.gpus[i];
+
+		if(fds[idx + 1].revents && gpu->sampler.child.err_fd >= 0) {
+			sampler_drain_stderr(gpu);
+		}
+
+		// child is gone, take whatever it has written and finish
+		bool exited = fds[idx + 2].revents != 0;
+		bool alive = true;
+		if(fds[idx].revents || exited) {
+			alive = sampler_read(gpu, now);
+		}
+		if(!alive || exited) {
+			sampler_failed(gpu, now, "radeontop exited");
+		}
+	}
+
+	// answer with what was rendered before this round of samples
+	exporter_handle(&gpu_mon.radeontop.exporter, fds + loop->exporter_fds,
+			(int)(loop->nfds - loop->exporter_fds));
+	return true;
+}
+
+static void sampler_loop_finish(void) {
+	for(int i = 0; i < gpu_mon.radeontop.loop.gpu_count; ++i) {
+		gpu_mon.gpus[i].sampler.burst_end_ms = 0;	// unfinished burst is lost
+		atomic_store_explicit(&gpu_mon.gpus[i].bursting, false, memory_order_relaxed);
+		sampler_stop(&gpu_mon.gpus[i]);
+		stream_writer_close(&gpu_mon.gpus[i].sampler.record);
+		gpu_pm_close(&gpu_mon.gpus[i].sampler.pm);
+		if(gpu_mon.gpus[i].sampler.hwmon_found) {
+			gpu_hwmon_close(&gpu_mon.gpus[i].sampler.hwmon);
+			gpu_mon.gpus[i].sampler.hwmon_found = false;
+		}
+	}
+	exporter_close(&gpu_mon.radeontop.exporter);
+	gpu_shm_destroy(&gpu_mon.radeontop.shm);
+	sample_log_stop(&gpu_mon.radeontop.log);
+}
+
+static void *radeontop_thread(void *arg) {
+	(void)arg;
+	struct sampler_loop *loop = &gpu_mon.radeontop.loop;
+
+	sampler_loop_init();
+	while(1) {
+		const int timeout = sampler_loop_prepare();
+		if(poll(loop->fds, loop->nfds, timeout) < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			fprintf(stderr, "poll failed: %s\n", strerror(errno));
+			break;
+		}
+		if(!sampler_loop_dispatch()) {
+			break;
+		}
+	}
+	sampler_loop_finish();
+	return NULL;
+}
+
+/* Same loop as a GSource of GTK main loop: poll set is handed to GLib on
+ * every prepare, so there is no thread to wake and no lock contention;
+ * samples reach the chart on the next gkrellm update. */
+struct sampler_source {
+	GSource source;
+	GPollFD polls[SAMPLER_MAX_FDS];	// positional like loop fds, added to source if fd >= 0
+	nfds_t npolls;
+	uint64_t deadline_ms;	// of last prepare timeout, 0 if none
+};
 
-static void extract_cmdline(const char **out, size_t max, char *buf, const char *in) {
-	// TODO add support for quoted arguments with spaces inside
-	strcpy(buf, in);
-	size_t len = strlen(buf);
-	size_t idx = 0, cur_len = 0;
-	for(size_t i = 0; i < len+1; ++i) {
-		if(buf[i] == '\0' || isspace(buf[i])) {
-			buf[i] = '\0';
-			if(cur_len > 0) {
-				if(idx < max) {
-					out[idx] = &buf[i-cur_len];
-				}
-				idx++;
-			}
-			cur_len = 0;
+static gboolean sampler_source_prepare(GSource *source, gint *timeout) {
+	struct sampler_source *s = (struct sampler_source *)source;
+	struct sampler_loop *loop = &gpu_mon.radeontop.loop;
+
+	*timeout = sampler_loop_prepare();
+	// poll set rarely changes, GLib is only told about fds that did
+	const nfds_t n = loop->nfds > s->npolls ? loop->nfds : s->npolls;
+	for(nfds_t i = 0; i < n; ++i) {
+		GPollFD *p = &s->polls[i];
+		// GLib's G_IO_* are poll() flags on Linux
+		const gint fd = i < loop->nfds ? loop->fds[i].fd : -1;
+		const gushort events = i < loop->nfds ? (gushort)loop->fds[i].events : 0;
+		if(i < s->npolls && p->fd == fd && p->events == events) {
 			continue;
 		}
-
-		cur_len++;
-	}
-	if(idx < max) {
-		out[idx] = 0;
-	} else {
-		out[max-1] = 0;
+		if(i < s->npolls && p->fd >= 0) {
+			g_source_remove_poll(source, p);
+		}
+		*p = (GPollFD){ .fd = fd, .events = events };
+		if(fd >= 0) {
+			g_source_add_poll(source, p);
+		}
 	}
+	s->npolls = loop->nfds;
+	s->deadline_ms = *timeout >= 0 ? monotonic_ms() + (uint64_t)*timeout : 0;
+	return *timeout == 0;
 }
 
-static float radeontop_extract_stat(const char *str, char *label) {
-	const char *m = strstr(str, label);
-	if(!m) {
-		fprintf(stderr, "no %s marker in radeontop output, output is \"%s\"\n", label, str);
-	} else {
-		float v = 0;
-		char fmt[64];
-		snprintf(fmt, sizeof(fmt), "%s %%f%%%%", label);
-		if(sscanf(m, fmt, &v) == 1) {
-			DBGPRINTF("fetched %f gpu load\n", v);
-			return v;
-		} else {
-			fprintf(stderr, "can't decode %s from string %s\n", label, m);
+static gboolean sampler_source_check(GSource *source) {
+	struct sampler_source *s = (struct sampler_source *)source;
+	for(nfds_t i = 0; i < s->npolls; ++i) {
+		if(s->polls[i].fd >= 0 && s->polls[i].revents) {
+			return TRUE;
 		}
 	}
-
-	return 0;
+	return s->deadline_ms && monotonic_ms() >= s->deadline_ms;
 }
 
-static void stop_helper_process(void) {
-	pthread_mutex_lock(&gpu_mon.mutex);
-	if(gpu_mon.radeontop.thread) {
-		gpu_mon.radeontop.stop_thread = true;
-		if(gpu_mon.radeontop.subprocess_running) {
-			subprocess_terminate(&gpu_mon.radeontop.subprocess);
-			gpu_mon.radeontop.subprocess_running = false;
-		}
+static gboolean sampler_source_dispatch(GSource *source, GSourceFunc callback, gpointer data) {
+	(void)callback;
+	(void)data;
+	struct sampler_source *s = (struct sampler_source *)source;
+	struct sampler_loop *loop = &gpu_mon.radeontop.loop;
+	for(nfds_t i = 0; i < s->npolls; ++i) {
+		loop->fds[i].revents = s->polls[i].fd >= 0 ? (short)s->polls[i].revents : 0;
 	}
-	pthread_mutex_unlock(&gpu_mon.mutex);
-	pthread_join(gpu_mon.radeontop.thread, NULL);
-	gpu_mon.radeontop.thread = 0;
+	// timed work is done by next prepare
+	return sampler_loop_dispatch();
 }
 
-static void *radeontop_thread(void *arg) {
-	(void)arg;
+static GSourceFuncs sampler_source_funcs = {
+	.prepare = sampler_source_prepare,
+	.check = sampler_source_check,
+	.dispatch = sampler_source_dispatch,
+};
 
-	memset(&gpu_mon.gpu_stats, 0, sizeof(gpu_mon.gpu_stats));
-	gpu_mon.radeontop.stop_thread = false;
+static void start_sampler_source(void) {
+	sampler_loop_init();
+	GSource *source = g_source_new(&sampler_source_funcs, sizeof(struct sampler_source));
+	g_source_attach(source, NULL);
+	gpu_mon.radeontop.source = source;
+}
 
-	while(1) {
-		/* early check for thread exit. Could happen if both radeontop and
-		 * gkrellm got int/term signal. This still could potentially trigger a
-		 * deadlock, although chances of that happening are very low.
-		 * Proper fix should do a read timeout and re-check thread stop flag, or
-		 * pthread_timedwait_np() and re-kill subprocess.
-		 * FIXME */
-		pthread_mutex_lock(&gpu_mon.mutex);
-		if(gpu_mon.radeontop.stop_thread) {
-			pthread_mutex_unlock(&gpu_mon.mutex);
-			break;
-		}
+/* Sampling in GTK main loop must not block it, so only radeontop pipes,
+ * runtime PM status, exporter sockets, and the queued sample log and
+ * recording are allowed there. Returns what given options would block on,
+ * NULL if nothing. */
+static const char *main_loop_blocker_of(gboolean clients, gboolean hwmon_chart, bool other_backend) {
+	if(clients) {
+		return "process list scans /proc";
+	}
+	if(hwmon_chart) {
+		return "power and temperature chart reads hwmon";
+	}
+	if(other_backend) {
+		return "sysfs and GRBM backends read the GPU";
+	}
+	return NULL;
+}
 
-		char cmdline_buf[CMDLINE_MAX_LEN];
-		const char *cmdline[128];
-		extract_cmdline(cmdline, sizeof(cmdline)/sizeof(cmdline[0]),
-				cmdline_buf, gpu_mon.options.radeontop_cmdline);
+/* same for current options */
+static const char *main_loop_blocker(void) {
+	bool other_backend = false;
+	for(int i = 0; i < gpu_mon.gpu_count; ++i) {
+		other_backend |= gpu_mon.gpus[i].options.backend != BACKEND_RADEONTOP;
+	}
+	return main_loop_blocker_of(gpu_mon.options.clients, gpu_mon.options.hwmon_chart, other_backend);
+}
 
-		int result = subprocess_create(cmdline, 0, &gpu_mon.radeontop.subprocess);
-		if(result != 0) {
-			fprintf(stderr, "can't launch radeontop");
-			return NULL;
-		}
-		gpu_mon.radeontop.subprocess_running = true;
+/* starts sampling in GTK main loop if so configured and nothing would block
+ * it there, in a thread otherwise */
+static void start_sampling(void) {
+	const char *blocker = main_loop_blocker();
+	if(gpu_mon.options.main_loop && blocker) {
+		fprintf(stderr, "sampling in a thread instead of gkrellm main loop: %s\n", blocker);
+	}
+	gpu_mon.radeontop.main_loop = gpu_mon.options.main_loop && !blocker;
+	gpu_mon.radeontop.reload = false;	// starts with current options anyway
+	if(gpu_mon.radeontop.main_loop) {
+		start_sampler_source();
+	} else {
 		gpu_mon.radeontop.stop_thread = false;
-		pthread_mutex_unlock(&gpu_mon.mutex);
+		pthread_create(&gpu_mon.radeontop.thread, NULL, &radeontop_thread, NULL);
+	}
+}
 
-		FILE *p = subprocess_stdout(&gpu_mon.radeontop.subprocess);
+static void store_rollup_column(struct gpu_instance *gpu, size_t age) {
+	const struct rollup_stat *sclk = rollup_get(&gpu->rollup, gpu->resolution, age, ROLLUP_SHADER_CLOCK);
+	const struct rollup_stat *pipe = rollup_get(&gpu->rollup, gpu->resolution, age, ROLLUP_GPU_PIPE);
+	gulong shader_clock, gpu_pipe;
+	if(gpu_mon.options.reduction == REDUCE_MEAN) {
+		shader_clock = rollup_mean(sclk);
+		gpu_pipe = rollup_mean(pipe);
+	} else {
+		// percentiles aren't kept in rollups, max is the closest upper bound
+		shader_clock = sclk->max;
+		gpu_pipe = pipe->max;
+	}
+	gkrellm_store_chartdata(gpu->chart, 0, shader_clock, gpu_pipe, 0);
+}
 
-		char buffer[512];
+/* redraws chart from rollups of current resolution */
+static void refill_chart(struct gpu_instance *gpu) {
+	if(gpu->resolution == 0) {
+		return;	// 1 s chart is fed directly, it will catch up
+	}
+	gkrellm_reset_chart(gpu->chart);
+	size_t columns = MIN((size_t)gkrellm_chart_width(), ROLLUP_SLOTS - 1);
+	for(size_t age = columns; age-- > 0; ) {
+		store_rollup_column(gpu, age);
+	}
+}
 
-		// eat first line
-		if(fgets(buffer, sizeof(buffer), p)) {
-			while(fgets(buffer, sizeof(buffer), p)) {
-				DBGPRINTF("%s\n", buffer);
+/* formats extra info text if values shown there have changed since last
+ * time; returns true if text has changed */
+static bool update_extra_info(struct gpu_instance *gpu) {
+	const struct gpu_stats *st = &gpu->gpu_stats_copy;
+	const struct extra_info_key key = {
+		.sclk = (int)st->sclk,
+		.busy = (int)st->busy[GPU_BLOCK_GPU],
+		.latency = st->latency_us / 100,
+		.gaps = st->gaps,
+	};
+	if(gpu->redraw.info_valid && !memcmp(&key, &gpu->redraw.info_key, sizeof(key))) {
+		return false;
+	}
+	gpu->redraw.info_key = key;
+	gpu->redraw.info_valid = true;
+	snprintf(gpu->redraw.info_text, sizeof(gpu->redraw.info_text),
+			"\\w88\\a%d\\f %d\\n\\f%.1fms \\a%ug",
+			key.sclk, key.busy, key.latency / 10.0, key.gaps);
+	return true;
+}
 
-				struct gpu_stats stats = {
-					.gpu_pipe = radeontop_extract_stat(buffer, "gpu "),
-					.shader_clock = radeontop_extract_stat(buffer, "sclk "),
-				};
+/* lists busiest processes in chart tooltip, if they have changed */
+static void update_clients_tooltip(struct gpu_instance *gpu) {
+	struct fdinfo_client clients[CLIENTS_TOP];
+	lock_shared();
+	if(gpu->clients_generation == gpu->redraw.clients_generation) {
+		unlock_shared();
+		return;
+	}
+	gpu->redraw.clients_generation = gpu->clients_generation;
+	const size_t n = gpu->client_count;
+	memcpy(clients, gpu->clients, n * sizeof(clients[0]));
+	unlock_shared();
 
-				pthread_mutex_lock(&gpu_mon.mutex);
-				memcpy(&gpu_mon.gpu_stats, &stats, sizeof(stats));
-				gpu_mon.gpu_stats.stats_timestamp = time(NULL);
-				pthread_mutex_unlock(&gpu_mon.mutex);
-			}
-		}
+	if(n == 0) {
+		gtk_widget_set_tooltip_text(gpu->chart->drawing_area, NULL);
+		return;
+	}
+	gchar text[CLIENTS_TOP * 96];
+	size_t len = 0;
+	for(size_t i = 0; i < n && len < sizeof(text); ++i) {
+		const struct fdinfo_client *c = &clients[i];
+		len += (size_t)snprintf(text + len, sizeof(text) - len,
+				"%s%s (%d): gfx %.0f%%, compute %.0f%%, vram %.0f MiB, gtt %.0f MiB",
+				i ? "\n" : "", c->comm, c->pid, c->gfx * 100.0, c->compute * 100.0,
+				c->vram_bytes / 1048576.0, c->gtt_bytes / 1048576.0);
+	}
+	gtk_widget_set_tooltip_text(gpu->chart->drawing_area, text);
+}
 
-		if(subprocess_join(&gpu_mon.radeontop.subprocess, NULL) != 0) {
-			fprintf(stderr, "subprocess_join failed, killing process\n");
-			subprocess_terminate(&gpu_mon.radeontop.subprocess);
-		}
+static void count_redraw(struct gpu_instance *gpu, enum exporter_layer layer, bool performed) {
+	_Atomic uint64_t *counter = performed ? &gpu->redraw.performed[layer] : &gpu->redraw.skipped[layer];
+	atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+}
 
-		pthread_mutex_lock(&gpu_mon.mutex);
-		gpu_mon.radeontop.subprocess_running = false;
-		bool brk = gpu_mon.radeontop.stop_thread;
-		pthread_mutex_unlock(&gpu_mon.mutex);
+static void draw_chart(struct gpu_instance *gpu) {
+	GkrellmChart *cp = gpu->chart;
 
-		if(brk) {
-			break;
+	gkrellm_draw_chartdata(cp);
+
+	const int state = atomic_load_explicit(&gpu->backend_state, memory_order_relaxed);
+	gpu->redraw.backend_state = state;
+	gpu->redraw.gpu_off = atomic_load_explicit(&gpu->gpu_off, memory_order_relaxed);
+	if(gpu->redraw.gpu_off) {
+		gchar buf[64];
+		snprintf(buf, sizeof(buf), "\\c\\f%s", _("off"));
+		gkrellm_draw_chart_text(cp, style_id, buf);
+		gkrellm_draw_chart_to_screen(cp);
+		return;
+	}
+	if(state != SUPERVISOR_UP) {
+		gchar message[sizeof(gpu->backend_message)] = "";
+		if(gpu->extra_info) {
+			lock_shared();
+			g_strlcpy(message, gpu->backend_message, sizeof(message));
+			unlock_shared();
+			g_strdelimit(message, "\\", '/');	// not a chart text escape
 		}
+		gchar buf[192];
+		snprintf(buf, sizeof(buf), "\\c\\f%s\\n\\c%s",
+				state == SUPERVISOR_CRASH_LOOP ? _("crash loop") : _("backend down"), message);
+		gkrellm_draw_chart_text(cp, style_id, buf);
+		gkrellm_draw_chart_to_screen(cp);
+		return;
+	}
 
-		fprintf(stderr, "radeontop is finished, restarting in 5 seconds\n");
-		sleep(5);	// TODO should this be configurable? define'd?
+	if(gpu->extra_info) {
+		update_extra_info(gpu);
+		gkrellm_draw_chart_text(cp, style_id, gpu->redraw.info_text);
 	}
+	gpu->redraw.bursting = atomic_load_explicit(&gpu->bursting, memory_order_relaxed);
+	if(gpu->redraw.bursting) {
+		gchar buf[32];
+		snprintf(buf, sizeof(buf), "\\b\\f%s", _("burst"));
+		gkrellm_draw_chart_text(cp, style_id, buf);
+	}
+	if(gpu->resolution > 0) {
+		static const char *const labels[ROLLUP_LEVELS] = { "1s", "10s", "1m", "10m" };
+		gchar buf[32];
+		snprintf(buf, sizeof(buf), "\\b\\r\\f%s", labels[gpu->resolution]);
+		gkrellm_draw_chart_text(cp, style_id, buf);
+	}
+	gkrellm_draw_chart_to_screen(cp);
+}
 
-	return NULL;
+/* formats hwmon chart text; returns true if it differs from what is drawn */
+static bool update_hwmon_text(struct gpu_instance *gpu) {
+	const struct gpu_stats *st = &gpu->gpu_stats_copy;
+	gchar buf[sizeof(gpu->redraw.hwmon_text)];
+	size_t len = 0;
+	buf[0] = '\0';
+	if(st->recv_time_ns && !(st->valid & HWMON_FIELDS)) {
+		len += (size_t)snprintf(buf, sizeof(buf), "\\c\\f%s", _("no hwmon"));
+	}
+	if(st->valid & GPU_FIELD_BIT(GPU_FIELD_POWER)) {
+		len += (size_t)snprintf(buf + len, sizeof(buf) - len, "\\f%.0fW ", st->power_w);
+	}
+	for(int t = GPU_TEMP_JUNCTION; t >= GPU_TEMP_EDGE; --t) {
+		if(st->valid & GPU_FIELD_BIT(GPU_FIELD_TEMP + t)) {
+			len += (size_t)snprintf(buf + len, sizeof(buf) - len, "\\a%.0fC", st->temp_c[t]);
+			break;
+		}
+	}
+	if(st->valid & GPU_FIELD_BIT(GPU_FIELD_FAN)) {
+		len += (size_t)snprintf(buf + len, sizeof(buf) - len, "\\n\\f%.0frpm", st->fan_rpm);
+	}
+	if(st->throttle) {
+		snprintf(buf + len, sizeof(buf) - len, "\\n\\c\\f%s",
+				st->throttle & GPU_THROTTLE_POWER ? _("power limited") :
+				st->throttle & GPU_THROTTLE_THERMAL ? _("thermal limited") : _("throttled"));
+	}
+	if(!strcmp(buf, gpu->redraw.hwmon_text)) {
+		return false;
+	}
+	g_strlcpy(gpu->redraw.hwmon_text, buf, sizeof(gpu->redraw.hwmon_text));
+	return true;
 }
 
-static void draw_chart(GkrellmChart *cp) {
+static void draw_hwmon_chart(struct gpu_instance *gpu) {
+	GkrellmChart *cp = gpu->hwmon_chart;
+
 	gkrellm_draw_chartdata(cp);
-	if(gpu_mon.extra_info) {
-		gchar buf[64];
-		snprintf(buf, sizeof(buf), "\\w88\\a%d\\f %d",
-				gpu_mon.gpu_stats_copy.shader_clock,
-				gpu_mon.gpu_stats_copy.gpu_pipe);
-		gkrellm_draw_chart_text(cp, style_id, buf);
+	update_hwmon_text(gpu);
+	if(gpu->redraw.hwmon_text[0]) {
+		gkrellm_draw_chart_text(cp, style_id, gpu->redraw.hwmon_text);
 	}
 	gkrellm_draw_chart_to_screen(cp);
 }
 
-static gint expose_event(GtkWidget *widget, GdkEventExpose *ev) {
+/* stores a column of power and temperature; chart is redrawn only if its
+ * text changed or the column isn't just one more of a chart wide flat line,
+ * e.g. of a GPU without hwmon */
+static void update_hwmon_chart(struct gpu_instance *gpu) {
+	const struct gpu_stats *st = &gpu->gpu_stats_copy;
+	const int t = st->valid & GPU_FIELD_BIT(GPU_FIELD_TEMP + GPU_TEMP_JUNCTION) ?
+		GPU_TEMP_JUNCTION : GPU_TEMP_EDGE;
+	const gulong power = (gulong)st->power_w, temp = (gulong)st->temp_c[t];
+	gkrellm_store_chartdata(gpu->hwmon_chart, 0, power, temp, 0);
+
+	if(power == gpu->redraw.hwmon_column[0] && temp == gpu->redraw.hwmon_column[1]) {
+		if(gpu->redraw.hwmon_flat < gpu->hwmon_chart->w) {
+			gpu->redraw.hwmon_flat++;
+		}
+	} else {
+		gpu->redraw.hwmon_column[0] = power;
+		gpu->redraw.hwmon_column[1] = temp;
+		gpu->redraw.hwmon_flat = 1;
+	}
+	if(!gpu_mon.options.hwmon_chart) {
+		return;	// hidden, drawn once shown again
+	}
+	bool dirty = gpu->redraw.hwmon_flat < gpu->hwmon_chart->w;
+	if(update_hwmon_text(gpu)) {
+		dirty = true;
+	}
+	if(dirty) {
+		draw_hwmon_chart(gpu);
+	}
+	count_redraw(gpu, EXPORTER_LAYER_HWMON, dirty);
+}
+
+static gint expose_event(GtkWidget *widget, GdkEventExpose *ev, gpointer data) {
+	struct gpu_instance *gpu = data;
 	GdkPixmap *pixmap = NULL;
-	if(widget == gpu_mon.chart->drawing_area) {
-		pixmap = gpu_mon.chart->pixmap;
-	} else if(widget == gpu_mon.chart->panel->drawing_area) {
-		pixmap = gpu_mon.chart->panel->pixmap;
+	if(widget == gpu->chart->drawing_area) {
+		pixmap = gpu->chart->pixmap;
+	} else if(widget == gpu->chart->panel->drawing_area) {
+		pixmap = gpu->chart->panel->pixmap;
+	} else if(widget == gpu->hwmon_chart->drawing_area) {
+		pixmap = gpu->hwmon_chart->pixmap;
 	}
 	if(pixmap) {
 		gdk_draw_pixmap(widget->window, gkrellm_draw_GC(1), pixmap,
@@ -225,17 +1539,60 @@ static gint expose_event(GtkWidget *widget, GdkEventExpose *ev) {
 	return FALSE;
 }
 
-static gint mouseclick_event(GtkWidget *widget, GdkEventButton *ev) {
-	if(widget != gpu_mon.chart->drawing_area) {
+static gint visibility_event(GtkWidget *widget, GdkEventVisibility *ev, gpointer data) {
+	struct gpu_instance *gpu = data;
+	(void)widget;
+	gpu->obscured = ev->state == GDK_VISIBILITY_FULLY_OBSCURED;
+	return FALSE;
+}
+
+/* asks sampler for burst capture into gpuN-<time>.burst in plugin data dir */
+static void request_burst(struct gpu_instance *gpu) {
+	// radeontop dumps averages at its own interval, more ticks (-t) don't
+	// make it dump more often. Also keeps burst writes out of main loop,
+	// which only samples radeontop
+	if(gpu->options.backend == BACKEND_RADEONTOP) {
+		return;
+	}
+	gchar name[64];
+	const time_t t = time(NULL);
+	struct tm tm;
+	localtime_r(&t, &tm);
+	const int n = snprintf(name, sizeof(name), "gpu%d-", gpu->id);
+	strftime(name + n, sizeof(name) - (size_t)n, "%Y%m%d-%H%M%S.burst", &tm);
+	gchar *path = gkrellm_make_data_file_name(PLUGIN_NAME, name);
+
+	lock_shared();
+	g_strlcpy(gpu->burst_path, path, sizeof(gpu->burst_path));
+	gpu->burst_request = true;
+	unlock_shared();
+	g_free(path);
+	wakeup_thread();
+}
+
+static gint mouseclick_event(GtkWidget *widget, GdkEventButton *ev, gpointer data) {
+	struct gpu_instance *gpu = data;
+	if(widget == gpu->hwmon_chart->drawing_area && ev->button == 3) {
+		gkrellm_chartconfig_window_create(gpu->hwmon_chart);
+	}
+	if(widget != gpu->chart->drawing_area) {
 		return FALSE;
 	}
 
-	if(ev->button == 1 && ev->type == GDK_BUTTON_PRESS) {
-		gpu_mon.extra_info = !gpu_mon.extra_info;
-		draw_chart(gpu_mon.chart);
+	if(ev->button == 1 && ev->type == GDK_BUTTON_PRESS && (ev->state & GDK_SHIFT_MASK)) {
+		request_burst(gpu);
+	} else if(ev->button == 1 && ev->type == GDK_BUTTON_PRESS) {
+		gpu->extra_info = !gpu->extra_info;
+		draw_chart(gpu);
+		gkrellm_config_modified();
+	} else if(ev->button == 2 && ev->type == GDK_BUTTON_PRESS) {
+		// cycle chart resolution: 1 s, 10 s, 1 min, 10 min per column
+		gpu->resolution = (gpu->resolution + 1) % ROLLUP_LEVELS;
+		refill_chart(gpu);
+		draw_chart(gpu);
 		gkrellm_config_modified();
 	} else if(ev->button == 3 || (ev->button == 1 && ev->type == GDK_2BUTTON_PRESS)) {
-		gkrellm_chartconfig_window_create(gpu_mon.chart);
+		gkrellm_chartconfig_window_create(gpu->chart);
 	}
 	return FALSE;
 }
@@ -246,63 +1603,293 @@ static void setup_scaling(GkrellmChartconfig *cf, void *cp) {
 	gkrellm_set_chartconfig_grid_resolution(cf, SCALE_MAX / FULL_SCALE_GRIDS);
 }
 
-static void create_plugin(GtkWidget *vbox, gint first_create) {
-	gpu_mon.enabled = TRUE;
+static struct {
+	struct gpu_instance *gpu;
+	uint64_t first_second;	// of chart
+	int64_t mono_offset_s;	// wall clock to CLOCK_MONOTONIC
+	uint64_t second;	// wall clock second being collected
+	int columns_left;
+	size_t n;
+	float gpu_pipe[SAMPLE_RING_SIZE];
+	float shader_clock[SAMPLE_RING_SIZE];
+} prefill;
+
+/* stores collected second as chart column, and empty columns for seconds
+ * without samples before next_second */
+static void prefill_flush(uint64_t next_second) {
+	if(prefill.n > 0 && prefill.columns_left > 0) {
+		gulong shader_clock = sample_reduce(prefill.shader_clock, prefill.n, gpu_mon.options.reduction);
+		gulong gpu_pipe = sample_reduce(prefill.gpu_pipe, prefill.n, gpu_mon.options.reduction);
+		gkrellm_store_chartdata(prefill.gpu->chart, 0, shader_clock, gpu_pipe, 0);
+		prefill.columns_left--;
+	}
+	for(uint64_t s = prefill.second + 1; s < next_second && prefill.columns_left > 0; ++s) {
+		gkrellm_store_chartdata(prefill.gpu->chart, 0, 0, 0, 0);
+		prefill.columns_left--;
+	}
+	prefill.second = next_second;
+	prefill.n = 0;
+}
 
-	if(first_create) {
-		pthread_mutex_init(&gpu_mon.mutex, NULL);
-		gkrellm_disable_plugin_connect(gpu_plugin_mon_ptr, &stop_helper_process);
-		atexit(&stop_helper_process);
+static void prefill_record(const struct history_record *rec, void *data) {
+	(void)data;
+	uint64_t second = rec->time_us / 1000000;
+
+	const float values[ROLLUP_CHANNELS] = {
+		[ROLLUP_SHADER_CLOCK] = rec->shader_clock,
+		[ROLLUP_GPU_PIPE] = rec->gpu_pipe,
+	};
+	int64_t mono_s = (int64_t)second + prefill.mono_offset_s;
+	if(mono_s >= 0) {
+		rollup_add(&prefill.gpu->rollup, (uint64_t)mono_s, values);
+	}
 
-		gpu_mon.vbox = gtk_vbox_new(FALSE, 0);
-		gtk_container_add(GTK_CONTAINER(vbox), gpu_mon.vbox);
-		gtk_widget_show(gpu_mon.vbox);
+	if(second < prefill.first_second) {
+		return;
+	}
+	if(second != prefill.second) {
+		prefill_flush(second);
+	}
+	if(prefill.n < SAMPLE_RING_SIZE) {
+		prefill.gpu_pipe[prefill.n] = rec->gpu_pipe;
+		prefill.shader_clock[prefill.n] = rec->shader_clock;
+		prefill.n++;
+	}
+}
+
+/* restores rollups and chart from history file */
+static void prefill_chart(struct gpu_instance *gpu) {
+	const int width = gkrellm_chart_width();
+	const uint64_t now_s = clock_ns(CLOCK_REALTIME) / 1000000000;
+	const uint64_t mono_now_s = clock_ns(CLOCK_MONOTONIC) / 1000000000;
+
+	prefill.gpu = gpu;
+	prefill.first_second = prefill.second = now_s - (uint64_t)width;
+	prefill.mono_offset_s = (int64_t)mono_now_s - (int64_t)now_s;
+	prefill.columns_left = width;
+	prefill.n = 0;
+	if(history_foreach(&gpu->history, 0, prefill_record, NULL) == 0) {
+		return;
+	}
+	rollup_advance(&gpu->rollup, mono_now_s);
 
-		gpu_mon.chart = gkrellm_chart_new0();
-		gpu_mon.chart->panel = gkrellm_panel_new0();
+	if(gpu->resolution == 0) {
+		prefill_flush(now_s);
 	} else {
-		gkrellm_destroy_decal_list(gpu_mon.chart->panel);
-		gkrellm_destroy_krell_list(gpu_mon.chart->panel);
+		refill_chart(gpu);
 	}
+}
 
-	if(!gpu_mon.radeontop.thread) {
-		pthread_create(&gpu_mon.radeontop.thread, NULL, &radeontop_thread, NULL);
+static void create_gpu_chart(GtkWidget *vbox, struct gpu_instance *gpu, gint first_create) {
+	if(first_create) {
+		gpu->chart = gkrellm_chart_new0();
+		gpu->chart->panel = gkrellm_panel_new0();
+	} else {
+		gkrellm_destroy_decal_list(gpu->chart->panel);
+		gkrellm_destroy_krell_list(gpu->chart->panel);
 	}
 
 	GkrellmStyle *style = gkrellm_panel_style(style_id);
 
-	gkrellm_chart_create(vbox, gpu_plugin_mon_ptr, gpu_mon.chart, &gpu_mon.chart_config);
+	gkrellm_chart_create(vbox, gpu_plugin_mon_ptr, gpu->chart, &gpu->chart_config);
 
-	GkrellmChartdata *cd = gkrellm_add_default_chartdata(gpu_mon.chart, "shader clock");
+	GkrellmChartdata *cd = gkrellm_add_default_chartdata(gpu->chart, "shader clock");
 	gkrellm_monotonic_chartdata(cd, FALSE);
 	gkrellm_set_chartdata_draw_style_default(cd, CHARTDATA_LINE);
 	gkrellm_set_chartdata_flags(cd, CHARTDATA_ALLOW_HIDE);
 
-	cd = gkrellm_add_default_chartdata(gpu_mon.chart, "graphics pipe");
+	cd = gkrellm_add_default_chartdata(gpu->chart, "graphics pipe");
+	gkrellm_monotonic_chartdata(cd, FALSE);
+
+	gkrellm_chartconfig_fixed_grids_connect(gpu->chart->config,
+				setup_scaling, gpu->chart);
+
+	gkrellm_alloc_chartdata(gpu->chart);
+	gkrellm_set_draw_chart_function(gpu->chart, draw_chart, gpu);
+	if(first_create) {
+		prefill_chart(gpu);
+	}
+
+	if(first_create) {
+		gpu->hwmon_chart = gkrellm_chart_new0();
+	}
+	gkrellm_chart_create(vbox, gpu_plugin_mon_ptr, gpu->hwmon_chart, &gpu->hwmon_chart_config);
+	cd = gkrellm_add_default_chartdata(gpu->hwmon_chart, "power");
 	gkrellm_monotonic_chartdata(cd, FALSE);
+	cd = gkrellm_add_default_chartdata(gpu->hwmon_chart, "temperature");
+	gkrellm_monotonic_chartdata(cd, FALSE);
+	gkrellm_set_chartdata_draw_style_default(cd, CHARTDATA_LINE);
+	gkrellm_alloc_chartdata(gpu->hwmon_chart);
+	gkrellm_set_draw_chart_function(gpu->hwmon_chart, draw_hwmon_chart, gpu);
+	if(!gpu_mon.options.hwmon_chart) {
+		gkrellm_chart_hide(gpu->hwmon_chart, FALSE);
+	}
 
-	gkrellm_chartconfig_fixed_grids_connect(gpu_mon.chart->config,
-				setup_scaling, gpu_mon.chart);
+	gpu->krell = gkrellm_create_krell(gpu->chart->panel, gkrellm_krell_panel_piximage(style_id), style);
+	gpu->redraw.krell_valid = false;
 
-	gkrellm_alloc_chartdata(gpu_mon.chart);
-	gkrellm_set_draw_chart_function(gpu_mon.chart, draw_chart, gpu_mon.chart);
+	gkrellm_monotonic_krell_values(gpu->krell, FALSE);
+	gkrellm_set_krell_full_scale(gpu->krell, SCALE_MARK, 1);
 
-	gpu_mon.krell = gkrellm_create_krell(gpu_mon.chart->panel, gkrellm_krell_panel_piximage(style_id), style);
+	gchar *label = gpu_mon.gpu_count > 1 ?
+			g_strdup_printf("GPU %d", gpu->id) : g_strdup("GPU");
+	gkrellm_panel_configure(gpu->chart->panel, label, style);
+	gkrellm_panel_create(vbox, gpu_plugin_mon_ptr, gpu->chart->panel);
 
-	gkrellm_monotonic_krell_values(gpu_mon.krell, FALSE);
-	gkrellm_set_krell_full_scale(gpu_mon.krell, SCALE_MARK, 1);
+	if(first_create) {
+		gtk_signal_connect(GTK_OBJECT(gpu->chart->drawing_area), "expose_event",
+				GTK_SIGNAL_FUNC(expose_event), gpu);
+		gtk_signal_connect(GTK_OBJECT(gpu->chart->panel->drawing_area), "expose_event",
+				GTK_SIGNAL_FUNC(expose_event), gpu);
+		gtk_signal_connect(GTK_OBJECT(gpu->chart->drawing_area), "button_press_event",
+				GTK_SIGNAL_FUNC(mouseclick_event), gpu);
+		gtk_signal_connect(GTK_OBJECT(gpu->hwmon_chart->drawing_area), "expose_event",
+				GTK_SIGNAL_FUNC(expose_event), gpu);
+		gtk_signal_connect(GTK_OBJECT(gpu->hwmon_chart->drawing_area), "button_press_event",
+				GTK_SIGNAL_FUNC(mouseclick_event), gpu);
+		gtk_widget_add_events(gpu->chart->drawing_area, GDK_VISIBILITY_NOTIFY_MASK);
+		gtk_signal_connect(GTK_OBJECT(gpu->chart->drawing_area), "visibility_notify_event",
+				GTK_SIGNAL_FUNC(visibility_event), gpu);
+	}
+}
 
-	gkrellm_panel_configure(gpu_mon.chart->panel, g_strdup("GPU"), style);
-	gkrellm_panel_create(vbox, gpu_plugin_mon_ptr, gpu_mon.chart->panel);
+static void create_plugin(GtkWidget *vbox, gint first_create) {
+	gpu_mon.enabled = TRUE;
 
 	if(first_create) {
-		gtk_signal_connect(GTK_OBJECT(gpu_mon.chart->drawing_area), "expose_event",
-				GTK_SIGNAL_FUNC(expose_event), NULL);
-		gtk_signal_connect(GTK_OBJECT(gpu_mon.chart->panel->drawing_area), "expose_event",
-				GTK_SIGNAL_FUNC(expose_event), NULL);
-		gtk_signal_connect(GTK_OBJECT(gpu_mon.chart->drawing_area), "button_press_event",
-				GTK_SIGNAL_FUNC(mouseclick_event), NULL);
+		pthread_mutex_init(&gpu_mon.mutex, NULL);
+		if(gpu_mon.radeontop.wake_fd < 0) {
+			gpu_mon.radeontop.wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		}
+		gkrellm_disable_plugin_connect(gpu_plugin_mon_ptr, &stop_helper_process);
+		atexit(&plugin_exit);
+
+		gpu_mon.vbox = gtk_vbox_new(FALSE, 0);
+		gtk_container_add(GTK_CONTAINER(vbox), gpu_mon.vbox);
+		gtk_widget_show(gpu_mon.vbox);
+
+		gpu_mon.gpu_count = CLAMP(gpu_mon.options.gpu_count, 1, MAX_GPUS);
+
+		// rollups start empty at boot time, so history could be replayed into them
+		for(int i = 0; i < gpu_mon.gpu_count; ++i) {
+			rollup_init(&gpu_mon.gpus[i].rollup, 0);
+		}
+
+		for(int i = 0; gpu_mon.options.history && i < gpu_mon.gpu_count; ++i) {
+			if(gpu_mon.gpus[i].history.header) {
+				continue;	// kept from before plugin was disabled
+			}
+			gchar name[32];
+			snprintf(name, sizeof(name), "gpu%d.hist", i);
+			gchar *path = gkrellm_make_data_file_name(PLUGIN_NAME, name);
+			history_open(&gpu_mon.gpus[i].history, path);
+			g_free(path);
+		}
+	}
+
+	if(!gpu_mon.radeontop.thread && !gpu_mon.radeontop.source) {
+		start_sampling();
+	}
+
+	for(int i = 0; i < gpu_mon.gpu_count; ++i) {
+		create_gpu_chart(vbox, &gpu_mon.gpus[i], first_create);
+	}
+}
+
+/* greys out main loop option while options as set in dialog keep sampling
+ * in a thread, and tells why */
+static void update_main_loop_check(GtkWidget *widget, gpointer data) {
+	(void)widget;
+	(void)data;
+	bool other_backend = false;
+	for(int i = 0; i < gpu_mon.gpu_count; ++i) {
+		GtkWidget *combo = gpu_mon.gpus[i].options.backend_combo;
+		other_backend |= combo && gtk_combo_box_get_active(GTK_COMBO_BOX(combo)) != BACKEND_RADEONTOP;
+	}
+	const char *blocker = main_loop_blocker_of(
+			gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(gpu_mon.options.clients_check)),
+			gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(gpu_mon.options.hwmon_chart_check)),
+			other_backend);
+	gtk_widget_set_sensitive(gpu_mon.options.main_loop_check, !blocker);
+	if(blocker) {
+		gchar *tip = g_strdup_printf(_("Sampling stays in a thread: %s, which could block gkrellm"),
+				blocker);
+		gtk_widget_set_tooltip_text(gpu_mon.options.main_loop_check, tip);
+		g_free(tip);
+	} else {
+		gtk_widget_set_tooltip_text(gpu_mon.options.main_loop_check,
+				_("Only with radeontop backend, and without process list or "
+				"power and temperature chart, which could block gkrellm"));
+	}
+}
+
+static void create_gpu_tab(GtkWidget *tabs, struct gpu_instance *gpu) {
+	gchar *title = g_strdup_printf(_("GPU %d"), gpu->id);
+	GtkWidget *vbox = gkrellm_gtk_framed_notebook_page(tabs, title);
+	g_free(title);
+	GtkWidget *vbox1 = gkrellm_gtk_framed_vbox(vbox, _("Launch Options"), 4, FALSE, 0, 2);
+
+	GtkWidget *hbox = gtk_hbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox1), hbox, FALSE, FALSE, 0);
+	GtkWidget *label = gtk_label_new(_("radeontop options"));
+	gtk_box_pack_start(GTK_BOX(hbox), label, TRUE, TRUE, 0);
+	gpu->options.radeontop_cmdline_entry = gtk_entry_new();
+	if(strlen(gpu->options.radeontop_cmdline) > 0) {
+		gtk_entry_set_text(GTK_ENTRY(gpu->options.radeontop_cmdline_entry),
+				gpu->options.radeontop_cmdline);
 	}
+	gtk_box_pack_start(GTK_BOX(hbox), gpu->options.radeontop_cmdline_entry, TRUE, TRUE, 8);
+
+	label = gtk_label_new(_("default options are \"" RADEONTOP_DEFAULT_CMDLINE "\",\n"
+				"add \"-b <bus>\" to select GPU"));
+	gtk_box_pack_start(GTK_BOX(vbox1), label, TRUE, TRUE, 0);
+
+	hbox = gtk_hbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox1), hbox, FALSE, FALSE, 0);
+	label = gtk_label_new(_("Record radeontop output to (empty to disable)"));
+	gtk_box_pack_start(GTK_BOX(hbox), label, TRUE, TRUE, 0);
+	gpu->options.record_entry = gtk_entry_new();
+	gtk_entry_set_text(GTK_ENTRY(gpu->options.record_entry), gpu->options.record);
+	gtk_box_pack_start(GTK_BOX(hbox), gpu->options.record_entry, TRUE, TRUE, 8);
+
+	hbox = gtk_hbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox1), hbox, FALSE, FALSE, 0);
+	label = gtk_label_new(_("Read GPU load from"));
+	gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+	gpu->options.backend_combo = gtk_combo_box_new_text();
+	// in enum backend order
+	gtk_combo_box_append_text(GTK_COMBO_BOX(gpu->options.backend_combo), _("radeontop"));
+	gtk_combo_box_append_text(GTK_COMBO_BOX(gpu->options.backend_combo), _("amdgpu sysfs"));
+	gtk_combo_box_append_text(GTK_COMBO_BOX(gpu->options.backend_combo), _("GRBM registers"));
+	gtk_combo_box_set_active(GTK_COMBO_BOX(gpu->options.backend_combo),
+			gpu->options.backend);
+	gtk_widget_set_tooltip_text(gpu->options.backend_combo,
+			_("Shift-click on chart captures a burst with amdgpu sysfs and GRBM registers"));
+	g_signal_connect(G_OBJECT(gpu->options.backend_combo), "changed",
+			G_CALLBACK(update_main_loop_check), NULL);
+	gtk_box_pack_start(GTK_BOX(hbox), gpu->options.backend_combo, FALSE, FALSE, 8);
+
+	vbox1 = gkrellm_gtk_framed_vbox(vbox, _("amdgpu sysfs"), 4, FALSE, 0, 2);
+	hbox = gtk_hbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox1), hbox, FALSE, FALSE, 0);
+	label = gtk_label_new(_("DRM card (also watched for runtime suspend)"));
+	gtk_box_pack_start(GTK_BOX(hbox), label, TRUE, TRUE, 0);
+	gpu->options.sysfs_card_entry = gtk_entry_new();
+	gtk_entry_set_text(GTK_ENTRY(gpu->options.sysfs_card_entry),
+			gpu->options.sysfs_card);
+	gtk_box_pack_start(GTK_BOX(hbox), gpu->options.sysfs_card_entry, TRUE, TRUE, 8);
+
+	gkrellm_gtk_spin_button(vbox1, &gpu->options.sysfs_interval_spin,
+			gpu->options.sysfs_interval_ms, 50, 10000, 50, 500, 0, 60,
+			NULL, NULL, FALSE, _("Sample interval (ms)"));
+
+	vbox1 = gkrellm_gtk_framed_vbox(vbox, _("GRBM registers"), 4, FALSE, 0, 2);
+	gkrellm_gtk_spin_button(vbox1, &gpu->options.grbm_ticks_spin,
+			gpu->options.grbm_ticks, 1, 1000, 10, 100, 0, 60,
+			NULL, NULL, FALSE, _("Register reads per second"));
+	label = gtk_label_new(_("read in-process from render node of DRM card above,\n"
+				"at sample interval above; needs build with libdrm"));
+	gtk_box_pack_start(GTK_BOX(vbox1), label, TRUE, TRUE, 0);
 }
 
 static void create_plugin_tab(GtkWidget *tabs_vbox) {
@@ -311,42 +1898,234 @@ static void create_plugin_tab(GtkWidget *tabs_vbox) {
 	gtk_box_pack_start(GTK_BOX(tabs_vbox), tabs, TRUE, TRUE, 0);
 
 	GtkWidget *vbox = gkrellm_gtk_framed_notebook_page(tabs, _("Setup"));
-	GtkWidget *vbox1 = gkrellm_gtk_framed_vbox(vbox, _("Launch Options"), 4, FALSE, 0, 2);
+	GtkWidget *vbox1 = gkrellm_gtk_framed_vbox(vbox, _("GPUs"), 4, FALSE, 0, 2);
+	gkrellm_gtk_spin_button(vbox1, &gpu_mon.options.gpu_count_spin,
+			gpu_mon.options.gpu_count, 1, MAX_GPUS, 1, 1, 0, 60,
+			NULL, NULL, FALSE, _("Number of monitored GPUs (applied on restart)"));
 
 	GtkWidget *hbox = gtk_hbox_new(FALSE, 0);
 	gtk_box_pack_start(GTK_BOX(vbox1), hbox, FALSE, FALSE, 0);
-	GtkWidget *label = gtk_label_new(_("radeontop options"));
-	gtk_box_pack_start(GTK_BOX(hbox), label, TRUE, TRUE, 0);
-	gpu_mon.options.radeontop_cmdline_entry = gtk_entry_new();
-	if(strlen(gpu_mon.options.radeontop_cmdline) > 0) {
-		gtk_entry_set_text(GTK_ENTRY(gpu_mon.options.radeontop_cmdline_entry),
-				gpu_mon.options.radeontop_cmdline);
+	GtkWidget *label = gtk_label_new(_("Chart samples within a second by"));
+	gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+	gpu_mon.options.reduction_combo = gtk_combo_box_new_text();
+	// same order as enum sample_reduction
+	gtk_combo_box_append_text(GTK_COMBO_BOX(gpu_mon.options.reduction_combo), _("mean"));
+	gtk_combo_box_append_text(GTK_COMBO_BOX(gpu_mon.options.reduction_combo), _("maximum"));
+	gtk_combo_box_append_text(GTK_COMBO_BOX(gpu_mon.options.reduction_combo), _("95th percentile"));
+	gtk_combo_box_set_active(GTK_COMBO_BOX(gpu_mon.options.reduction_combo),
+			gpu_mon.options.reduction);
+	gtk_box_pack_start(GTK_BOX(hbox), gpu_mon.options.reduction_combo, FALSE, FALSE, 8);
+
+	gkrellm_gtk_check_button(vbox1, &gpu_mon.options.history_check,
+			gpu_mon.options.history, FALSE, 0,
+			_("Keep chart history across restarts (applied on restart)"));
+	gkrellm_gtk_check_button(vbox1, &gpu_mon.options.pause_hidden_check,
+			gpu_mon.options.pause_hidden, FALSE, 0,
+			_("Pause sampling while chart is hidden (unless exported)"));
+	gkrellm_gtk_check_button(vbox1, &gpu_mon.options.clients_check,
+			gpu_mon.options.clients, FALSE, 0,
+			_("Show processes using GPU in chart tooltip"));
+	gkrellm_gtk_check_button(vbox1, &gpu_mon.options.hwmon_chart_check,
+			gpu_mon.options.hwmon_chart, FALSE, 0,
+			_("Show power and temperature chart"));
+	gkrellm_gtk_check_button(vbox1, &gpu_mon.options.main_loop_check,
+			gpu_mon.options.main_loop, FALSE, 0,
+			_("Sample in gkrellm main loop instead of a thread"));
+	g_signal_connect(G_OBJECT(gpu_mon.options.clients_check), "toggled",
+			G_CALLBACK(update_main_loop_check), NULL);
+	g_signal_connect(G_OBJECT(gpu_mon.options.hwmon_chart_check), "toggled",
+			G_CALLBACK(update_main_loop_check), NULL);
+
+	vbox1 = gkrellm_gtk_framed_vbox(vbox, _("OpenMetrics exporter"), 4, FALSE, 0, 2);
+	hbox = gtk_hbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox1), hbox, FALSE, FALSE, 0);
+	label = gtk_label_new(_("Listen on (unix:<path> or tcp:<port>, empty to disable)"));
+	gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+	gpu_mon.options.exporter_entry = gtk_entry_new();
+	gtk_entry_set_text(GTK_ENTRY(gpu_mon.options.exporter_entry), gpu_mon.options.exporter);
+	gtk_box_pack_start(GTK_BOX(hbox), gpu_mon.options.exporter_entry, TRUE, TRUE, 8);
+
+	vbox1 = gkrellm_gtk_framed_vbox(vbox, _("Shared memory"), 4, FALSE, 0, 2);
+	hbox = gtk_hbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox1), hbox, FALSE, FALSE, 0);
+	label = gtk_label_new(_("Publish samples as (e.g. /gkrellmradeontop, empty to disable)"));
+	gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+	gpu_mon.options.shm_entry = gtk_entry_new();
+	gtk_entry_set_text(GTK_ENTRY(gpu_mon.options.shm_entry), gpu_mon.options.shm);
+	gtk_box_pack_start(GTK_BOX(hbox), gpu_mon.options.shm_entry, TRUE, TRUE, 8);
+
+	vbox1 = gkrellm_gtk_framed_vbox(vbox, _("Sample log"), 4, FALSE, 0, 2);
+	hbox = gtk_hbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox1), hbox, FALSE, FALSE, 0);
+	label = gtk_label_new(_("Log samples to (empty to disable)"));
+	gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+	gpu_mon.options.log_entry = gtk_entry_new();
+	gtk_entry_set_text(GTK_ENTRY(gpu_mon.options.log_entry), gpu_mon.options.log);
+	gtk_box_pack_start(GTK_BOX(hbox), gpu_mon.options.log_entry, TRUE, TRUE, 8);
+
+	for(int i = 0; i < gpu_mon.gpu_count; ++i) {
+		create_gpu_tab(tabs, &gpu_mon.gpus[i]);
 	}
-	gtk_box_pack_start(GTK_BOX(hbox), gpu_mon.options.radeontop_cmdline_entry, TRUE, TRUE, 8);
+	update_main_loop_check(NULL, NULL);
+}
 
-	label = gtk_label_new(_("default options are \"" RADEONTOP_DEFAULT_CMDLINE "\""));
-	gtk_box_pack_start(GTK_BOX(vbox1), label, TRUE, TRUE, 0);
+static void apply_gpu_config(struct gpu_instance *gpu) {
+	if(gpu->options.radeontop_cmdline_entry) {
+		g_strlcpy(gpu->options.radeontop_cmdline,
+				gtk_entry_get_text(GTK_ENTRY(gpu->options.radeontop_cmdline_entry)),
+				sizeof(gpu->options.radeontop_cmdline));
+	}
+	if(gpu->options.record_entry) {
+		g_strlcpy(gpu->options.record,
+				gtk_entry_get_text(GTK_ENTRY(gpu->options.record_entry)),
+				sizeof(gpu->options.record));
+	}
+	if(gpu->options.backend_combo) {
+		gpu->options.backend = gtk_combo_box_get_active(
+				GTK_COMBO_BOX(gpu->options.backend_combo));
+	}
+	if(gpu->options.sysfs_card_entry) {
+		g_strlcpy(gpu->options.sysfs_card,
+				gtk_entry_get_text(GTK_ENTRY(gpu->options.sysfs_card_entry)),
+				sizeof(gpu->options.sysfs_card));
+	}
+	if(gpu->options.sysfs_interval_spin) {
+		gpu->options.sysfs_interval_ms = gtk_spin_button_get_value_as_int(
+				GTK_SPIN_BUTTON(gpu->options.sysfs_interval_spin));
+	}
+	if(gpu->options.grbm_ticks_spin) {
+		gpu->options.grbm_ticks = gtk_spin_button_get_value_as_int(
+				GTK_SPIN_BUTTON(gpu->options.grbm_ticks_spin));
+	}
 }
 
 static void apply_config(void) {
-	if(gpu_mon.options.radeontop_cmdline_entry) {
-		g_strlcpy(gpu_mon.options.radeontop_cmdline,
-				gtk_entry_get_text(GTK_ENTRY(gpu_mon.options.radeontop_cmdline_entry)),
-				sizeof(gpu_mon.options.radeontop_cmdline));
+	lock_shared();
+	if(gpu_mon.options.gpu_count_spin) {
+		gpu_mon.options.gpu_count = gtk_spin_button_get_value_as_int(
+				GTK_SPIN_BUTTON(gpu_mon.options.gpu_count_spin));
+	}
+	if(gpu_mon.options.reduction_combo) {
+		gpu_mon.options.reduction = gtk_combo_box_get_active(
+				GTK_COMBO_BOX(gpu_mon.options.reduction_combo));
+	}
+	if(gpu_mon.options.history_check) {
+		gpu_mon.options.history = gtk_toggle_button_get_active(
+				GTK_TOGGLE_BUTTON(gpu_mon.options.history_check));
+	}
+	if(gpu_mon.options.pause_hidden_check) {
+		gpu_mon.options.pause_hidden = gtk_toggle_button_get_active(
+				GTK_TOGGLE_BUTTON(gpu_mon.options.pause_hidden_check));
+	}
+	if(gpu_mon.options.main_loop_check) {
+		gpu_mon.options.main_loop = gtk_toggle_button_get_active(
+				GTK_TOGGLE_BUTTON(gpu_mon.options.main_loop_check));
+	}
+	if(gpu_mon.options.hwmon_chart_check) {
+		gpu_mon.options.hwmon_chart = gtk_toggle_button_get_active(
+				GTK_TOGGLE_BUTTON(gpu_mon.options.hwmon_chart_check));
+		for(int i = 0; i < gpu_mon.gpu_count; ++i) {
+			if(gpu_mon.options.hwmon_chart) {
+				gkrellm_chart_show(gpu_mon.gpus[i].hwmon_chart, FALSE);
+				gpu_mon.gpus[i].redraw.hwmon_flat = 0;	// redraw what it missed
+			} else {
+				gkrellm_chart_hide(gpu_mon.gpus[i].hwmon_chart, FALSE);
+			}
+		}
+	}
+	if(gpu_mon.options.clients_check) {
+		gpu_mon.options.clients = gtk_toggle_button_get_active(
+				GTK_TOGGLE_BUTTON(gpu_mon.options.clients_check));
+	}
+	if(gpu_mon.options.exporter_entry) {
+		g_strlcpy(gpu_mon.options.exporter,
+				gtk_entry_get_text(GTK_ENTRY(gpu_mon.options.exporter_entry)),
+				sizeof(gpu_mon.options.exporter));
+	}
+	if(gpu_mon.options.shm_entry) {
+		g_strlcpy(gpu_mon.options.shm,
+				gtk_entry_get_text(GTK_ENTRY(gpu_mon.options.shm_entry)),
+				sizeof(gpu_mon.options.shm));
+	}
+	if(gpu_mon.options.log_entry) {
+		g_strlcpy(gpu_mon.options.log,
+				gtk_entry_get_text(GTK_ENTRY(gpu_mon.options.log_entry)),
+				sizeof(gpu_mon.options.log));
+	}
+	for(int i = 0; i < gpu_mon.gpu_count; ++i) {
+		apply_gpu_config(&gpu_mon.gpus[i]);
+	}
+
+	// restart backends to apply new args
+	gpu_mon.radeontop.reload = true;
+	unlock_shared();
+
+	// or whole sampler, if it should move in or out of main loop
+	const bool running = gpu_mon.radeontop.thread || gpu_mon.radeontop.source;
+	if(running && gpu_mon.radeontop.main_loop != (gpu_mon.options.main_loop && !main_loop_blocker())) {
+		stop_helper_process();
+		start_sampling();
+	} else {
+		wakeup_thread();
 	}
+}
 
-	// restart process to apply new args
-	pthread_mutex_lock(&gpu_mon.mutex);
-	if(gpu_mon.radeontop.subprocess_running) {
-		subprocess_terminate(&gpu_mon.radeontop.subprocess);
+/* GPU 0 uses unprefixed keys, compatible with single-GPU configs;
+ * others are saved as "gpuN.key" */
+static void save_gpu_config(FILE *f, struct gpu_instance *gpu) {
+	gchar prefix[16] = "";
+	gchar name[16];
+	if(gpu->id > 0) {
+		snprintf(prefix, sizeof(prefix), "gpu%d.", gpu->id);
 	}
-	pthread_mutex_unlock(&gpu_mon.mutex);
+	snprintf(name, sizeof(name), "gpu%d", gpu->id);
+
+	gkrellm_save_chartconfig(f, gpu->chart_config, PLUGIN_KEYWORD,
+			gpu->id > 0 ? name : NULL);
+	snprintf(name, sizeof(name), "hwmon%d", gpu->id);
+	gkrellm_save_chartconfig(f, gpu->hwmon_chart_config, PLUGIN_KEYWORD, name);
+	fprintf(f, "%s %sextra_info %d\n", PLUGIN_KEYWORD, prefix, gpu->extra_info);
+	fprintf(f, "%s %sresolution %d\n", PLUGIN_KEYWORD, prefix, gpu->resolution);
+	fprintf(f, "%s %sradeontop_cmdline %s\n", PLUGIN_KEYWORD, prefix, gpu->options.radeontop_cmdline);
+	fprintf(f, "%s %srecord %s\n", PLUGIN_KEYWORD, prefix, gpu->options.record);
+	fprintf(f, "%s %sbackend %d\n", PLUGIN_KEYWORD, prefix, gpu->options.backend);
+	fprintf(f, "%s %ssysfs_card %s\n", PLUGIN_KEYWORD, prefix, gpu->options.sysfs_card);
+	fprintf(f, "%s %ssysfs_interval_ms %d\n", PLUGIN_KEYWORD, prefix, gpu->options.sysfs_interval_ms);
+	fprintf(f, "%s %sgrbm_ticks %d\n", PLUGIN_KEYWORD, prefix, gpu->options.grbm_ticks);
+	fprintf(f, "%s %sgrbm_device %s\n", PLUGIN_KEYWORD, prefix, gpu->options.grbm_device);
 }
 
 static void save_config(FILE *f) {
-	gkrellm_save_chartconfig(f, gpu_mon.chart_config, PLUGIN_KEYWORD, NULL);
-	fprintf(f, "%s extra_info %d\n", PLUGIN_KEYWORD, gpu_mon.extra_info);
-	fprintf(f, "%s radeontop_cmdline %s\n", PLUGIN_KEYWORD, gpu_mon.options.radeontop_cmdline);
+	fprintf(f, "%s gpu_count %d\n", PLUGIN_KEYWORD, gpu_mon.options.gpu_count);
+	fprintf(f, "%s sysfs_root %s\n", PLUGIN_KEYWORD, gpu_mon.options.sysfs_root);
+	fprintf(f, "%s proc_root %s\n", PLUGIN_KEYWORD, gpu_mon.options.proc_root);
+	fprintf(f, "%s reduction %d\n", PLUGIN_KEYWORD, gpu_mon.options.reduction);
+	fprintf(f, "%s history %d\n", PLUGIN_KEYWORD, gpu_mon.options.history);
+	fprintf(f, "%s pause_hidden %d\n", PLUGIN_KEYWORD, gpu_mon.options.pause_hidden);
+	fprintf(f, "%s main_loop %d\n", PLUGIN_KEYWORD, gpu_mon.options.main_loop);
+	fprintf(f, "%s clients %d\n", PLUGIN_KEYWORD, gpu_mon.options.clients);
+	fprintf(f, "%s hwmon_chart %d\n", PLUGIN_KEYWORD, gpu_mon.options.hwmon_chart);
+	fprintf(f, "%s exporter %s\n", PLUGIN_KEYWORD, gpu_mon.options.exporter);
+	fprintf(f, "%s shm %s\n", PLUGIN_KEYWORD, gpu_mon.options.shm);
+	fprintf(f, "%s log %s\n", PLUGIN_KEYWORD, gpu_mon.options.log);
+	// instances that weren't created still have their loaded config
+	for(int i = 0; i < MAX_GPUS; ++i) {
+		if(i < gpu_mon.gpu_count || i < gpu_mon.options.gpu_count) {
+			save_gpu_config(f, &gpu_mon.gpus[i]);
+		}
+	}
+}
+
+/* strips "gpuN." prefix from keyword (or "gpuN " from chart config data),
+ * returns N or 0 if there was no prefix */
+static int config_gpu_index(gchar **str, char sep) {
+	int idx, n = 0;
+	if(sscanf(*str, "gpu%d%n", &idx, &n) == 1 && (*str)[n] == sep &&
+			idx >= 0 && idx < MAX_GPUS) {
+		*str += n + 1;
+		return idx;
+	}
+	return 0;
 }
 
 static void load_config(gchar *arg) {
@@ -354,44 +2133,199 @@ static void load_config(gchar *arg) {
 	if(sscanf(arg, "%31s %[^\n]", config_keyword, config_data) != 2)
 		return;
 
-	if(!strcmp(config_keyword, "extra_info")) {
-		sscanf(config_data, "%d\n", &gpu_mon.extra_info);
-	} else if(!strcmp(config_keyword, GKRELLM_CHARTCONFIG_KEYWORD)) {
-		gkrellm_load_chartconfig(&gpu_mon.chart_config, config_data, 1);
-	} else if(!strcmp(config_keyword, "radeontop_cmdline")) {
-		g_strlcpy(gpu_mon.options.radeontop_cmdline, config_data,
-				sizeof(gpu_mon.options.radeontop_cmdline));
+	gchar *keyword = config_keyword, *data = config_data;
+	struct gpu_instance *gpu = &gpu_mon.gpus[config_gpu_index(&keyword, '.')];
+
+	if(!strcmp(keyword, "gpu_count")) {
+		sscanf(data, "%d\n", &gpu_mon.options.gpu_count);
+		gpu_mon.options.gpu_count = CLAMP(gpu_mon.options.gpu_count, 1, MAX_GPUS);
+	} else if(!strcmp(keyword, "sysfs_root")) {
+		g_strlcpy(gpu_mon.options.sysfs_root, data,
+				sizeof(gpu_mon.options.sysfs_root));
+	} else if(!strcmp(keyword, "proc_root")) {
+		g_strlcpy(gpu_mon.options.proc_root, data,
+				sizeof(gpu_mon.options.proc_root));
+	} else if(!strcmp(keyword, "reduction")) {
+		sscanf(data, "%d\n", &gpu_mon.options.reduction);
+		gpu_mon.options.reduction = CLAMP(gpu_mon.options.reduction, 0, REDUCE_COUNT - 1);
+	} else if(!strcmp(keyword, "history")) {
+		sscanf(data, "%d\n", &gpu_mon.options.history);
+	} else if(!strcmp(keyword, "pause_hidden")) {
+		sscanf(data, "%d\n", &gpu_mon.options.pause_hidden);
+	} else if(!strcmp(keyword, "main_loop")) {
+		sscanf(data, "%d\n", &gpu_mon.options.main_loop);
+	} else if(!strcmp(keyword, "clients")) {
+		sscanf(data, "%d\n", &gpu_mon.options.clients);
+	} else if(!strcmp(keyword, "hwmon_chart")) {
+		sscanf(data, "%d\n", &gpu_mon.options.hwmon_chart);
+	} else if(!strcmp(keyword, "exporter")) {
+		g_strlcpy(gpu_mon.options.exporter, data,
+				sizeof(gpu_mon.options.exporter));
+	} else if(!strcmp(keyword, "shm")) {
+		g_strlcpy(gpu_mon.options.shm, data, sizeof(gpu_mon.options.shm));
+	} else if(!strcmp(keyword, "log")) {
+		g_strlcpy(gpu_mon.options.log, data, sizeof(gpu_mon.options.log));
+	} else if(!strcmp(keyword, "extra_info")) {
+		sscanf(data, "%d\n", &gpu->extra_info);
+	} else if(!strcmp(keyword, "resolution")) {
+		sscanf(data, "%d\n", &gpu->resolution);
+		gpu->resolution = CLAMP(gpu->resolution, 0, ROLLUP_LEVELS - 1);
+	} else if(!strcmp(keyword, GKRELLM_CHARTCONFIG_KEYWORD)) {
+		int idx, n = 0;
+		if(sscanf(data, "hwmon%d %n", &idx, &n) == 1 && n > 0 && idx >= 0 && idx < MAX_GPUS) {
+			gkrellm_load_chartconfig(&gpu_mon.gpus[idx].hwmon_chart_config, data + n, 2);
+		} else {
+			gpu = &gpu_mon.gpus[config_gpu_index(&data, ' ')];
+			gkrellm_load_chartconfig(&gpu->chart_config, data, 1);
+		}
+	} else if(!strcmp(keyword, "radeontop_cmdline")) {
+		g_strlcpy(gpu->options.radeontop_cmdline, data,
+				sizeof(gpu->options.radeontop_cmdline));
+	} else if(!strcmp(keyword, "record")) {
+		g_strlcpy(gpu->options.record, data, sizeof(gpu->options.record));
+	} else if(!strcmp(keyword, "backend")) {
+		sscanf(data, "%d\n", &gpu->options.backend);
+	} else if(!strcmp(keyword, "sysfs_card")) {
+		g_strlcpy(gpu->options.sysfs_card, data,
+				sizeof(gpu->options.sysfs_card));
+	} else if(!strcmp(keyword, "sysfs_interval_ms")) {
+		sscanf(data, "%d\n", &gpu->options.sysfs_interval_ms);
+	} else if(!strcmp(keyword, "grbm_ticks")) {
+		sscanf(data, "%d\n", &gpu->options.grbm_ticks);
+	} else if(!strcmp(keyword, "grbm_device")) {
+		g_strlcpy(gpu->options.grbm_device, data,
+				sizeof(gpu->options.grbm_device));
 	}
 }
 
-static void update_plugin(void) {
-	GkrellmKrell *krell;
+/* reduces samples received since last chart column; leaves values
+ * untouched if there were none. Returns bitmask of rollup levels that
+ * closed a period on the way */
+static unsigned int reduce_samples(struct gpu_instance *gpu, gulong *shader_clock, gulong *gpu_pipe) {
+	// GTK thread only, no need to keep that on stack
+	static struct sample window[SAMPLE_RING_SIZE];
+	static float values[SAMPLE_RING_SIZE];
+
+	size_t n = sample_ring_drain(&gpu->samples, window, SAMPLE_RING_SIZE);
+	if(n == 0) {
+		return 0;
+	}
+
+	unsigned int closed = 0;
+	for(size_t i = 0; i < n; ++i) {
+		const float channels[ROLLUP_CHANNELS] = {
+			[ROLLUP_SHADER_CLOCK] = window[i].shader_clock,
+			[ROLLUP_GPU_PIPE] = window[i].gpu_pipe,
+		};
+		closed |= rollup_add(&gpu->rollup, window[i].time_us / 1000000, channels);
+	}
 
-	pthread_mutex_lock(&gpu_mon.mutex);
+	for(size_t i = 0; i < n; ++i) {
+		values[i] = window[i].shader_clock;
+	}
+	*shader_clock = sample_reduce(values, n, gpu_mon.options.reduction);
 
-	// reset stats if stale
-	time_t current_time = time(NULL);
-	if(current_time - gpu_mon.gpu_stats.stats_timestamp > 2) {
-		memset(&gpu_mon.gpu_stats, 0, sizeof(gpu_mon.gpu_stats));
+	for(size_t i = 0; i < n; ++i) {
+		values[i] = window[i].gpu_pipe;
 	}
+	*gpu_pipe = sample_reduce(values, n, gpu_mon.options.reduction);
+	return closed;
+}
 
-	memcpy(&gpu_mon.gpu_stats_copy, &gpu_mon.gpu_stats, sizeof(gpu_mon.gpu_stats));
+static void update_gpu(struct gpu_instance *gpu) {
+	GkrellmKrell *krell;
+
+	// only copy stats out if sampler published something new
+	if(stats_seqlock_generation(&gpu->gpu_stats) != gpu->gpu_stats_generation) {
+		gpu->gpu_stats_generation = stats_seqlock_read(&gpu->gpu_stats,
+				&gpu->gpu_stats_copy);
+	}
 
-	pthread_mutex_unlock(&gpu_mon.mutex);
+	// reset stats if stale
+	const struct gpu_stats *st = &gpu->gpu_stats_copy;
+	if(st->recv_time_ns) {
+		uint64_t stale_ms = st->interval_us ?
+			MAX((uint64_t)st->interval_us * STALE_INTERVALS / 1000, STALE_MIN_MS) :
+			STALE_DEFAULT_MS;
+		if(clock_ns(CLOCK_MONOTONIC) - st->recv_time_ns > stale_ms * 1000000) {
+			// keep counters, they are still shown on chart
+			struct gpu_stats stale = {
+				.interval_us = st->interval_us,
+				.gaps = st->gaps,
+				.dropped = st->dropped,
+			};
+			gpu->gpu_stats_copy = stale;
+		}
+	}
 
 	// used for both chart and krell
-	const gulong gpu_pipe = gpu_mon.gpu_stats_copy.gpu_pipe;
+	const gulong gpu_pipe = gpu->gpu_stats_copy.busy[GPU_BLOCK_GPU];
 
 	if(GK.second_tick) {
-		const gulong shader_clock = gpu_mon.gpu_stats_copy.shader_clock;
+		update_clients_tooltip(gpu);
+
+		gulong shader_clock = gpu->gpu_stats_copy.sclk;
+		gulong chart_pipe = gpu_pipe;
+		// a sample past a period boundary closes it before the tick does
+		unsigned int closed = reduce_samples(gpu, &shader_clock, &chart_pipe);
+		closed |= rollup_advance(&gpu->rollup, clock_ns(CLOCK_MONOTONIC) / 1000000000);
+
+		// chart only needs redraw if it got a column or its text changed
+		bool dirty = false;
+		if(gpu->resolution == 0) {
+			gkrellm_store_chartdata(gpu->chart, 0, shader_clock, chart_pipe, 0);
+			dirty = true;
+		} else if(closed & (1u << gpu->resolution)) {
+			store_rollup_column(gpu, 0);
+			dirty = true;
+		}
+		if(gpu->extra_info && update_extra_info(gpu)) {
+			dirty = true;
+		}
+		if(atomic_load_explicit(&gpu->backend_state, memory_order_relaxed) != gpu->redraw.backend_state ||
+				atomic_load_explicit(&gpu->gpu_off, memory_order_relaxed) != gpu->redraw.gpu_off ||
+				atomic_load_explicit(&gpu->bursting, memory_order_relaxed) != gpu->redraw.bursting) {
+			dirty = true;
+		}
+
+		if(dirty) {
+			draw_chart(gpu);
+		}
+		count_redraw(gpu, EXPORTER_LAYER_CHART, dirty);
+
+		update_hwmon_chart(gpu);
+	}
+
+	const bool krell_dirty = !gpu->redraw.krell_valid || gpu->redraw.krell_value != gpu_pipe;
+	if(krell_dirty) {
+		krell = KRELL(gpu->chart->panel);
+		gkrellm_update_krell(gpu->chart->panel, krell, gpu_pipe);
+		gkrellm_draw_panel_layers(gpu->chart->panel);
+		gpu->redraw.krell_value = gpu_pipe;
+		gpu->redraw.krell_valid = true;
+	}
+	count_redraw(gpu, EXPORTER_LAYER_PANEL, krell_dirty);
+}
 
-		gkrellm_store_chartdata(gpu_mon.chart, 0, shader_clock, gpu_pipe, 0);
-		draw_chart(gpu_mon.chart);
+/* Pauses backend of a chart nobody could see: unmapped (gkrellm shaded or
+ * iconified) or fully covered. Exporter, shared memory and sample log have
+ * their own readers, so nothing is paused while any of them is enabled. */
+static void update_pause(struct gpu_instance *gpu) {
+	const bool pause = gpu_mon.options.pause_hidden &&
+		!gpu_mon.options.exporter[0] && !gpu_mon.options.shm[0] &&
+		!gpu_mon.options.log[0] &&
+		(!GTK_WIDGET_MAPPED(gpu->chart->drawing_area) || gpu->obscured);
+	if(pause != atomic_load_explicit(&gpu->pause, memory_order_relaxed)) {
+		atomic_store_explicit(&gpu->pause, pause, memory_order_relaxed);
+		wakeup_thread();
 	}
+}
 
-	krell = KRELL(gpu_mon.chart->panel);
-	gkrellm_update_krell(gpu_mon.chart->panel, krell, gpu_pipe);
-	gkrellm_draw_panel_layers(gpu_mon.chart->panel);
+static void update_plugin(void) {
+	for(int i = 0; i < gpu_mon.gpu_count; ++i) {
+		update_pause(&gpu_mon.gpus[i]);
+		update_gpu(&gpu_mon.gpus[i]);
+	}
 }
 
 
@@ -412,9 +2346,30 @@ static GkrellmMonitor gpu_plugin_mon = {
 
 GkrellmMonitor *gkrellm_init_plugin(void) {
 	// set default options
-	g_strlcpy(gpu_mon.options.radeontop_cmdline,
-			RADEONTOP_DEFAULT_CMDLINE,
-			sizeof(gpu_mon.options.radeontop_cmdline));
+	gpu_mon.radeontop.wake_fd = -1;
+	gpu_mon.options.gpu_count = 1;
+	gpu_mon.options.history = TRUE;
+	gpu_mon.options.pause_hidden = TRUE;
+	gpu_mon.options.clients = TRUE;
+	gpu_mon.options.hwmon_chart = TRUE;
+	g_strlcpy(gpu_mon.options.sysfs_root, SYSFS_DEFAULT_ROOT,
+			sizeof(gpu_mon.options.sysfs_root));
+	g_strlcpy(gpu_mon.options.proc_root, FDINFO_DEFAULT_ROOT,
+			sizeof(gpu_mon.options.proc_root));
+
+	for(int i = 0; i < MAX_GPUS; ++i) {
+		struct gpu_instance *gpu = &gpu_mon.gpus[i];
+		gpu->id = i;
+		gpu->sampler.child.out_fd = gpu->sampler.child.err_fd = gpu->sampler.child.pidfd = -1;
+		gpu->sampler.pm.status_fd = -1;
+		gpu->history.fd = -1;
+		g_strlcpy(gpu->options.radeontop_cmdline,
+				RADEONTOP_DEFAULT_CMDLINE,
+				sizeof(gpu->options.radeontop_cmdline));
+		snprintf(gpu->options.sysfs_card, sizeof(gpu->options.sysfs_card), "card%d", i);
+		gpu->options.sysfs_interval_ms = SYSFS_DEFAULT_INTERVAL_MS;
+		gpu->options.grbm_ticks = GRBM_DEFAULT_TICKS;
+	}
 
 	gpu_plugin_mon_ptr = &gpu_plugin_mon;
 	style_id = gkrellm_add_chart_style(gpu_plugin_mon_ptr, PLUGIN_NAME);
@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/time.h>
+#ifdef HAVE_LIBDRM
+#include <amdgpu.h>
+#include <amdgpu_drm.h>
+#endif
+#include "gpu_grbm.h"
+
+/* GRBM_STATUS busy bits, same as radeontop uses for amdgpu */
+static const uint32_t block_bits[GPU_BLOCK_COUNT] = {
+	[GPU_BLOCK_GPU] = 1u << 31,	/* GUI_ACTIVE */
+	[GPU_BLOCK_EE] = 1u << 10,
+	[GPU_BLOCK_VGT] = 1u << 17,
+	[GPU_BLOCK_TA] = 1u << 14,
+	[GPU_BLOCK_SX] = 1u << 20,
+	[GPU_BLOCK_SH] = 1u << 21,
+	[GPU_BLOCK_SPI] = 1u << 22,
+	[GPU_BLOCK_SC] = 1u << 24,
+	[GPU_BLOCK_PA] = 1u << 25,
+	[GPU_BLOCK_DB] = 1u << 26,
+	[GPU_BLOCK_CB] = 1u << 30,
+};
+
+/* synthetic source: load follows a random walk, every block is busy for
+ * a fixed share of time GPU is */
+static const float mock_share[GPU_BLOCK_COUNT] = {
+	1.0f, 0.0f, 0.3f, 0.8f, 0.6f, 0.9f, 0.9f, 0.5f, 0.2f, 0.6f, 0.6f,
+};
+
+static uint32_t mock_next(struct gpu_grbm *grbm) {
+	uint32_t x = grbm->random;	// xorshift32
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return grbm->random = x;
+}
+
+static float mock_uniform(struct gpu_grbm *grbm) {
+	return (float)(mock_next(grbm) >> 8) / (float)(1u << 24);
+}
+
+static int mock_read_reg(void *ctx, uint32_t reg, uint32_t *value) {
+	struct gpu_grbm *grbm = ctx;
+	if(reg != GRBM_STATUS) {
+		return -1;
+	}
+
+	grbm->load += (mock_uniform(grbm) - 0.5f) * 0.02f;
+	grbm->load = grbm->load < 0 ? 0 : grbm->load > 1 ? 1 : grbm->load;
+
+	*value = 0;
+	if(mock_uniform(grbm) < grbm->load) {
+		for(int i = 0; i < GPU_BLOCK_COUNT; ++i) {
+			if(mock_uniform(grbm) < mock_share[i]) {
+				*value |= block_bits[i];
+			}
+		}
+	}
+	return 0;
+}
+
+static void mock_read_sensors(void *ctx, struct gpu_stats *out) {
+	struct gpu_grbm *grbm = ctx;
+	out->vram_mb = 512.0f + grbm->load * 1024.0f;
+	out->vram = out->vram_mb * 100.0f / 8192.0f;
+	out->sclk = 20.0f + grbm->load * 80.0f;
+	out->sclk_ghz = out->sclk * 2.5f / 100.0f;
+	out->valid |= GPU_FIELD_BIT(GPU_FIELD_VRAM) | GPU_FIELD_BIT(GPU_FIELD_SCLK);
+}
+
+static void mock_close(void *ctx) {
+	(void)ctx;
+}
+
+#ifdef HAVE_LIBDRM
+static int drm_read_reg(void *ctx, uint32_t reg, uint32_t *value) {
+	struct gpu_grbm *grbm = ctx;
+	return amdgpu_read_mm_registers(grbm->dev, reg / 4, 1, 0xffffffff, 0, value);
+}
+
+static void drm_read_memory(struct gpu_grbm *grbm, unsigned int query, uint64_t total,
+		float *pct, float *mb, struct gpu_stats *out, enum gpu_field field) {
+	uint64_t used;
+	if(!total || amdgpu_query_info(grbm->dev, query, sizeof(used), &used) != 0) {
+		return;
+	}
+	*mb = (float)used / (1024.0f * 1024.0f);
+	*pct = (float)used * 100.0f / (float)total;
+	out->valid |= GPU_FIELD_BIT(field);
+}
+
+static void drm_read_clock(struct gpu_grbm *grbm, unsigned int sensor, uint32_t max_khz,
+		float *pct, float *ghz, struct gpu_stats *out, enum gpu_field field) {
+	uint32_t mhz;
+	if(!max_khz || amdgpu_query_sensor_info(grbm->dev, sensor, sizeof(mhz), &mhz) != 0) {
+		return;
+	}
+	*pct = (float)mhz * 100000.0f / (float)max_khz;
+	*ghz = (float)mhz / 1000.0f;
+	out->valid |= GPU_FIELD_BIT(field);
+}
+
+static void drm_read_sensors(void *ctx, struct gpu_stats *out) {
+	struct gpu_grbm *grbm = ctx;
+	drm_read_memory(grbm, AMDGPU_INFO_VRAM_USAGE, grbm->vram_total,
+			&out->vram, &out->vram_mb, out, GPU_FIELD_VRAM);
+	drm_read_memory(grbm, AMDGPU_INFO_GTT_USAGE, grbm->gtt_total,
+			&out->gtt, &out->gtt_mb, out, GPU_FIELD_GTT);
+	drm_read_clock(grbm, AMDGPU_INFO_SENSOR_GFX_SCLK, grbm->max_sclk_khz,
+			&out->sclk, &out->sclk_ghz, out, GPU_FIELD_SCLK);
+	drm_read_clock(grbm, AMDGPU_INFO_SENSOR_GFX_MCLK, grbm->max_mclk_khz,
+			&out->mclk, &out->mclk_ghz, out, GPU_FIELD_MCLK);
+}
+
+static void drm_close(void *ctx) {
+	struct gpu_grbm *grbm = ctx;
+	amdgpu_device_deinitialize(grbm->dev);
+	close(grbm->fd);
+	grbm->fd = -1;
+}
+
+static int drm_open(struct gpu_grbm *grbm, const char *path) {
+	grbm->fd = open(path, O_RDWR | O_CLOEXEC);
+	if(grbm->fd < 0) {
+		fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	uint32_t major, minor;
+	amdgpu_device_handle dev;
+	if(amdgpu_device_initialize(grbm->fd, &major, &minor, &dev) != 0) {
+		fprintf(stderr, "%s is not an amdgpu device\n", path);
+		close(grbm->fd);
+		grbm->fd = -1;
+		return -1;
+	}
+	grbm->dev = dev;
+
+	struct amdgpu_gpu_info info;
+	if(amdgpu_query_gpu_info(dev, &info) == 0) {
+		grbm->max_sclk_khz = (uint32_t)info.max_engine_clk;
+		grbm->max_mclk_khz = (uint32_t)info.max_memory_clk;
+	}
+	struct amdgpu_heap_info heap;
+	if(amdgpu_query_heap_info(dev, AMDGPU_GEM_DOMAIN_VRAM, 0, &heap) == 0) {
+		grbm->vram_total = heap.heap_size;
+	}
+	if(amdgpu_query_heap_info(dev, AMDGPU_GEM_DOMAIN_GTT, 0, &heap) == 0) {
+		grbm->gtt_total = heap.heap_size;
+	}
+
+	const struct gpu_grbm_source src = {
+		.ctx = grbm,
+		.read_reg = drm_read_reg,
+		.read_sensors = drm_read_sensors,
+		.close = drm_close,
+	};
+	grbm->src = src;
+
+	// kernel only allows reading whitelisted registers, find out now
+	uint32_t value;
+	if(drm_read_reg(grbm, GRBM_STATUS, &value) != 0) {
+		fprintf(stderr, "can't read GRBM_STATUS of %s\n", path);
+		drm_close(grbm);
+		return -1;
+	}
+	return 0;
+}
+#endif
+
+/* /dev/dri/renderDN of <root>/<card>, from <root>/<card>/device/drm */
+static int render_node(const char *root, const char *card, char *out, size_t size) {
+	char dir[512];
+	snprintf(dir, sizeof(dir), "%s/%s/device/drm", root, card);
+	DIR *d = opendir(dir);
+	if(!d) {
+		fprintf(stderr, "can't open %s: %s\n", dir, strerror(errno));
+		return -1;
+	}
+
+	int ret = -1;
+	struct dirent *e;
+	while((e = readdir(d))) {
+		if(!strncmp(e->d_name, "renderD", 7)) {
+			snprintf(out, size, "/dev/dri/%s", e->d_name);
+			ret = 0;
+			break;
+		}
+	}
+	closedir(d);
+	if(ret) {
+		fprintf(stderr, "no render node in %s\n", dir);
+	}
+	return ret;
+}
+
+void gpu_grbm_init(struct gpu_grbm *grbm, const struct gpu_grbm_source *src) {
+	memset(grbm, 0, sizeof(*grbm));
+	grbm->fd = -1;
+	grbm->src = *src;
+}
+
+int gpu_grbm_open(struct gpu_grbm *grbm, const char *device,
+		const char *root, const char *card) {
+	if(!strcmp(device, GRBM_MOCK_DEVICE)) {
+		const struct gpu_grbm_source src = {
+			.read_reg = mock_read_reg,
+			.read_sensors = mock_read_sensors,
+			.close = mock_close,
+		};
+		gpu_grbm_init(grbm, &src);
+		grbm->src.ctx = grbm;
+		grbm->random = (uint32_t)getpid() | 1;
+		grbm->load = 0.2f;
+		return 0;
+	}
+
+	char path[300];
+	if(device[0]) {
+		snprintf(path, sizeof(path), "%s", device);
+	} else if(render_node(root, card, path, sizeof(path)) != 0) {
+		return -1;
+	}
+
+#ifdef HAVE_LIBDRM
+	const struct gpu_grbm_source none = {0};
+	gpu_grbm_init(grbm, &none);
+	return drm_open(grbm, path);
+#else
+	fprintf(stderr, "can't read registers of %s: built without libdrm\n", path);
+	return -1;
+#endif
+}
+
+void gpu_grbm_close(struct gpu_grbm *grbm) {
+	if(grbm->src.close) {
+		grbm->src.close(grbm->src.ctx);
+	}
+}
+
+bool gpu_grbm_tick(struct gpu_grbm *grbm) {
+	uint32_t value;
+	if(grbm->src.read_reg(grbm->src.ctx, GRBM_STATUS, &value) != 0) {
+		return false;
+	}
+	grbm->ticks++;
+	for(int i = 0; i < GPU_BLOCK_COUNT; ++i) {
+		grbm->busy[i] += (value & block_bits[i]) != 0;
+	}
+	return true;
+}
+
+bool gpu_grbm_sample(struct gpu_grbm *grbm, struct gpu_stats *out) {
+	memset(out, 0, sizeof(*out));
+	if(!grbm->ticks) {
+		return false;
+	}
+
+	for(int i = 0; i < GPU_BLOCK_COUNT; ++i) {
+		out->busy[i] = (float)grbm->busy[i] * 100.0f / (float)grbm->ticks;
+		out->valid |= GPU_FIELD_BIT(i);
+		grbm->busy[i] = 0;
+	}
+	grbm->ticks = 0;
+
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	out->sample_time_us = (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+	out->valid |= GPU_FIELD_BIT(GPU_FIELD_TIMESTAMP);
+
+	if(grbm->src.read_sensors) {
+		grbm->src.read_sensors(grbm->src.ctx, out);
+	}
+	return true;
+}
@@ -0,0 +1,60 @@
+#ifndef GPU_GRBM_H
+#define GPU_GRBM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "gpu_stats.h"
+
+/* In-process sampling of GRBM_STATUS, the way radeontop does it: register
+ * is read many times a second and every busy bit is counted, percentages
+ * are counts over reads since previous sample.
+ *
+ * Registers come from a gpu_grbm_source, which is libdrm_amdgpu
+ * (amdgpu_read_mm_registers) when built with HAVE_LIBDRM, or a synthetic
+ * one that needs no GPU. */
+
+#define GRBM_STATUS 0x8010	/* byte offset */
+#define GRBM_DEFAULT_TICKS 120	/* reads per second, radeontop's default */
+#define GRBM_MOCK_DEVICE "mock"
+
+struct gpu_grbm_source {
+	void *ctx;
+	/* reads register at byte offset reg; returns 0 on success */
+	int (*read_reg)(void *ctx, uint32_t reg, uint32_t *value);
+	/* fills memory and clock fields of out it knows, with valid bits;
+	 * could be NULL */
+	void (*read_sensors)(void *ctx, struct gpu_stats *out);
+	void (*close)(void *ctx);
+};
+
+struct gpu_grbm {
+	struct gpu_grbm_source src;
+	uint32_t ticks;		/* reads since previous sample */
+	uint32_t busy[GPU_BLOCK_COUNT];	/* of them with block busy */
+
+	/* state of built-in sources */
+	int fd;			/* DRM render node, -1 if not open */
+	void *dev;		/* amdgpu_device_handle */
+	uint32_t max_sclk_khz, max_mclk_khz;
+	uint64_t vram_total, gtt_total;
+	uint32_t random;	/* synthetic source */
+	float load;
+};
+
+/* opens device, which is a DRM node path, GRBM_MOCK_DEVICE, or empty for
+ * render node of <root>/<card>. Returns 0 on success */
+int gpu_grbm_open(struct gpu_grbm *grbm, const char *device,
+		const char *root, const char *card);
+
+/* uses given source instead, e.g. in tests */
+void gpu_grbm_init(struct gpu_grbm *grbm, const struct gpu_grbm_source *src);
+void gpu_grbm_close(struct gpu_grbm *grbm);
+
+/* reads GRBM_STATUS once; returns false on error */
+bool gpu_grbm_tick(struct gpu_grbm *grbm);
+
+/* fills out with busy percentages since previous sample and starts over;
+ * returns false if there were no reads */
+bool gpu_grbm_sample(struct gpu_grbm *grbm, struct gpu_stats *out);
+
+#endif
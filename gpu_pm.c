@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include "gpu_pm.h"
+
+static ssize_t read_attr(int fd, char *buf, size_t size) {
+	ssize_t r;
+	do {
+		r = pread(fd, buf, size - 1, 0);
+	} while(r < 0 && errno == EINTR);
+	if(r < 0) {
+		return -1;
+	}
+	buf[r] = '\0';
+	return r;
+}
+
+int gpu_pm_open(struct gpu_pm *pm, const char *root, const char *card) {
+	char path[512];
+	pm->autosuspend_ms = GPU_PM_DEFAULT_AUTOSUSPEND_MS;
+	snprintf(path, sizeof(path), "%s/%s/device/power/runtime_status", root, card);
+	pm->status_fd = open(path, O_RDONLY | O_CLOEXEC);
+	if(pm->status_fd < 0) {
+		return -1;
+	}
+
+	char buf[32];
+	if(read_attr(pm->status_fd, buf, sizeof(buf)) <= 0 || !strncmp(buf, "unsupported", 11)) {
+		gpu_pm_close(pm);
+		return -1;
+	}
+
+	// negative delay means autosuspend is off, device still could suspend
+	snprintf(path, sizeof(path), "%s/%s/device/power/autosuspend_delay_ms", root, card);
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if(fd >= 0) {
+		if(read_attr(fd, buf, sizeof(buf)) > 0 && atoi(buf) >= 0) {
+			pm->autosuspend_ms = (unsigned int)atoi(buf);
+		}
+		close(fd);
+	}
+	return 0;
+}
+
+void gpu_pm_close(struct gpu_pm *pm) {
+	if(pm->status_fd >= 0) {
+		close(pm->status_fd);
+	}
+	pm->status_fd = -1;
+}
+
+enum gpu_pm_status gpu_pm_status(struct gpu_pm *pm) {
+	char buf[32];
+	if(pm->status_fd < 0 || read_attr(pm->status_fd, buf, sizeof(buf)) <= 0) {
+		return GPU_PM_UNKNOWN;
+	}
+	if(!strncmp(buf, "active", 6)) {
+		return GPU_PM_ACTIVE;
+	} else if(!strncmp(buf, "suspended", 9)) {
+		return GPU_PM_SUSPENDED;
+	} else if(!strncmp(buf, "suspending", 10) || !strncmp(buf, "resuming", 8)) {
+		return GPU_PM_TRANSITION;
+	}
+	return GPU_PM_UNKNOWN;
+}
@@ -0,0 +1,30 @@
+#ifndef GPU_PM_H
+#define GPU_PM_H
+
+/* Runtime power management of a DRM device, as seen in
+ * <root>/<card>/device/power. These files are answered by PM core, reading
+ * them doesn't resume a suspended device. Sysfs doesn't notify about
+ * runtime_status changes, so it has to be re-read. */
+
+#define GPU_PM_DEFAULT_AUTOSUSPEND_MS 5000
+
+enum gpu_pm_status {
+	GPU_PM_ACTIVE,
+	GPU_PM_SUSPENDED,
+	GPU_PM_TRANSITION,	/* suspending or resuming */
+	GPU_PM_UNKNOWN,		/* error or unreadable */
+};
+
+struct gpu_pm {
+	int status_fd;	/* runtime_status, -1 if not open */
+	unsigned int autosuspend_ms;	/* autosuspend_delay_ms, or default */
+};
+
+/* opens runtime_status of <root>/<card>; returns 0 on success, -1 if device
+ * has no runtime PM */
+int gpu_pm_open(struct gpu_pm *pm, const char *root, const char *card);
+void gpu_pm_close(struct gpu_pm *pm);
+
+enum gpu_pm_status gpu_pm_status(struct gpu_pm *pm);
+
+#endif
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "gpu_shm.h"
+
+_Static_assert(sizeof(struct gpu_shm_header) == 64, "shm header layout changed");
+_Static_assert(sizeof(struct gpu_shm_sample) == 120, "shm sample layout changed");
+_Static_assert(sizeof(struct gpu_shm_slot) == 128, "shm slot layout changed");
+_Static_assert(offsetof(struct gpu_shm_gpu, ring) == 64, "shm gpu layout changed");
+
+int gpu_shm_create(struct gpu_shm_writer *w, const char *name, int gpu_count) {
+	w->header = NULL;
+	w->gpus = NULL;
+	w->size = sizeof(struct gpu_shm_header) + (size_t)gpu_count * sizeof(struct gpu_shm_gpu);
+	snprintf(w->name, sizeof(w->name), "%s", name);
+
+	// readers of previous segment keep their mapping and see it closed
+	shm_unlink(name);
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if(fd < 0) {
+		fprintf(stderr, "can't create shared memory %s: %s\n", name, strerror(errno));
+		return -1;
+	}
+	if(ftruncate(fd, (off_t)w->size) != 0) {
+		goto fail;
+	}
+	void *p = mmap(NULL, w->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(p == MAP_FAILED) {
+		goto fail;
+	}
+	close(fd);
+
+	// fresh segment is zeroed, that is empty rings
+	w->header = p;
+	w->gpus = (struct gpu_shm_gpu *)(w->header + 1);
+	for(int i = 0; i < gpu_count; ++i) {
+		w->gpus[i].id = (uint32_t)i;
+	}
+	w->header->slot_size = sizeof(struct gpu_shm_slot);
+	w->header->ring_size = GPU_SHM_RING_SIZE;
+	w->header->gpu_count = (uint32_t)gpu_count;
+	w->header->writer_pid = (uint32_t)getpid();
+	w->header->version = GPU_SHM_VERSION;
+	// readers check magic first
+	atomic_thread_fence(memory_order_release);
+	w->header->magic = GPU_SHM_MAGIC;
+	return 0;
+
+fail:
+	fprintf(stderr, "can't map shared memory %s: %s\n", name, strerror(errno));
+	close(fd);
+	shm_unlink(name);
+	return -1;
+}
+
+void gpu_shm_destroy(struct gpu_shm_writer *w) {
+	if(!w->header) {
+		return;
+	}
+	atomic_store_explicit(&w->header->closed, 1, memory_order_release);
+	munmap(w->header, w->size);
+	shm_unlink(w->name);
+	w->header = NULL;
+	w->gpus = NULL;
+}
+
+void gpu_shm_publish(struct gpu_shm_writer *w, int gpu, const struct gpu_stats *stats) {
+	if(!w->header) {
+		return;
+	}
+	struct gpu_shm_gpu *g = &w->gpus[gpu];
+	const uint64_t n = atomic_load_explicit(&g->head, memory_order_relaxed) + 1;
+	struct gpu_shm_slot *slot = &g->ring[(n - 1) % GPU_SHM_RING_SIZE];
+
+	atomic_store_explicit(&slot->seq, 2 * n - 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	struct gpu_shm_sample *s = &slot->sample;
+	s->recv_time_ns = stats->recv_time_ns;
+	s->sample_time_us = stats->sample_time_us;
+	s->interval_us = stats->interval_us;
+	s->latency_us = stats->latency_us;
+	s->gaps = stats->gaps;
+	s->dropped = stats->dropped;
+	s->bus = stats->bus;
+	s->valid = stats->valid & (GPU_FIELD_BIT(GPU_FIELD_POWER) - 1);	// hwmon isn't in layout
+	memcpy(s->busy, stats->busy, sizeof(s->busy));
+	s->vram = stats->vram;
+	s->vram_mb = stats->vram_mb;
+	s->gtt = stats->gtt;
+	s->gtt_mb = stats->gtt_mb;
+	s->mclk = stats->mclk;
+	s->mclk_ghz = stats->mclk_ghz;
+	s->sclk = stats->sclk;
+	s->sclk_ghz = stats->sclk_ghz;
+
+	atomic_store_explicit(&slot->seq, 2 * n, memory_order_release);
+	atomic_store_explicit(&g->head, n, memory_order_release);
+}
@@ -0,0 +1,112 @@
+#ifndef GPU_SHM_H
+#define GPU_SHM_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gpu_stats.h"
+
+/* Shared memory stats segment for other local tools, e.g.
+ * shm_open("/gkrellmradeontop") with GPU_SHM_NAME_DEFAULT.
+ *
+ * Layout (native endianness, offsets in bytes):
+ *   0     struct gpu_shm_header (64 bytes)
+ *   64    struct gpu_shm_gpu[gpu_count], each 64 + ring_size * slot_size
+ *
+ * Every GPU has ring of the most recent samples. Sample n (counting from 1)
+ * lives in slot (n - 1) % ring_size; slot seq is 2n - 1 while it is being
+ * written and 2n once complete, so a reader that got the same 2n before
+ * and after copying has consistent sample n. head is the number of the
+ * latest complete sample. Readers never write to the segment.
+ *
+ * struct gpu_shm_sample:
+ *   0   u64 recv_time_ns	CLOCK_MONOTONIC of receive
+ *   8   u64 sample_time_us	producer wall clock
+ *   16  u32 interval_us, i32 latency_us, u32 gaps, u32 dropped
+ *   32  u32 bus, u32 valid	valid bits as GPU_FIELD_BIT() of gpu_stats.h
+ *   40  f32 busy[11]	percent, enum gpu_block order
+ *   84  f32 vram, vram_mb, gtt, gtt_mb, mclk, mclk_ghz, sclk, sclk_ghz
+ *   116 u32 reserved
+ *
+ * When writer goes away it sets header closed; a new writer creates a new
+ * segment under the same name, readers should attach again. */
+
+#define GPU_SHM_MAGIC 0x53555047	// "GPUS"
+#define GPU_SHM_VERSION 1
+#define GPU_SHM_RING_SIZE 64
+
+struct gpu_shm_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t slot_size;
+	uint32_t ring_size;
+	uint32_t gpu_count;
+	uint32_t writer_pid;
+	_Atomic uint32_t closed;
+	uint8_t reserved[40];
+};
+
+struct gpu_shm_sample {
+	uint64_t recv_time_ns;
+	uint64_t sample_time_us;
+	uint32_t interval_us;
+	int32_t latency_us;
+	uint32_t gaps;
+	uint32_t dropped;
+	uint32_t bus;
+	uint32_t valid;
+	float busy[GPU_BLOCK_COUNT];
+	float vram, vram_mb;
+	float gtt, gtt_mb;
+	float mclk, mclk_ghz;
+	float sclk, sclk_ghz;
+	uint32_t reserved;
+};
+
+struct gpu_shm_slot {
+	_Atomic uint64_t seq;
+	struct gpu_shm_sample sample;
+};
+
+struct gpu_shm_gpu {
+	_Atomic uint64_t head;
+	uint32_t id;
+	uint8_t reserved[52];
+	struct gpu_shm_slot ring[GPU_SHM_RING_SIZE];
+};
+
+/* writer side, owned by sampler thread */
+struct gpu_shm_writer {
+	char name[64];
+	size_t size;
+	struct gpu_shm_header *header;
+	struct gpu_shm_gpu *gpus;
+};
+
+/* creates segment, replacing existing one. Returns 0 on success */
+int gpu_shm_create(struct gpu_shm_writer *w, const char *name, int gpu_count);
+void gpu_shm_destroy(struct gpu_shm_writer *w);
+void gpu_shm_publish(struct gpu_shm_writer *w, int gpu, const struct gpu_stats *stats);
+
+/* reader side; a reader only needs this header and gpu_shm_reader.c */
+struct gpu_shm_reader {
+	size_t size;
+	const struct gpu_shm_header *header;
+	const struct gpu_shm_gpu *gpus;
+};
+
+/* maps segment read-only and validates layout. Returns 0 on success */
+int gpu_shm_attach(struct gpu_shm_reader *r, const char *name);
+void gpu_shm_detach(struct gpu_shm_reader *r);
+
+/* true once writer has closed segment; attach again to follow a new one */
+bool gpu_shm_closed(const struct gpu_shm_reader *r);
+
+/* copies sample n if it is still in the ring */
+bool gpu_shm_read(const struct gpu_shm_reader *r, int gpu, uint64_t n, struct gpu_shm_sample *out);
+
+/* copies latest sample, returns its number or 0 if there were none */
+uint64_t gpu_shm_latest(const struct gpu_shm_reader *r, int gpu, struct gpu_shm_sample *out);
+
+#endif
@@ -0,0 +1,86 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "gpu_shm.h"
+
+int gpu_shm_attach(struct gpu_shm_reader *r, const char *name) {
+	r->header = NULL;
+	r->gpus = NULL;
+
+	int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+	if(fd < 0) {
+		return -1;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct gpu_shm_header)) {
+		close(fd);
+		return -1;
+	}
+	r->size = (size_t)st.st_size;
+	void *p = mmap(NULL, r->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED) {
+		return -1;
+	}
+
+	const struct gpu_shm_header *hdr = p;
+	if(hdr->magic != GPU_SHM_MAGIC) {
+		// not ours or not initialized yet
+		munmap(p, r->size);
+		return -1;
+	}
+	atomic_thread_fence(memory_order_acquire);
+	if(hdr->version != GPU_SHM_VERSION ||
+			hdr->slot_size != sizeof(struct gpu_shm_slot) ||
+			hdr->ring_size != GPU_SHM_RING_SIZE ||
+			r->size < sizeof(*hdr) + hdr->gpu_count * sizeof(struct gpu_shm_gpu)) {
+		munmap(p, r->size);
+		return -1;
+	}
+	r->header = hdr;
+	r->gpus = (const struct gpu_shm_gpu *)(hdr + 1);
+	return 0;
+}
+
+void gpu_shm_detach(struct gpu_shm_reader *r) {
+	if(r->header) {
+		munmap((void *)r->header, r->size);
+	}
+	r->header = NULL;
+	r->gpus = NULL;
+}
+
+bool gpu_shm_closed(const struct gpu_shm_reader *r) {
+	return atomic_load_explicit(&((struct gpu_shm_header *)r->header)->closed,
+			memory_order_acquire) != 0;
+}
+
+bool gpu_shm_read(const struct gpu_shm_reader *r, int gpu, uint64_t n, struct gpu_shm_sample *out) {
+	if(gpu < 0 || (uint32_t)gpu >= r->header->gpu_count || n == 0) {
+		return false;
+	}
+	// atomics are only read, but C11 wants non-const pointer for that
+	struct gpu_shm_slot *slot = (struct gpu_shm_slot *)&r->gpus[gpu].ring[(n - 1) % GPU_SHM_RING_SIZE];
+	if(atomic_load_explicit(&slot->seq, memory_order_acquire) != 2 * n) {
+		return false;	// overwritten or not written yet
+	}
+	memcpy(out, &slot->sample, sizeof(*out));
+	atomic_thread_fence(memory_order_acquire);
+	return atomic_load_explicit(&slot->seq, memory_order_relaxed) == 2 * n;
+}
+
+uint64_t gpu_shm_latest(const struct gpu_shm_reader *r, int gpu, struct gpu_shm_sample *out) {
+	if(gpu < 0 || (uint32_t)gpu >= r->header->gpu_count) {
+		return 0;
+	}
+	struct gpu_shm_gpu *g = (struct gpu_shm_gpu *)&r->gpus[gpu];
+	while(1) {
+		uint64_t n = atomic_load_explicit(&g->head, memory_order_acquire);
+		if(n == 0 || gpu_shm_read(r, gpu, n, out)) {
+			return n;
+		}
+		// writer lapped the ring while we were copying, take newer one
+	}
+}
@@ -0,0 +1,83 @@
+#ifndef GPU_STATS_H
+#define GPU_STATS_H
+
+#include <stdint.h>
+
+/* per-block busy percentages, in radeontop output order */
+enum gpu_block {
+	GPU_BLOCK_GPU,	/* graphics pipe */
+	GPU_BLOCK_EE,	/* event engine */
+	GPU_BLOCK_VGT,	/* vertex grouper + tesselator */
+	GPU_BLOCK_TA,	/* texture addresser */
+	GPU_BLOCK_SX,	/* shader export */
+	GPU_BLOCK_SH,	/* sequencer instruction cache */
+	GPU_BLOCK_SPI,	/* shader interpolator */
+	GPU_BLOCK_SC,	/* scan converter */
+	GPU_BLOCK_PA,	/* primitive assembly */
+	GPU_BLOCK_DB,	/* depth block */
+	GPU_BLOCK_CB,	/* color block */
+	GPU_BLOCK_COUNT
+};
+
+/* bit indices for gpu_stats.valid */
+enum gpu_field {
+	GPU_FIELD_TIMESTAMP = GPU_BLOCK_COUNT,
+	GPU_FIELD_BUS,
+	GPU_FIELD_VRAM,
+	GPU_FIELD_GTT,
+	GPU_FIELD_MCLK,
+	GPU_FIELD_SCLK,
+	/* from hwmon */
+	GPU_FIELD_POWER,
+	GPU_FIELD_TEMP,	/* + enum gpu_temp */
+	GPU_FIELD_FAN = GPU_FIELD_TEMP + 3,
+	/* busy and sclk were there to tell */
+	GPU_FIELD_THROTTLE,
+	GPU_FIELD_COUNT
+};
+
+enum gpu_temp {
+	GPU_TEMP_EDGE,
+	GPU_TEMP_JUNCTION,
+	GPU_TEMP_MEM,
+	GPU_TEMP_COUNT
+};
+
+/* bits of gpu_stats.throttle */
+#define GPU_THROTTLE_CLOCK 1u	/* sclk is low while GPU is pegged */
+#define GPU_THROTTLE_THERMAL 2u	/* junction (or edge) temperature is near critical */
+#define GPU_THROTTLE_POWER 4u	/* power is at its cap */
+
+#define GPU_FIELD_BIT(f) (1u << (f))
+
+struct gpu_stats {
+	/* CLOCK_MONOTONIC when sample was received */
+	uint64_t recv_time_ns;
+
+	/* producer timestamp (wall clock), as printed by radeontop */
+	uint64_t sample_time_us;
+
+	/* sample timing, maintained by receiver */
+	uint32_t interval_us;	/* smoothed producer sample interval */
+	int32_t latency_us;	/* producer timestamp to receive */
+	uint32_t gaps;		/* late samples seen so far */
+	uint32_t dropped;	/* estimated samples missing in those gaps */
+	unsigned int bus;
+
+	float busy[GPU_BLOCK_COUNT];	/* percent */
+
+	float vram, vram_mb;	/* percent of total, used megabytes */
+	float gtt, gtt_mb;
+	float mclk, mclk_ghz;	/* percent of max clock, current clock */
+	float sclk, sclk_ghz;
+
+	float power_w, power_cap_w;
+	float temp_c[GPU_TEMP_COUNT];
+	float temp_crit_c[GPU_TEMP_COUNT];	/* 0 if unknown */
+	float fan_rpm, fan_max_rpm;
+	uint32_t throttle;	/* GPU_THROTTLE_* */
+
+	uint32_t valid;	/* GPU_FIELD_BIT() of decoded fields */
+};
+
+#endif
@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/time.h>
+#include "gpu_sysfs.h"
+
+static int open_attr(const char *dir, const char *name) {
+	char path[PATH_MAX];
+	const int n = snprintf(path, sizeof(path), "%s/%s", dir, name);
+	if(n < 0 || (size_t)n >= sizeof(path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/* <root>/<card>/<sub> into dir of PATH_MAX bytes; false if it doesn't fit */
+static bool card_dir(char *dir, const char *root, const char *card, const char *sub) {
+	const int n = snprintf(dir, PATH_MAX, "%s/%s/%s", root, card, sub);
+	if(n < 0 || n >= PATH_MAX) {
+		fprintf(stderr, "path of %s/%s is too long\n", root, card);
+		return false;
+	}
+	return true;
+}
+
+/* reads whole attribute into buf from offset 0, NUL-terminated */
+static ssize_t read_attr(int fd, char *buf, size_t size) {
+	if(fd < 0) {
+		return -1;
+	}
+	ssize_t r;
+	do {
+		r = pread(fd, buf, size - 1, 0);
+	} while(r < 0 && errno == EINTR);
+	if(r < 0) {
+		return -1;
+	}
+	buf[r] = '\0';
+	return r;
+}
+
+static bool read_u64(int fd, unsigned long long *out) {
+	char buf[32];
+	if(read_attr(fd, buf, sizeof(buf)) <= 0) {
+		return false;
+	}
+	unsigned long long v = 0;
+	const char *p = buf;
+	if(*p < '0' || *p > '9') {
+		return false;
+	}
+	for(; *p >= '0' && *p <= '9'; ++p) {
+		v = v * 10 + (unsigned long long)(*p - '0');
+	}
+	*out = v;
+	return true;
+}
+
+/* pp_dpm_* lists levels as "N: <clock>Mhz", current one is marked with '*'.
+ * Returns current clock, in MHz, and the highest one */
+static bool read_dpm(int fd, unsigned int *cur_mhz, unsigned int *max_mhz) {
+	char buf[512];
+	if(read_attr(fd, buf, sizeof(buf)) <= 0) {
+		return false;
+	}
+
+	bool found = false;
+	*cur_mhz = *max_mhz = 0;
+	for(const char *line = buf; *line; ) {
+		const char *eol = strchr(line, '\n');
+		if(!eol) {
+			eol = line + strlen(line);
+		}
+
+		const char *p = memchr(line, ':', (size_t)(eol - line));
+		if(p) {
+			p++;
+			while(p < eol && *p == ' ') {
+				p++;
+			}
+			unsigned int mhz = 0;
+			for(; p < eol && *p >= '0' && *p <= '9'; ++p) {
+				mhz = mhz * 10 + (unsigned int)(*p - '0');
+			}
+			if(mhz > *max_mhz) {
+				*max_mhz = mhz;
+			}
+			if(memchr(p, '*', (size_t)(eol - p))) {
+				*cur_mhz = mhz;
+				found = true;
+			}
+		}
+
+		line = *eol ? eol + 1 : eol;
+	}
+
+	return found && *max_mhz > 0;
+}
+
+static bool read_memory(int used_fd, int total_fd, float *pct, float *mb) {
+	unsigned long long used, total;
+	if(!read_u64(used_fd, &used)) {
+		return false;
+	}
+	*mb = (float)used / (1024.0f * 1024.0f);
+	if(read_u64(total_fd, &total) && total > 0) {
+		*pct = (float)used * 100.0f / (float)total;
+	}
+	return true;
+}
+
+int gpu_sysfs_open(struct gpu_sysfs *sysfs, const char *root, const char *card) {
+	char dir[PATH_MAX];
+	if(!card_dir(dir, root, card, "device")) {
+		return -1;
+	}
+
+	sysfs->busy_fd = open_attr(dir, "gpu_busy_percent");
+	if(sysfs->busy_fd < 0) {
+		fprintf(stderr, "can't open %s/gpu_busy_percent: %s\n", dir, strerror(errno));
+		return -1;
+	}
+	sysfs->sclk_fd = open_attr(dir, "pp_dpm_sclk");
+	sysfs->mclk_fd = open_attr(dir, "pp_dpm_mclk");
+	sysfs->vram_used_fd = open_attr(dir, "mem_info_vram_used");
+	sysfs->vram_total_fd = open_attr(dir, "mem_info_vram_total");
+	sysfs->gtt_used_fd = open_attr(dir, "mem_info_gtt_used");
+	sysfs->gtt_total_fd = open_attr(dir, "mem_info_gtt_total");
+	return 0;
+}
+
+void gpu_sysfs_close(struct gpu_sysfs *sysfs) {
+	int *fds[] = {
+		&sysfs->busy_fd, &sysfs->sclk_fd, &sysfs->mclk_fd,
+		&sysfs->vram_used_fd, &sysfs->vram_total_fd,
+		&sysfs->gtt_used_fd, &sysfs->gtt_total_fd,
+	};
+	for(size_t i = 0; i < sizeof(fds)/sizeof(fds[0]); ++i) {
+		if(*fds[i] >= 0) {
+			close(*fds[i]);
+		}
+		*fds[i] = -1;
+	}
+}
+
+int gpu_hwmon_open(struct gpu_hwmon *hwmon, const char *root, const char *card) {
+	char dir[PATH_MAX];
+	hwmon->power_fd = hwmon->power_cap_fd = hwmon->fan_fd = hwmon->fan_max_fd = -1;
+	for(int t = 0; t < GPU_TEMP_COUNT; ++t) {
+		hwmon->temp_fd[t] = hwmon->temp_crit_fd[t] = -1;
+	}
+	if(!card_dir(dir, root, card, "device/hwmon")) {
+		return -1;
+	}
+
+	// amdgpu has exactly one hwmonN
+	DIR *d = opendir(dir);
+	if(!d) {
+		return -1;
+	}
+	struct dirent *de;
+	while((de = readdir(d)) && strncmp(de->d_name, "hwmon", 5));
+	if(!de) {
+		closedir(d);
+		return -1;
+	}
+	const size_t len = strlen(dir);
+	const int n = snprintf(dir + len, sizeof(dir) - len, "/%s", de->d_name);
+	closedir(d);
+	if(n < 0 || (size_t)n >= sizeof(dir) - len) {
+		return -1;
+	}
+
+	hwmon->power_fd = open_attr(dir, "power1_average");
+	if(hwmon->power_fd < 0) {
+		hwmon->power_fd = open_attr(dir, "power1_input");	// newer APUs
+	}
+	hwmon->power_cap_fd = open_attr(dir, "power1_cap");
+	hwmon->fan_fd = open_attr(dir, "fan1_input");
+	hwmon->fan_max_fd = open_attr(dir, "fan1_max");
+
+	static const char *const labels[GPU_TEMP_COUNT] = { "edge", "junction", "mem" };
+	for(int n = 1; n <= GPU_TEMP_COUNT; ++n) {
+		char name[32], label[32];
+		snprintf(name, sizeof(name), "temp%d_label", n);
+		int fd = open_attr(dir, name);
+		int t = n - 1;	// unlabeled ones are in this order
+		if(fd >= 0) {
+			if(read_attr(fd, label, sizeof(label)) > 0) {
+				label[strcspn(label, "\n")] = '\0';
+				for(t = 0; t < GPU_TEMP_COUNT && strcmp(label, labels[t]); ++t);
+			}
+			close(fd);
+		}
+		if(t == GPU_TEMP_COUNT || hwmon->temp_fd[t] >= 0) {
+			continue;
+		}
+		snprintf(name, sizeof(name), "temp%d_input", n);
+		hwmon->temp_fd[t] = open_attr(dir, name);
+		snprintf(name, sizeof(name), "temp%d_crit", n);
+		hwmon->temp_crit_fd[t] = open_attr(dir, name);
+	}
+	return 0;
+}
+
+void gpu_hwmon_close(struct gpu_hwmon *hwmon) {
+	int *fds[4 + 2 * GPU_TEMP_COUNT] = {
+		&hwmon->power_fd, &hwmon->power_cap_fd, &hwmon->fan_fd, &hwmon->fan_max_fd,
+	};
+	for(int t = 0; t < GPU_TEMP_COUNT; ++t) {
+		fds[4 + 2 * t] = &hwmon->temp_fd[t];
+		fds[5 + 2 * t] = &hwmon->temp_crit_fd[t];
+	}
+	for(size_t i = 0; i < sizeof(fds)/sizeof(fds[0]); ++i) {
+		if(*fds[i] >= 0) {
+			close(*fds[i]);
+		}
+		*fds[i] = -1;
+	}
+}
+
+void gpu_hwmon_sample(struct gpu_hwmon *hwmon, struct gpu_stats *out) {
+	unsigned long long v;
+	// power in microwatts, temperature in millidegrees
+	if(read_u64(hwmon->power_fd, &v)) {
+		out->power_w = (float)v / 1e6f;
+		out->power_cap_w = read_u64(hwmon->power_cap_fd, &v) ? (float)v / 1e6f : 0;
+		out->valid |= GPU_FIELD_BIT(GPU_FIELD_POWER);
+	}
+	for(int t = 0; t < GPU_TEMP_COUNT; ++t) {
+		if(read_u64(hwmon->temp_fd[t], &v)) {
+			out->temp_c[t] = (float)v / 1000.0f;
+			out->temp_crit_c[t] = read_u64(hwmon->temp_crit_fd[t], &v) ? (float)v / 1000.0f : 0;
+			out->valid |= GPU_FIELD_BIT(GPU_FIELD_TEMP + t);
+		}
+	}
+	if(read_u64(hwmon->fan_fd, &v)) {
+		out->fan_rpm = (float)v;
+		out->fan_max_rpm = read_u64(hwmon->fan_max_fd, &v) ? (float)v : 0;
+		out->valid |= GPU_FIELD_BIT(GPU_FIELD_FAN);
+	}
+}
+
+void gpu_sysfs_pdev(const char *root, const char *card, char *out, size_t size) {
+	char path[PATH_MAX], target[PATH_MAX];
+	out[0] = '\0';
+	if(!card_dir(path, root, card, "device")) {
+		return;
+	}
+	ssize_t r = readlink(path, target, sizeof(target) - 1);
+	if(r > 0) {
+		target[r] = '\0';
+		const char *name = strrchr(target, '/');
+		snprintf(out, size, "%s", name ? name + 1 : target);
+	}
+}
+
+bool gpu_sysfs_sample(struct gpu_sysfs *sysfs, struct gpu_stats *out) {
+	memset(out, 0, sizeof(*out));
+
+	unsigned long long busy;
+	if(!read_u64(sysfs->busy_fd, &busy)) {
+		return false;
+	}
+	out->busy[GPU_BLOCK_GPU] = (float)busy;
+	out->valid = GPU_FIELD_BIT(GPU_BLOCK_GPU);
+
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	out->sample_time_us = (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+	out->valid |= GPU_FIELD_BIT(GPU_FIELD_TIMESTAMP);
+
+	unsigned int cur, max;
+	if(read_dpm(sysfs->sclk_fd, &cur, &max)) {
+		out->sclk = (float)cur * 100.0f / (float)max;
+		out->sclk_ghz = (float)cur / 1000.0f;
+		out->valid |= GPU_FIELD_BIT(GPU_FIELD_SCLK);
+	}
+	if(read_dpm(sysfs->mclk_fd, &cur, &max)) {
+		out->mclk = (float)cur * 100.0f / (float)max;
+		out->mclk_ghz = (float)cur / 1000.0f;
+		out->valid |= GPU_FIELD_BIT(GPU_FIELD_MCLK);
+	}
+	if(read_memory(sysfs->vram_used_fd, sysfs->vram_total_fd, &out->vram, &out->vram_mb)) {
+		out->valid |= GPU_FIELD_BIT(GPU_FIELD_VRAM);
+	}
+	if(read_memory(sysfs->gtt_used_fd, sysfs->gtt_total_fd, &out->gtt, &out->gtt_mb)) {
+		out->valid |= GPU_FIELD_BIT(GPU_FIELD_GTT);
+	}
+
+	return true;
+}
@@ -0,0 +1,52 @@
+#ifndef GPU_SYSFS_H
+#define GPU_SYSFS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "gpu_stats.h"
+
+#define SYSFS_DEFAULT_ROOT "/sys/class/drm"
+
+/* amdgpu sysfs reader. Files are opened once and re-read with pread() on
+ * every sample. Any fd except busy_fd could be -1 if kernel doesn't
+ * provide that file. */
+struct gpu_sysfs {
+	int busy_fd;		/* gpu_busy_percent */
+	int sclk_fd;		/* pp_dpm_sclk */
+	int mclk_fd;		/* pp_dpm_mclk */
+	int vram_used_fd;	/* mem_info_vram_used */
+	int vram_total_fd;	/* mem_info_vram_total */
+	int gtt_used_fd;	/* mem_info_gtt_used */
+	int gtt_total_fd;	/* mem_info_gtt_total */
+};
+
+/* amdgpu hwmon reader (<root>/<card>/device/hwmon/hwmonN), same way as
+ * above. Any fd could be -1 */
+struct gpu_hwmon {
+	int power_fd;		/* power1_average, or power1_input */
+	int power_cap_fd;	/* power1_cap */
+	int temp_fd[GPU_TEMP_COUNT];	/* tempN_input, by tempN_label */
+	int temp_crit_fd[GPU_TEMP_COUNT];	/* tempN_crit */
+	int fan_fd;		/* fan1_input */
+	int fan_max_fd;		/* fan1_max */
+};
+
+/* opens <root>/<card>/device/...; root is normally SYSFS_DEFAULT_ROOT but
+ * could point to fixture tree. Returns 0 on success */
+int gpu_sysfs_open(struct gpu_sysfs *sysfs, const char *root, const char *card);
+void gpu_sysfs_close(struct gpu_sysfs *sysfs);
+
+/* returns 0 if hwmon directory was found */
+int gpu_hwmon_open(struct gpu_hwmon *hwmon, const char *root, const char *card);
+void gpu_hwmon_close(struct gpu_hwmon *hwmon);
+
+/* fills hwmon fields of out and sets their valid bits */
+void gpu_hwmon_sample(struct gpu_hwmon *hwmon, struct gpu_stats *out);
+
+/* PCI address of <root>/<card>, as in drm-pdev of fdinfo; empty if unknown */
+void gpu_sysfs_pdev(const char *root, const char *card, char *out, size_t size);
+
+/* fills out with current values; returns false if gpu load can't be read */
+bool gpu_sysfs_sample(struct gpu_sysfs *sysfs, struct gpu_stats *out);
+
+#endif
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "history.h"
+
+_Static_assert(sizeof(struct history_header) <= HISTORY_HEADER_SIZE, "history header is too big");
+
+static size_t history_file_size(void) {
+	return HISTORY_HEADER_SIZE + (size_t)HISTORY_CAPACITY * sizeof(struct history_record);
+}
+
+static int history_valid(const struct history_header *hdr) {
+	return hdr->magic == HISTORY_MAGIC &&
+		hdr->version == HISTORY_VERSION &&
+		hdr->record_size == sizeof(struct history_record) &&
+		hdr->capacity == HISTORY_CAPACITY;
+}
+
+int history_open(struct history *h, const char *path) {
+	h->fd = -1;
+	h->header = NULL;
+	h->records = NULL;
+	h->size = history_file_size();
+
+	int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if(fd < 0) {
+		fprintf(stderr, "can't open history file %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) != 0) {
+		goto fail;
+	}
+	bool fresh = (size_t)st.st_size != h->size;
+	if(fresh && ftruncate(fd, 0) != 0) {
+		goto fail;
+	}
+	if(fresh && ftruncate(fd, (off_t)h->size) != 0) {
+		goto fail;
+	}
+
+	void *p = mmap(NULL, h->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(p == MAP_FAILED) {
+		goto fail;
+	}
+	h->fd = fd;
+	h->header = p;
+	h->records = (struct history_record *)((char *)p + HISTORY_HEADER_SIZE);
+
+	if(fresh || !history_valid(h->header)) {
+		// unknown format or version, start over
+		memset(p, 0, h->size);
+		h->header->magic = HISTORY_MAGIC;
+		h->header->version = HISTORY_VERSION;
+		h->header->record_size = sizeof(struct history_record);
+		h->header->capacity = HISTORY_CAPACITY;
+		atomic_store(&h->header->head, 0);
+	}
+	return 0;
+
+fail:
+	fprintf(stderr, "can't map history file %s: %s\n", path, strerror(errno));
+	close(fd);
+	return -1;
+}
+
+void history_close(struct history *h) {
+	if(h->header) {
+		munmap(h->header, h->size);
+	}
+	if(h->fd >= 0) {
+		close(h->fd);
+	}
+	h->fd = -1;
+	h->header = NULL;
+	h->records = NULL;
+}
+
+void history_append(struct history *h, uint64_t time_us, float gpu_pipe, float shader_clock) {
+	if(!h->header) {
+		return;
+	}
+	uint64_t seq = atomic_load_explicit(&h->header->head, memory_order_relaxed) + 1;
+	struct history_record *rec = &h->records[(seq - 1) % HISTORY_CAPACITY];
+
+	atomic_store_explicit(&rec->seq_begin, seq, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	rec->time_us = time_us;
+	rec->gpu_pipe = gpu_pipe;
+	rec->shader_clock = shader_clock;
+	atomic_store_explicit(&rec->seq_end, seq, memory_order_release);
+	atomic_store_explicit(&h->header->head, seq, memory_order_release);
+}
+
+static bool record_valid(const struct history_record *rec, uint64_t seq) {
+	return atomic_load_explicit(&rec->seq_end, memory_order_acquire) == seq &&
+		atomic_load_explicit(&rec->seq_begin, memory_order_relaxed) == seq;
+}
+
+size_t history_foreach(const struct history *h, uint64_t since_us, history_cb cb, void *data) {
+	if(!h->header) {
+		return 0;
+	}
+
+	// head is written after the record, but record after head could be
+	// complete if we crashed in between
+	uint64_t head = atomic_load_explicit(&h->header->head, memory_order_acquire);
+	if(record_valid(&h->records[head % HISTORY_CAPACITY], head + 1)) {
+		head++;
+	}
+	if(head == 0) {
+		return 0;
+	}
+
+	// find oldest record still in ring and not older than since_us
+	uint64_t first = head > HISTORY_CAPACITY ? head - HISTORY_CAPACITY + 1 : 1;
+	uint64_t lo = first, hi = head + 1;
+	while(lo < hi) {
+		uint64_t mid = lo + (hi - lo) / 2;
+		const struct history_record *rec = &h->records[(mid - 1) % HISTORY_CAPACITY];
+		if(record_valid(rec, mid) && rec->time_us < since_us) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	size_t n = 0;
+	for(uint64_t seq = lo; seq <= head; ++seq) {
+		const struct history_record *rec = &h->records[(seq - 1) % HISTORY_CAPACITY];
+		if(record_valid(rec, seq) && rec->time_us >= since_us) {
+			cb(rec, data);
+			n++;
+		}
+	}
+	return n;
+}
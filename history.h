@@ -0,0 +1,60 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Persistent sample history: fixed-size ring of records in a memory-mapped
+ * file, so chart could be restored after restart or crash.
+ *
+ * File layout (native endianness):
+ *   struct history_header, padded to HISTORY_HEADER_SIZE
+ *   struct history_record[capacity]
+ * Record n (counting from 1) lives in slot (n - 1) % capacity. Writer sets
+ * seq_begin, then payload, then seq_end; record is valid only if both equal
+ * its expected number, so a record torn by a crash is ignored. head is
+ * advanced after record is complete and is only a hint for readers. */
+
+#define HISTORY_MAGIC 0x48555047	// "GPUH"
+#define HISTORY_VERSION 1
+#define HISTORY_HEADER_SIZE 64
+#define HISTORY_CAPACITY 16384
+
+struct history_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t record_size;
+	uint32_t capacity;
+	uint32_t reserved;
+	_Atomic uint64_t head;	// number of last complete record, 0 if empty
+};
+
+struct history_record {
+	_Atomic uint64_t seq_begin;
+	uint64_t time_us;	// wall clock
+	float gpu_pipe;
+	float shader_clock;
+	_Atomic uint64_t seq_end;
+};
+
+struct history {
+	int fd;
+	size_t size;
+	struct history_header *header;
+	struct history_record *records;
+};
+
+/* maps (creating or resetting if incompatible) history file.
+ * Returns 0 on success */
+int history_open(struct history *h, const char *path);
+void history_close(struct history *h);
+
+void history_append(struct history *h, uint64_t time_us, float gpu_pipe, float shader_clock);
+
+/* Walks valid records with time_us >= since_us, oldest first, straight from
+ * the mapping. Returns number of records visited */
+typedef void (*history_cb)(const struct history_record *rec, void *data);
+size_t history_foreach(const struct history *h, uint64_t since_us, history_cb cb, void *data);
+
+#endif
@@ -0,0 +1,61 @@
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "line_reader.h"
+
+void line_reader_init(struct line_reader *lr) {
+	lr->start = lr->end = lr->scanned = 0;
+	lr->dropping = false;
+	lr->dropped = 0;
+}
+
+ssize_t line_reader_fill(struct line_reader *lr, int fd) {
+	if(lr->end == sizeof(lr->buf)) {
+		if(lr->start > 0) {
+			// incomplete line goes to front
+			memmove(lr->buf, lr->buf + lr->start, lr->end - lr->start);
+			lr->end -= lr->start;
+			lr->start = 0;
+		} else {
+			// no '\n' in a full buffer, skip this line up to its end
+			if(!lr->dropping) {
+				lr->dropped++;
+			}
+			lr->dropping = true;
+			lr->end = lr->scanned = 0;
+		}
+	} else if(lr->start == lr->end) {
+		lr->start = lr->end = lr->scanned = 0;
+	}
+
+	ssize_t r;
+	do {
+		r = read(fd, lr->buf + lr->end, sizeof(lr->buf) - lr->end);
+	} while(r < 0 && errno == EINTR);
+	if(r > 0) {
+		lr->end += (size_t)r;
+	}
+	return r;
+}
+
+bool line_reader_next(struct line_reader *lr, const char **line, size_t *len) {
+	while(1) {
+		const char *from = lr->buf + lr->start + lr->scanned;
+		const char *eol = memchr(from, '\n', lr->end - lr->start - lr->scanned);
+		if(!eol) {
+			lr->scanned = lr->end - lr->start;
+			return false;
+		}
+
+		const size_t line_start = lr->start;
+		lr->start = (size_t)(eol - lr->buf) + 1;
+		lr->scanned = 0;
+		if(lr->dropping) {
+			lr->dropping = false;	// that was the tail of oversize line
+			continue;
+		}
+		*line = lr->buf + line_start;
+		*len = (size_t)(eol - *line);
+		return true;
+	}
+}
@@ -0,0 +1,34 @@
+#ifndef LINE_READER_H
+#define LINE_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define LINE_READER_SIZE 16384	// longest line that isn't dropped, plus one
+
+/* Splits output of a non-blocking fd into lines. Every read() takes as much
+ * as fits into the buffer; lines are handed out in place, without '\n',
+ * and stay valid until next line_reader_fill(). Only an incomplete last
+ * line is moved to buffer start, when more room is needed. A line that
+ * doesn't fit into the buffer is dropped whole, up to its '\n'. */
+struct line_reader {
+	char buf[LINE_READER_SIZE];
+	size_t start;	// of first line not handed out yet
+	size_t end;	// of data read
+	size_t scanned;	// from start, known to contain no '\n'
+	bool dropping;	// rest of an oversize line is skipped
+	uint64_t dropped;	// oversize lines so far
+};
+
+void line_reader_init(struct line_reader *lr);
+
+/* reads once from fd, call it once line_reader_next() returned false;
+ * returns what read() did, except that it is retried on EINTR */
+ssize_t line_reader_fill(struct line_reader *lr, int fd);
+
+/* returns false if no complete line is buffered */
+bool line_reader_next(struct line_reader *lr, const char **line, size_t *len);
+
+#endif
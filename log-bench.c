@@ -0,0 +1,105 @@
+/* Sampler cost per sample with sample log off and on.
+ *
+ * Runs the sampler side of a radeontop sample, parse and publish, at a
+ * given rate, first without and then with a sample log writing to file,
+ * and prints latency percentiles of both. Small rotation size makes the
+ * writer rotate and sync often, so disk stalls would show up in the tail
+ * if they reached the sampler. */
+#define _GNU_SOURCE	// clock_nanosleep
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "radeontop_parse.h"
+#include "sample_log.h"
+
+static const char line[] = "1700000000.123456: bus 03, gpu 12.50%, ee 0.00%, vgt 3.33%, "
+	"ta 10.00%, sx 7.50%, sh 0.00%, spi 11.67%, sc 8.33%, pa 2.50%, db 7.50%, cb 6.67%, "
+	"vram 5.72% 468.35mb, gtt 0.47% 38.53mb, mclk 100.00% 1.750ghz, sclk 29.17% 0.350ghz\n";
+
+static void usage(const char *argv0) {
+	fprintf(stderr, "usage: %s [-r rate] [-s seconds] [-m rotate_bytes] file\n", argv0);
+	exit(1);
+}
+
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+	const uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+/* measures n samples, one every period_ns; returns samples the log dropped */
+static unsigned int run(struct sample_log *log, uint32_t *ns, size_t n, uint64_t period_ns) {
+	struct gpu_stats stats;
+	uint64_t at = monotonic_ns();
+	for(size_t i = 0; i < n; ++i) {
+		at += period_ns;
+		struct timespec ts = {
+			.tv_sec = (time_t)(at / 1000000000),
+			.tv_nsec = (long)(at % 1000000000),
+		};
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+
+		const uint64_t start = monotonic_ns();
+		radeontop_parse_line(line, sizeof(line) - 1, &stats);
+		stats.sample_time_us = start / 1000;
+		stats.busy[GPU_BLOCK_GPU] = (float)(i % 1000) / 10.0f;
+		if(log) {
+			sample_log_push(log, 0, &stats);
+		}
+		ns[i] = (uint32_t)(monotonic_ns() - start);
+	}
+	return log ? atomic_load(&log->dropped) : 0;
+}
+
+static void report(const char *name, uint32_t *ns, size_t n, unsigned int dropped) {
+	qsort(ns, n, sizeof(*ns), cmp_u32);
+	printf("%-8s %10u %10u %10u %10u %10u\n", name, ns[n / 2], ns[n * 99 / 100],
+			ns[n * 999 / 1000], ns[n - 1], dropped);
+}
+
+int main(int argc, char **argv) {
+	unsigned int rate = 1000, seconds = 5;
+	unsigned long rotate = 1024 * 1024;
+	int c;
+	while((c = getopt(argc, argv, "r:s:m:")) != -1) {
+		switch(c) {
+		case 'r': rate = (unsigned int)atoi(optarg); break;
+		case 's': seconds = (unsigned int)atoi(optarg); break;
+		case 'm': rotate = strtoul(optarg, NULL, 10); break;
+		default: usage(argv[0]);
+		}
+	}
+	if(optind + 1 != argc || !rate || !seconds) {
+		usage(argv[0]);
+	}
+
+	const size_t n = (size_t)rate * seconds;
+	uint32_t *off = malloc(n * sizeof(*off)), *on = malloc(n * sizeof(*on));
+	static struct sample_log log;
+	if(!off || !on) {
+		return 1;
+	}
+
+	const unsigned int dropped_off = run(NULL, off, n, 1000000000 / rate);
+	if(sample_log_start(&log, argv[optind], rotate, 2) != 0) {
+		return 1;
+	}
+	const unsigned int dropped_on = run(&log, on, n, 1000000000 / rate);
+	sample_log_stop(&log);
+
+	printf("%u samples/s for %u s, ns per sample\n", rate, seconds);
+	printf("%-8s %10s %10s %10s %10s %10s\n", "log", "p50", "p99", "p99.9", "max", "dropped");
+	report("off", off, n, dropped_off);
+	report("on", on, n, dropped_on);
+	free(off);
+	free(on);
+	return 0;
+}
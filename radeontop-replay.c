@@ -0,0 +1,187 @@
+/* Replays radeontop output recorded by the plugin (record option), for
+ * reproducing a workload without the GPU: put it into plugin command line
+ * in place of radeontop, e.g. "/path/radeontop-replay -x 4 gpu0.rec".
+ *
+ * Chunks are written to stdout as they were read, delayed as they were
+ * received, divided by speed; speed 0 writes everything as fast as the
+ * pipe takes it. Sample timestamps are moved to replay time the same way,
+ * so latency and gap accounting work, unless -k is given. */
+#define _GNU_SOURCE	// clock_nanosleep
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "stream_record.h"
+
+#define LINE_MAX_LEN 16384
+
+struct options {
+	double speed;
+	int keep_timestamps;
+	unsigned long loops;	// 0 = forever
+};
+
+static void usage(const char *argv0) {
+	fprintf(stderr, "usage: %s [-x speed] [-k] [-n loops] file\n", argv0);
+	exit(1);
+}
+
+static uint64_t clock_ns(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t deadline_ns) {
+	struct timespec ts = {
+		.tv_sec = (time_t)(deadline_ns / 1000000000),
+		.tv_nsec = (long)(deadline_ns % 1000000000),
+	};
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+static void write_all(const char *buf, size_t len) {
+	while(len) {
+		ssize_t r = write(STDOUT_FILENO, buf, len);
+		if(r < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			exit(errno == EPIPE ? 0 : 1);
+		}
+		buf += r;
+		len -= (size_t)r;
+	}
+}
+
+/* state of timestamp rewriting */
+struct retime {
+	uint64_t record_start_us;	// wall clock of recording start
+	uint64_t replay_start_us;	// wall clock of replay start
+	double speed;
+	char line[LINE_MAX_LEN];	// incomplete line of previous chunk
+	size_t len;
+	int banner_written;
+};
+
+/* appends line to out with its "sec.usec:" prefix moved to replay time;
+ * radeontop doesn't zero-pad microseconds. Only the first line without a
+ * timestamp (radeontop banner) is kept: banners of recorded restarts and
+ * of further loops would be parse errors to a single plugin run */
+static size_t retime_line(struct retime *rt, const char *line, size_t len, char *out) {
+	size_t i = 0;
+	uint64_t sec = 0, usec = 0;
+	while(i < len && line[i] >= '0' && line[i] <= '9') {
+		sec = sec * 10 + (uint64_t)(line[i++] - '0');
+	}
+	const size_t sec_end = i;
+	if(i < len && line[i] == '.') {
+		i++;
+	}
+	while(i < len && line[i] >= '0' && line[i] <= '9') {
+		usec = usec * 10 + (uint64_t)(line[i++] - '0');
+	}
+	if(!sec_end || i >= len || line[i] != ':') {
+		if(rt->banner_written) {
+			return 0;
+		}
+		rt->banner_written = 1;
+		memcpy(out, line, len);
+		return len;
+	}
+
+	uint64_t t;
+	if(rt->speed > 0) {
+		const double since = (double)(int64_t)(sec * 1000000 + usec - rt->record_start_us);
+		t = rt->replay_start_us + (uint64_t)(int64_t)(since / rt->speed);
+	} else {
+		t = clock_ns(CLOCK_REALTIME) / 1000;
+	}
+	const int n = sprintf(out, "%llu.%llu", (unsigned long long)(t / 1000000),
+			(unsigned long long)(t % 1000000));
+	memcpy(out + n, line + i, len - i);
+	return (size_t)n + len - i;
+}
+
+/* writes complete lines of chunk, retimed; keeps incomplete tail */
+static void retime_chunk(struct retime *rt, const char *data, size_t len) {
+	static char out[STREAM_MAX_CHUNK + LINE_MAX_LEN + 64];
+	size_t out_len = 0;
+
+	const char *eol;
+	while((eol = memchr(data, '\n', len))) {
+		const size_t part = (size_t)(eol - data) + 1;
+		if(rt->len + part <= sizeof(rt->line)) {
+			memcpy(rt->line + rt->len, data, part);
+			out_len += retime_line(rt, rt->line, rt->len + part, out + out_len);
+		}	// else oversize line is dropped, as plugin would
+		rt->len = 0;
+		data += part;
+		len -= part;
+	}
+	if(rt->len + len <= sizeof(rt->line)) {
+		memcpy(rt->line + rt->len, data, len);
+		rt->len += len;
+	} else {
+		rt->len = sizeof(rt->line) + 1;	// drop until next '\n'
+	}
+	write_all(out, out_len);
+}
+
+int main(int argc, char **argv) {
+	struct options opt = {
+		.speed = 1,
+		.loops = 1,
+	};
+
+	int c;
+	while((c = getopt(argc, argv, "x:kn:")) != -1) {
+		switch(c) {
+		case 'x': opt.speed = atof(optarg); break;
+		case 'k': opt.keep_timestamps = 1; break;
+		case 'n': opt.loops = strtoul(optarg, NULL, 10); break;
+		default: usage(argv[0]);
+		}
+	}
+	if(optind + 1 != argc || opt.speed < 0) {
+		usage(argv[0]);
+	}
+
+	static char buf[STREAM_MAX_CHUNK];
+	static struct retime rt;
+	rt.speed = opt.speed;
+
+	for(unsigned long loop = 0; !opt.loops || loop < opt.loops; ++loop) {
+		struct stream_reader r;
+		if(stream_reader_open(&r, argv[optind]) != 0) {
+			return 1;
+		}
+		rt.record_start_us = r.header.start_us;
+		rt.replay_start_us = clock_ns(CLOCK_REALTIME) / 1000;
+		rt.len = 0;
+
+		uint64_t at = clock_ns(CLOCK_MONOTONIC);
+		uint32_t delay_us;
+		ssize_t len;
+		while((len = stream_reader_next(&r, &delay_us, buf)) > 0) {
+			if(opt.speed > 0) {
+				at += (uint64_t)(delay_us * 1000.0 / opt.speed);
+				sleep_until(at);
+			}
+			if(opt.keep_timestamps) {
+				write_all(buf, (size_t)len);
+			} else {
+				retime_chunk(&rt, buf, (size_t)len);
+			}
+		}
+		stream_reader_close(&r);
+		if(len < 0) {
+			fprintf(stderr, "%s is truncated or damaged\n", argv[optind]);
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,75 @@
+#define _GNU_SOURCE	// syscall()
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "radeontop_child.h"
+
+static void set_nonblock(int fd) {
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+int radeontop_child_spawn(struct radeontop_child *child, const char *const *cmdline) {
+	struct subprocess_s *sp = &child->subprocess;
+	child->out_fd = child->err_fd = child->pidfd = -1;
+	if(subprocess_create(cmdline, 0, sp) != 0) {
+		return -1;
+	}
+
+	child->out_fd = fileno(subprocess_stdout(sp));
+	set_nonblock(child->out_fd);
+	child->err_fd = fileno(subprocess_stderr(sp));
+	set_nonblock(child->err_fd);
+
+	// pidfd is only a faster exit notification, EOF on pipe is enough without it
+#ifdef SYS_pidfd_open
+	child->pidfd = (int)syscall(SYS_pidfd_open, sp->child, 0);
+#endif
+	return 0;
+}
+
+void radeontop_child_stop(struct radeontop_child *child) {
+	if(child->out_fd < 0) {
+		return;
+	}
+	struct subprocess_s *sp = &child->subprocess;
+
+	// no-op if it has already exited, but we haven't reaped it yet;
+	// SIGKILL gets through SIGSTOP as well
+	subprocess_terminate(sp);
+	if(subprocess_join(sp, NULL) != 0) {
+		fprintf(stderr, "subprocess_join failed\n");
+	}
+	subprocess_destroy(sp);
+
+	if(child->pidfd >= 0) {
+		close(child->pidfd);
+	}
+	child->pidfd = child->out_fd = child->err_fd = -1;
+}
+
+void radeontop_child_pause(struct radeontop_child *child, bool pause) {
+	if(child->out_fd >= 0) {
+		kill(child->subprocess.child, pause ? SIGSTOP : SIGCONT);
+	}
+}
+
+void radeontop_child_drain_stderr(struct radeontop_child *child, struct stderr_ring *ring) {
+	char buf[1024];
+	while(1) {
+		ssize_t r = read(child->err_fd, buf, sizeof(buf));
+		if(r > 0) {
+			stderr_ring_append(ring, buf, (size_t)r);
+		} else if(r < 0 && errno == EINTR) {
+			continue;
+		} else {
+			if(r == 0 || errno != EAGAIN) {
+				// closed, stop polling it; fd itself belongs to subprocess
+				child->err_fd = -1;
+			}
+			return;
+		}
+	}
+}
@@ -0,0 +1,29 @@
+#ifndef RADEONTOP_CHILD_H
+#define RADEONTOP_CHILD_H
+
+#include <stdbool.h>
+#include "subprocess.h"
+#include "supervisor.h"
+
+/* radeontop (or a stand-in) process with non-blocking stdout and stderr
+ * pipes and a pidfd, to be waited on in poll() with anything else. */
+struct radeontop_child {
+	struct subprocess_s subprocess;
+	int out_fd;	// -1 if not running
+	int err_fd;	// -1 once stderr is closed
+	int pidfd;	// -1 if kernel has no pidfd_open, EOF on out_fd tells exit too
+};
+
+/* returns 0 on success, -1 if process couldn't be launched */
+int radeontop_child_spawn(struct radeontop_child *child, const char *const *cmdline);
+/* kills process, if it is still running, and reaps it; doesn't block on a
+ * stalled or stopped child */
+void radeontop_child_stop(struct radeontop_child *child);
+/* stops (SIGSTOP) or resumes (SIGCONT) process; stopped it uses no CPU
+ * and polls no GPU registers, and resumes with its next dump */
+void radeontop_child_pause(struct radeontop_child *child, bool pause);
+/* reads everything available on stderr into ring, sets err_fd to -1 once
+ * it is closed */
+void radeontop_child_drain_stderr(struct radeontop_child *child, struct stderr_ring *ring);
+
+#endif
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <time.h>
+#include "radeontop_ingest.h"
+#include "radeontop_parse.h"
+
+static uint64_t clock_ns(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+void sample_timing_update(struct sample_timing *t, struct gpu_stats *stats) {
+	stats->recv_time_ns = clock_ns(CLOCK_MONOTONIC);
+	const uint64_t now_us = clock_ns(CLOCK_REALTIME) / 1000;
+	stats->latency_us = (int32_t)((int64_t)now_us - (int64_t)stats->sample_time_us);
+
+	const uint64_t prev = t->last_sample_us;
+	const uint32_t interval = t->interval_us;
+	if(prev && stats->sample_time_us > prev) {
+		const uint64_t delta = stats->sample_time_us - prev;
+		if(interval && delta > (uint64_t)interval * 3 / 2) {
+			t->gaps++;
+			t->dropped += (uint32_t)((delta + interval / 2) / interval - 1);
+		}
+		// Gaps still count, but clamped both ways: leaving them out would let
+		// early lines drag interval down and then report bogus drops
+		uint64_t d = delta;
+		if(interval) {
+			d = d < interval / 2 ? interval / 2 : d > interval * 2ull ? interval * 2ull : d;
+		}
+		t->interval_us = interval ? (uint32_t)((interval * 7ull + d) / 8) : (uint32_t)d;
+	}
+	t->last_sample_us = stats->sample_time_us;
+
+	stats->interval_us = t->interval_us;
+	stats->gaps = t->gaps;
+	stats->dropped = t->dropped;
+}
+
+void radeontop_ingest_start(struct radeontop_ingest *in) {
+	line_reader_init(&in->lines);
+	in->first_line = true;
+}
+
+ssize_t radeontop_ingest_fill(struct radeontop_ingest *in, int fd) {
+	const uint64_t dropped = in->lines.dropped;
+	const ssize_t r = line_reader_fill(&in->lines, fd);
+	if(in->lines.dropped != dropped) {
+		fprintf(stderr, "radeontop output line is too long, dropping it\n");
+		in->parse_errors++;
+	}
+	return r;
+}
+
+bool radeontop_ingest_next(struct radeontop_ingest *in, struct gpu_stats *out) {
+	const char *line;
+	size_t len;
+	while(line_reader_next(&in->lines, &line, &len)) {
+		if(in->first_line) {
+			in->first_line = false;
+			continue;
+		}
+		if(radeontop_parse_line(line, len, out)) {
+			return true;
+		}
+		fprintf(stderr, "can't decode radeontop output \"%.*s\"\n", (int)len, line);
+		in->parse_errors++;
+	}
+	return false;
+}
@@ -0,0 +1,43 @@
+#ifndef RADEONTOP_INGEST_H
+#define RADEONTOP_INGEST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "gpu_stats.h"
+#include "line_reader.h"
+
+/* Ingest path of the sampler, shared by plugin and bench/bench_latency:
+ * radeontop stdout split into lines and decoded, and every sample, from
+ * any backend, stamped with its receive time and producer timing. */
+
+struct sample_timing {
+	uint64_t last_sample_us;	// producer time of previous sample, 0 after restart
+	uint32_t interval_us;	// smoothed producer sample interval
+	uint32_t gaps;
+	uint32_t dropped;
+};
+
+/* stamps receive time and latency, and tracks producer sample interval;
+ * a sample that comes more than 1.5 intervals after previous one is
+ * counted as gap */
+void sample_timing_update(struct sample_timing *t, struct gpu_stats *stats);
+
+struct radeontop_ingest {
+	struct line_reader lines;
+	bool first_line;	// radeontop banner, skipped
+	uint64_t parse_errors;	// lines that didn't decode or were too long
+};
+
+/* starts over for a new radeontop process; parse_errors are kept */
+void radeontop_ingest_start(struct radeontop_ingest *in);
+
+/* reads once from fd, call it once radeontop_ingest_next() returned false;
+ * returns what line_reader_fill() did */
+ssize_t radeontop_ingest_fill(struct radeontop_ingest *in, int fd);
+
+/* decodes next complete line into out, skipping (and counting) lines that
+ * don't decode; returns false if no complete line is left */
+bool radeontop_ingest_next(struct radeontop_ingest *in, struct gpu_stats *out);
+
+#endif
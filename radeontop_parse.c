@@ -0,0 +1,225 @@
+#include <string.h>
+#include "radeontop_parse.h"
+
+enum field_kind {
+	KIND_PERCENT,	/* "gpu 12.50%" */
+	KIND_MEMORY,	/* "vram 5.72% 468.35mb" */
+	KIND_CLOCK,	/* "sclk 29.17% 0.350ghz" */
+	KIND_HEX,	/* "bus 03" */
+};
+
+/* name of up to 4 lowercase letters as a switch key */
+#define NAME_KEY(a, b, c, d) ((uint32_t)(a) | (uint32_t)(b) << 8 | (uint32_t)(c) << 16 | (uint32_t)(d) << 24)
+#define FIELD(kind, field) ((kind) << 8 | (field))
+
+/* returns FIELD() of known name, -1 for unknown one */
+static int lookup(const char *name, size_t len) {
+	if(len < 2 || len > 4) {
+		return -1;
+	}
+	uint32_t key = NAME_KEY(name[0], name[1], 0, 0);
+	if(len > 2) {
+		key |= NAME_KEY(0, 0, name[2], len > 3 ? name[3] : 0);
+	}
+
+	switch(key) {
+	case NAME_KEY('b', 'u', 's', 0): return FIELD(KIND_HEX, GPU_FIELD_BUS);
+	case NAME_KEY('g', 'p', 'u', 0): return FIELD(KIND_PERCENT, GPU_BLOCK_GPU);
+	case NAME_KEY('e', 'e', 0, 0): return FIELD(KIND_PERCENT, GPU_BLOCK_EE);
+	case NAME_KEY('v', 'g', 't', 0): return FIELD(KIND_PERCENT, GPU_BLOCK_VGT);
+	case NAME_KEY('t', 'a', 0, 0): return FIELD(KIND_PERCENT, GPU_BLOCK_TA);
+	case NAME_KEY('s', 'x', 0, 0): return FIELD(KIND_PERCENT, GPU_BLOCK_SX);
+	case NAME_KEY('s', 'h', 0, 0): return FIELD(KIND_PERCENT, GPU_BLOCK_SH);
+	case NAME_KEY('s', 'p', 'i', 0): return FIELD(KIND_PERCENT, GPU_BLOCK_SPI);
+	case NAME_KEY('s', 'c', 0, 0): return FIELD(KIND_PERCENT, GPU_BLOCK_SC);
+	case NAME_KEY('p', 'a', 0, 0): return FIELD(KIND_PERCENT, GPU_BLOCK_PA);
+	case NAME_KEY('d', 'b', 0, 0): return FIELD(KIND_PERCENT, GPU_BLOCK_DB);
+	case NAME_KEY('c', 'b', 0, 0): return FIELD(KIND_PERCENT, GPU_BLOCK_CB);
+	case NAME_KEY('v', 'r', 'a', 'm'): return FIELD(KIND_MEMORY, GPU_FIELD_VRAM);
+	case NAME_KEY('g', 't', 't', 0): return FIELD(KIND_MEMORY, GPU_FIELD_GTT);
+	case NAME_KEY('m', 'c', 'l', 'k'): return FIELD(KIND_CLOCK, GPU_FIELD_MCLK);
+	case NAME_KEY('s', 'c', 'l', 'k'): return FIELD(KIND_CLOCK, GPU_FIELD_SCLK);
+	default: return -1;
+	}
+}
+
+static inline bool is_digit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+/* locale-independent "123.456"; returns position after number, or NULL */
+static const char *parse_decimal(const char *p, const char *end, float *out) {
+	if(p == end || !is_digit(*p)) {
+		return NULL;
+	}
+
+	unsigned long ip = 0;
+	while(p != end && is_digit(*p)) {
+		ip = ip * 10 + (unsigned long)(*p - '0');
+		p++;
+	}
+
+	float v = (float)ip;
+	if(p != end && *p == '.') {
+		p++;
+		static const float inverse[] = { 1, 1e-1f, 1e-2f, 1e-3f, 1e-4f, 1e-5f, 1e-6f };
+		unsigned long fp = 0;
+		unsigned int digits = 0;
+		while(p != end && is_digit(*p)) {
+			// radeontop prints at most 3 decimals, extra ones are ignored
+			if(digits < 6) {
+				fp = fp * 10 + (unsigned long)(*p - '0');
+				digits++;
+			}
+			p++;
+		}
+		v += (float)fp * inverse[digits];
+	}
+
+	*out = v;
+	return p;
+}
+
+static const char *parse_u64(const char *p, const char *end, uint64_t *out) {
+	if(p == end || !is_digit(*p)) {
+		return NULL;
+	}
+	uint64_t v = 0;
+	while(p != end && is_digit(*p)) {
+		v = v * 10 + (uint64_t)(*p - '0');
+		p++;
+	}
+	*out = v;
+	return p;
+}
+
+static const char *parse_hex(const char *p, const char *end, unsigned int *out) {
+	unsigned int v = 0;
+	const char *start = p;
+	for(; p != end; ++p) {
+		char c = *p;
+		if(is_digit(c)) {
+			v = v * 16 + (unsigned int)(c - '0');
+		} else if(c >= 'a' && c <= 'f') {
+			v = v * 16 + (unsigned int)(c - 'a' + 10);
+		} else if(c >= 'A' && c <= 'F') {
+			v = v * 16 + (unsigned int)(c - 'A' + 10);
+		} else {
+			break;
+		}
+	}
+	if(p == start) {
+		return NULL;
+	}
+	*out = v;
+	return p;
+}
+
+/* expects literal suffix (e.g. "%" or "mb") at p */
+static const char *expect(const char *p, const char *end, const char *lit, size_t len) {
+	if((size_t)(end - p) < len || memcmp(p, lit, len) != 0) {
+		return NULL;
+	}
+	return p + len;
+}
+
+static const char *skip_spaces(const char *p, const char *end) {
+	while(p != end && *p == ' ') {
+		p++;
+	}
+	return p;
+}
+
+bool radeontop_parse_line(const char *line, size_t len, struct gpu_stats *out) {
+	const char *p = line, *end = line + len;
+
+	memset(out, 0, sizeof(*out));
+
+	// "<sec>.<usec>: "; radeontop doesn't zero-pad usec, so read it as integer
+	uint64_t sec, usec = 0;
+	if(!(p = parse_u64(p, end, &sec))) {
+		return false;
+	}
+	if(p != end && *p == '.') {
+		if(!(p = parse_u64(p+1, end, &usec))) {
+			return false;
+		}
+	}
+	if(p == end || *p != ':') {
+		return false;
+	}
+	p++;
+	out->sample_time_us = sec * 1000000 + usec;
+	out->valid = GPU_FIELD_BIT(GPU_FIELD_TIMESTAMP);
+
+	while(p != end) {
+		// skip separators
+		while(p != end && (*p == ' ' || *p == ',')) {
+			p++;
+		}
+		const char *name = p;
+		while(p != end && *p >= 'a' && *p <= 'z') {
+			p++;
+		}
+		size_t name_len = (size_t)(p - name);
+
+		// a name that isn't lowercase (garbage, or a token of a future
+		// radeontop) ends up unknown too and is skipped to next ','
+		const int known = lookup(name, name_len);
+		const int kind = known >> 8, field = known & 0xff;
+
+		const char *value = skip_spaces(p, end);
+		const char *next = NULL;
+		float pct = 0, amount = 0;
+
+		if(known < 0) {
+			// unknown field (e.g. uvd/vce on newer radeontop), skip it
+		} else if(kind == KIND_HEX) {
+			next = parse_hex(value, end, &out->bus);
+		} else if((next = parse_decimal(value, end, &pct)) &&
+				(next = expect(next, end, "%", 1))) {
+			if(kind == KIND_MEMORY) {
+				next = parse_decimal(skip_spaces(next, end), end, &amount);
+				next = next ? expect(next, end, "mb", 2) : NULL;
+			} else if(kind == KIND_CLOCK) {
+				next = parse_decimal(skip_spaces(next, end), end, &amount);
+				next = next ? expect(next, end, "ghz", 3) : NULL;
+			}
+		}
+
+		if(next) {
+			switch(field) {
+			case GPU_FIELD_BUS:
+				break;
+			case GPU_FIELD_VRAM:
+				out->vram = pct;
+				out->vram_mb = amount;
+				break;
+			case GPU_FIELD_GTT:
+				out->gtt = pct;
+				out->gtt_mb = amount;
+				break;
+			case GPU_FIELD_MCLK:
+				out->mclk = pct;
+				out->mclk_ghz = amount;
+				break;
+			case GPU_FIELD_SCLK:
+				out->sclk = pct;
+				out->sclk_ghz = amount;
+				break;
+			default:
+				out->busy[field] = pct;
+				break;
+			}
+			out->valid |= GPU_FIELD_BIT(field);
+			p = next;
+		}
+
+		// resync on next field separator
+		while(p != end && *p != ',') {
+			p++;
+		}
+	}
+
+	return out->valid != GPU_FIELD_BIT(GPU_FIELD_TIMESTAMP);
+}
@@ -0,0 +1,18 @@
+#ifndef RADEONTOP_PARSE_H
+#define RADEONTOP_PARSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "gpu_stats.h"
+
+/* Decodes one line of `radeontop -d -` output, e.g.
+ * "1700000000.123456: bus 03, gpu 12.50%, ee 0.00%, ..., vram 5.72% 468.35mb,
+ *  gtt 0.47% 38.53mb, mclk 100.00% 1.750ghz, sclk 29.17% 0.350ghz"
+ * in a single forward pass. Line doesn't need to be NUL-terminated.
+ * Fields missing from the line are zeroed and not marked in out->valid;
+ * unknown fields are skipped.
+ * Returns false if line doesn't start with a timestamp or contains no
+ * known fields. */
+bool radeontop_parse_line(const char *line, size_t len, struct gpu_stats *out);
+
+#endif
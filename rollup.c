@@ -0,0 +1,66 @@
+#include <string.h>
+#include "rollup.h"
+
+const uint32_t rollup_periods[ROLLUP_LEVELS] = { 1, 10, 60, 600 };
+
+void rollup_init(struct rollup *r, uint64_t time_s) {
+	memset(r, 0, sizeof(*r));
+	for(int l = 0; l < ROLLUP_LEVELS; ++l) {
+		r->levels[l].period_s = rollup_periods[l];
+		r->levels[l].current = time_s / rollup_periods[l];
+	}
+}
+
+static void clear_slot(struct rollup_level *lvl, uint64_t period) {
+	memset(lvl->slots[period % ROLLUP_SLOTS], 0, sizeof(lvl->slots[0]));
+}
+
+unsigned int rollup_advance(struct rollup *r, uint64_t time_s) {
+	unsigned int closed = 0;
+	for(int l = 0; l < ROLLUP_LEVELS; ++l) {
+		struct rollup_level *lvl = &r->levels[l];
+		uint64_t period = time_s / lvl->period_s;
+		if(period <= lvl->current) {
+			continue;
+		}
+
+		// slots of skipped periods hold data from previous lap
+		uint64_t from = period - lvl->current > ROLLUP_SLOTS ?
+			period - ROLLUP_SLOTS + 1 : lvl->current + 1;
+		for(uint64_t p = from; p <= period; ++p) {
+			clear_slot(lvl, p);
+		}
+		lvl->current = period;
+		closed |= 1u << l;
+	}
+	return closed;
+}
+
+unsigned int rollup_add(struct rollup *r, uint64_t time_s, const float values[ROLLUP_CHANNELS]) {
+	const unsigned int closed = rollup_advance(r, time_s);
+
+	for(int l = 0; l < ROLLUP_LEVELS; ++l) {
+		// late samples go to open period
+		struct rollup_stat *slot = r->levels[l].slots[r->levels[l].current % ROLLUP_SLOTS];
+		for(int c = 0; c < ROLLUP_CHANNELS; ++c) {
+			struct rollup_stat *st = &slot[c];
+			const float v = values[c];
+			if(st->count == 0 || v < st->min) {
+				st->min = v;
+			}
+			if(st->count == 0 || v > st->max) {
+				st->max = v;
+			}
+			st->sum += v;
+			st->count++;
+		}
+	}
+	return closed;
+}
+
+const struct rollup_stat *rollup_get(const struct rollup *r, int level,
+		size_t age, enum rollup_channel channel) {
+	const struct rollup_level *lvl = &r->levels[level];
+	uint64_t period = lvl->current - 1 - age;
+	return &lvl->slots[period % ROLLUP_SLOTS][channel];
+}
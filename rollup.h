@@ -0,0 +1,56 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Cascading min/max/mean history at 1 s, 10 s, 1 min and 10 min resolution.
+ * Each level is a fixed ring of per-period stats, so memory use doesn't
+ * depend on uptime; adding a sample costs O(ROLLUP_LEVELS). */
+
+#define ROLLUP_LEVELS 4
+#define ROLLUP_SLOTS 512	// periods kept per level, 10 min level covers ~3.5 days
+
+enum rollup_channel {
+	ROLLUP_SHADER_CLOCK,
+	ROLLUP_GPU_PIPE,
+	ROLLUP_CHANNELS
+};
+
+struct rollup_stat {
+	float min, max, sum;
+	uint32_t count;
+};
+
+struct rollup_level {
+	uint32_t period_s;
+	uint64_t current;	// number of open period, time_s / period_s
+	struct rollup_stat slots[ROLLUP_SLOTS][ROLLUP_CHANNELS];
+};
+
+struct rollup {
+	struct rollup_level levels[ROLLUP_LEVELS];
+};
+
+extern const uint32_t rollup_periods[ROLLUP_LEVELS];
+
+void rollup_init(struct rollup *r, uint64_t time_s);
+
+/* moves every level to time_s, clearing skipped periods.
+ * Returns bitmask of levels that closed at least one period */
+unsigned int rollup_advance(struct rollup *r, uint64_t time_s);
+
+/* adds sample to open period, moving levels to time_s first.
+ * Returns bitmask of levels that closed a period doing so */
+unsigned int rollup_add(struct rollup *r, uint64_t time_s, const float values[ROLLUP_CHANNELS]);
+
+/* stats of closed period, age 0 is the most recent one and
+ * age < ROLLUP_SLOTS - 1 (open period occupies one slot) */
+const struct rollup_stat *rollup_get(const struct rollup *r, int level,
+		size_t age, enum rollup_channel channel);
+
+static inline float rollup_mean(const struct rollup_stat *st) {
+	return st->count ? st->sum / (float)st->count : 0;
+}
+
+#endif
@@ -0,0 +1,66 @@
+/* Prints a sample log (log option) as CSV, one line per sample, oldest
+ * first; give rotated files before current one, e.g.
+ * "sample-log-csv gpu.log.2 gpu.log.1 gpu.log". Empty cells are fields
+ * backend didn't report. */
+#include <stdio.h>
+#include "sample_log.h"
+
+static const char *const block_names[GPU_BLOCK_COUNT] = {
+	"gpu", "ee", "vgt", "ta", "sx", "sh", "spi", "sc", "pa", "db", "cb",
+};
+
+static void cell(uint32_t valid, int field, const char *fmt, double v) {
+	putchar(',');
+	if(valid & SAMPLE_LOG_BIT(field)) {
+		printf(fmt, v);
+	}
+}
+
+int main(int argc, char **argv) {
+	if(argc < 2) {
+		fprintf(stderr, "usage: %s file...\n", argv[0]);
+		return 1;
+	}
+
+	printf("time_us,gpu_id");
+	for(int i = 0; i < GPU_BLOCK_COUNT; ++i) {
+		printf(",%s", block_names[i]);
+	}
+	printf(",vram_mb,gtt_mb,sclk_mhz,mclk_mhz,power_w,temp_c\n");
+
+	int ret = 0;
+	for(int i = 1; i < argc; ++i) {
+		struct sample_log_reader r;
+		if(sample_log_reader_open(&r, argv[i]) != 0) {
+			ret = 1;
+			continue;
+		}
+		struct sample_log_entry e;
+		int n;
+		bool damaged = false;
+		while((n = sample_log_read(&r, &e)) != 0) {
+			if(n < 0) {
+				damaged = true;
+				continue;
+			}
+			printf("%llu,%u", (unsigned long long)e.time_us, e.gpu);
+			for(int b = 0; b < GPU_BLOCK_COUNT; ++b) {
+				cell(e.valid, SAMPLE_LOG_BUSY + b, "%.2f", e.value[SAMPLE_LOG_BUSY + b] / 100.0);
+			}
+			cell(e.valid, SAMPLE_LOG_VRAM, "%.0f", e.value[SAMPLE_LOG_VRAM]);
+			cell(e.valid, SAMPLE_LOG_GTT, "%.0f", e.value[SAMPLE_LOG_GTT]);
+			cell(e.valid, SAMPLE_LOG_SCLK, "%.0f", e.value[SAMPLE_LOG_SCLK]);
+			cell(e.valid, SAMPLE_LOG_MCLK, "%.0f", e.value[SAMPLE_LOG_MCLK]);
+			cell(e.valid, SAMPLE_LOG_POWER, "%.1f", e.value[SAMPLE_LOG_POWER] / 10.0);
+			cell(e.valid, SAMPLE_LOG_TEMP, "%.1f", e.value[SAMPLE_LOG_TEMP] / 10.0);
+			putchar('\n');
+		}
+		// samples around a record cut short by a crash are still printed
+		if(damaged) {
+			fprintf(stderr, "%s is truncated or damaged\n", argv[i]);
+			ret = 1;
+		}
+		sample_log_reader_close(&r);
+	}
+	return ret;
+}
@@ -0,0 +1,390 @@
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include "sample_log.h"
+
+static int32_t fixed(float v, float scale) {
+	v *= scale;
+	return (int32_t)(v < 0 ? v - 0.5f : v + 0.5f);
+}
+
+bool sample_log_push(struct sample_log *log, unsigned int gpu, const struct gpu_stats *s) {
+	unsigned int head = atomic_load_explicit(&log->head, memory_order_relaxed);
+	unsigned int tail = atomic_load_explicit(&log->tail, memory_order_acquire);
+	if(head - tail >= SAMPLE_LOG_QUEUE || gpu >= SAMPLE_LOG_MAX_GPUS) {
+		atomic_fetch_add_explicit(&log->dropped, 1, memory_order_relaxed);
+		return false;
+	}
+
+	struct sample_log_entry *e = &log->queue[head & (SAMPLE_LOG_QUEUE - 1)];
+	e->time_us = s->sample_time_us;
+	e->gpu = (uint8_t)gpu;
+	e->valid = s->valid & (GPU_FIELD_BIT(GPU_BLOCK_COUNT) - 1);
+	for(int i = 0; i < GPU_BLOCK_COUNT; ++i) {
+		e->value[SAMPLE_LOG_BUSY + i] = fixed(s->busy[i], 100.0f);
+	}
+
+	static const struct {
+		enum gpu_field from;
+		enum sample_log_field to;
+	} fields[] = {
+		{ GPU_FIELD_VRAM, SAMPLE_LOG_VRAM },
+		{ GPU_FIELD_GTT, SAMPLE_LOG_GTT },
+		{ GPU_FIELD_SCLK, SAMPLE_LOG_SCLK },
+		{ GPU_FIELD_MCLK, SAMPLE_LOG_MCLK },
+		{ GPU_FIELD_POWER, SAMPLE_LOG_POWER },
+	};
+	for(size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+		if(s->valid & GPU_FIELD_BIT(fields[i].from)) {
+			e->valid |= SAMPLE_LOG_BIT(fields[i].to);
+		}
+	}
+	e->value[SAMPLE_LOG_VRAM] = fixed(s->vram_mb, 1.0f);
+	e->value[SAMPLE_LOG_GTT] = fixed(s->gtt_mb, 1.0f);
+	e->value[SAMPLE_LOG_SCLK] = fixed(s->sclk_ghz, 1000.0f);
+	e->value[SAMPLE_LOG_MCLK] = fixed(s->mclk_ghz, 1000.0f);
+	e->value[SAMPLE_LOG_POWER] = fixed(s->power_w, 10.0f);
+
+	const enum gpu_temp t = s->valid & GPU_FIELD_BIT(GPU_FIELD_TEMP + GPU_TEMP_JUNCTION) ?
+		GPU_TEMP_JUNCTION : GPU_TEMP_EDGE;
+	if(s->valid & GPU_FIELD_BIT(GPU_FIELD_TEMP + t)) {
+		e->valid |= SAMPLE_LOG_BIT(SAMPLE_LOG_TEMP);
+	}
+	e->value[SAMPLE_LOG_TEMP] = fixed(s->temp_c[t], 10.0f);
+
+	atomic_store_explicit(&log->head, head + 1, memory_order_release);
+	return true;
+}
+
+static uint64_t monotonic_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void put_varint(struct sample_log *log, uint64_t v) {
+	while(v >= 0x80) {
+		log->buf[log->len++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	log->buf[log->len++] = (uint8_t)v;
+}
+
+static uint64_t zigzag(int64_t v) {
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static bool write_buf(struct sample_log *log) {
+	const uint8_t *p = log->buf;
+	size_t left = log->len;
+	log->len = 0;
+	while(left && log->fd >= 0) {
+		ssize_t r = write(log->fd, p, left);
+		if(r < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			// once: later samples are counted as dropped
+			fprintf(stderr, "can't write %s: %s, no longer logging\n", log->path, strerror(errno));
+			close(log->fd);
+			log->fd = -1;
+			return false;
+		}
+		p += r;
+		left -= (size_t)r;
+		log->size += (uint64_t)r;
+	}
+	return true;
+}
+
+/* opens path for appending and starts a segment; returns 0 on success */
+static int open_segment(struct sample_log *log) {
+	log->fd = open(log->path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if(log->fd < 0) {
+		fprintf(stderr, "can't open %s: %s\n", log->path, strerror(errno));
+		return -1;
+	}
+	struct stat st;
+	log->size = fstat(log->fd, &st) == 0 ? (uint64_t)st.st_size : 0;
+
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	const struct sample_log_header h = {
+		.magic = SAMPLE_LOG_MAGIC,
+		.version = SAMPLE_LOG_VERSION,
+		.fields = SAMPLE_LOG_FIELDS,
+		.start_us = (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000,
+	};
+	log->time_us = h.start_us;
+	memset(log->prev, 0, sizeof(log->prev));
+	log->buf[log->len++] = SAMPLE_LOG_SEGMENT;
+	memcpy(log->buf + log->len, &h, sizeof(h));
+	log->len += sizeof(h);
+	return 0;
+}
+
+/* <path>.<keep-1> -> <path>.<keep> ... <path> -> <path>.1 */
+static void rotate(struct sample_log *log) {
+	close(log->fd);
+	log->fd = -1;
+
+	char from[sizeof(log->path) + 16], to[sizeof(log->path) + 16];
+	for(unsigned int i = log->keep; i > 0; --i) {
+		snprintf(to, sizeof(to), "%s.%u", log->path, i);
+		if(i > 1) {
+			snprintf(from, sizeof(from), "%s.%u", log->path, i - 1);
+		} else {
+			snprintf(from, sizeof(from), "%s", log->path);
+		}
+		if(rename(from, to) != 0 && errno != ENOENT) {
+			fprintf(stderr, "can't rename %s: %s\n", from, strerror(errno));
+		}
+	}
+	if(!log->keep) {
+		unlink(log->path);
+	}
+	if(open_segment(log) != 0) {
+		fprintf(stderr, "no longer logging to %s\n", log->path);
+	}
+}
+
+static void encode(struct sample_log *log, const struct sample_log_entry *e) {
+	log->buf[log->len++] = e->gpu;
+	put_varint(log, zigzag((int64_t)(e->time_us - log->time_us)));
+	log->time_us = e->time_us;
+	put_varint(log, e->valid);
+
+	int32_t *prev = log->prev[e->gpu];
+	for(int f = 0; f < SAMPLE_LOG_FIELDS; ++f) {
+		if(e->valid & SAMPLE_LOG_BIT(f)) {
+			put_varint(log, zigzag((int64_t)e->value[f] - prev[f]));
+			prev[f] = e->value[f];
+		}
+	}
+}
+
+/* encodes and writes everything queued */
+static void drain(struct sample_log *log) {
+	// longest record: gpu, 10 byte time, 5 byte valid, 5 bytes per field
+	const size_t record_max = 1 + 10 + 5 + 5 * SAMPLE_LOG_FIELDS;
+
+	unsigned int tail = atomic_load_explicit(&log->tail, memory_order_relaxed);
+	unsigned int head = atomic_load_explicit(&log->head, memory_order_acquire);
+	if(log->fd < 0) {
+		// nowhere to write since a failed write or rotation
+		atomic_fetch_add_explicit(&log->dropped, head - tail, memory_order_relaxed);
+		tail = head;
+	}
+	for(; tail != head; ++tail) {
+		if(log->len + record_max > sizeof(log->buf)) {
+			write_buf(log);
+		}
+		encode(log, &log->queue[tail & (SAMPLE_LOG_QUEUE - 1)]);
+	}
+	atomic_store_explicit(&log->tail, tail, memory_order_release);
+	write_buf(log);
+
+	if(log->max_bytes && log->size >= log->max_bytes && log->fd >= 0) {
+		rotate(log);
+		write_buf(log);	// header of new segment
+	}
+}
+
+static void *writer_thread(void *arg) {
+	struct sample_log *log = arg;
+	write_buf(log);	// header of first segment
+
+	uint64_t sync_ms = monotonic_ms() + SAMPLE_LOG_SYNC_MS;
+	while(1) {
+		struct pollfd pfd = { .fd = log->wake_fd, .events = POLLIN };
+		const int r = poll(&pfd, 1, SAMPLE_LOG_FLUSH_MS);
+		drain(log);
+
+		const uint64_t now = monotonic_ms();
+		if(r > 0 || now >= sync_ms) {
+			if(log->fd >= 0) {
+				fdatasync(log->fd);
+			}
+			sync_ms = now + SAMPLE_LOG_SYNC_MS;
+		}
+		if(r > 0) {
+			break;	// stop
+		}
+	}
+
+	if(log->fd >= 0) {
+		close(log->fd);
+		log->fd = -1;
+	}
+	return NULL;
+}
+
+int sample_log_start(struct sample_log *log, const char *path, uint64_t max_bytes, unsigned int keep) {
+	snprintf(log->path, sizeof(log->path), "%s", path);
+	log->max_bytes = max_bytes;
+	log->keep = keep;
+	log->fd = -1;
+	// fault queue in now rather than on first pushes from sampler
+	memset(log->queue, 0, sizeof(log->queue));
+	atomic_store_explicit(&log->head, 0, memory_order_relaxed);
+	atomic_store_explicit(&log->tail, 0, memory_order_relaxed);
+	atomic_store_explicit(&log->dropped, 0, memory_order_relaxed);
+
+	// no writer for a file that can't be opened
+	log->thread = 0;
+	log->len = 0;
+	if(open_segment(log) != 0) {
+		return -1;
+	}
+	log->wake_fd = eventfd(0, EFD_CLOEXEC);
+	if(log->wake_fd < 0) {
+		fprintf(stderr, "can't create eventfd: %s\n", strerror(errno));
+		close(log->fd);
+		log->fd = -1;
+		return -1;
+	}
+	if(pthread_create(&log->thread, NULL, writer_thread, log) != 0) {
+		fprintf(stderr, "can't start sample log writer\n");
+		close(log->wake_fd);
+		close(log->fd);
+		log->fd = -1;
+		log->thread = 0;
+		return -1;
+	}
+	return 0;
+}
+
+void sample_log_stop(struct sample_log *log) {
+	if(!log->thread) {
+		return;
+	}
+	const uint64_t one = 1;
+	if(write(log->wake_fd, &one, sizeof(one)) < 0) {
+		fprintf(stderr, "can't stop sample log writer: %s\n", strerror(errno));
+	}
+	pthread_join(log->thread, NULL);
+	log->thread = 0;
+	close(log->wake_fd);
+}
+
+int sample_log_reader_open(struct sample_log_reader *r, const char *path) {
+	r->f = fopen(path, "rb");
+	if(!r->f) {
+		fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+void sample_log_reader_close(struct sample_log_reader *r) {
+	if(r->f) {
+		fclose(r->f);
+		r->f = NULL;
+	}
+}
+
+/* reads header that follows a segment marker and starts decoding from it;
+ * if there is none, leaves file just past the marker */
+static bool segment_header(struct sample_log_reader *r) {
+	const long at = ftell(r->f);
+	struct sample_log_header h;
+	if(fread(&h, sizeof(h), 1, r->f) != 1 || h.magic != SAMPLE_LOG_MAGIC ||
+			h.version != SAMPLE_LOG_VERSION || h.fields != SAMPLE_LOG_FIELDS) {
+		fseek(r->f, at, SEEK_SET);
+		return false;
+	}
+	r->time_us = h.start_us;
+	memset(r->prev, 0, sizeof(r->prev));
+	return true;
+}
+
+/* skips damaged bytes up to next segment, or end of file */
+static void resync(struct sample_log_reader *r) {
+	int c;
+	while((c = getc(r->f)) != EOF) {
+		if(c == SAMPLE_LOG_SEGMENT && segment_header(r)) {
+			return;
+		}
+	}
+}
+
+/* next byte of a record; EOF also where a new segment starts, as a record
+ * cut short by a crash is followed by segment of next writer */
+static int record_byte(struct sample_log_reader *r) {
+	const int c = getc(r->f);
+	if(c == SAMPLE_LOG_SEGMENT && segment_header(r)) {
+		return EOF;
+	}
+	return c;
+}
+
+static bool get_varint(struct sample_log_reader *r, uint64_t *out) {
+	uint64_t v = 0;
+	for(int shift = 0; shift < 64; shift += 7) {
+		const int c = record_byte(r);
+		if(c == EOF) {
+			return false;
+		}
+		v |= (uint64_t)(c & 0x7f) << shift;
+		if(!(c & 0x80)) {
+			*out = v;
+			return true;
+		}
+	}
+	resync(r);
+	return false;
+}
+
+int sample_log_read(struct sample_log_reader *r, struct sample_log_entry *out) {
+	int c;
+	while((c = getc(r->f)) == SAMPLE_LOG_SEGMENT) {
+		if(!segment_header(r)) {
+			resync(r);
+			return -1;
+		}
+	}
+	if(c == EOF) {
+		return 0;
+	}
+	if(c >= SAMPLE_LOG_MAX_GPUS) {
+		resync(r);
+		return -1;
+	}
+
+	uint64_t v;
+	out->gpu = (uint8_t)c;
+	if(!get_varint(r, &v)) {
+		return -1;
+	}
+	r->time_us += (uint64_t)unzigzag(v);
+	out->time_us = r->time_us;
+	if(!get_varint(r, &v)) {
+		return -1;
+	}
+	if(v >= SAMPLE_LOG_BIT(SAMPLE_LOG_FIELDS)) {
+		resync(r);
+		return -1;
+	}
+	out->valid = (uint32_t)v;
+
+	int32_t *prev = r->prev[out->gpu];
+	for(int f = 0; f < SAMPLE_LOG_FIELDS; ++f) {
+		if(out->valid & SAMPLE_LOG_BIT(f)) {
+			if(!get_varint(r, &v)) {
+				return -1;
+			}
+			prev[f] = (int32_t)(prev[f] + unzigzag(v));
+		}
+		out->value[f] = prev[f];
+	}
+	return 1;
+}
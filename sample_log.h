@@ -0,0 +1,110 @@
+#ifndef SAMPLE_LOG_H
+#define SAMPLE_LOG_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "gpu_stats.h"
+
+/* Long-term sample log. Sampler pushes samples into a single-producer
+ * single-consumer queue and never touches the file; a writer thread drains
+ * it every SAMPLE_LOG_FLUSH_MS, appends encoded samples with one write(),
+ * fdatasync()s every SAMPLE_LOG_SYNC_MS and rotates file by size to
+ * <path>.1 ... <path>.<keep>. A full queue drops samples (and counts them),
+ * as does a file that fails to write or reopen at rotation, reported once.
+ *
+ * File is a sequence of segments, one per writer start or rotation:
+ *   0xff, struct sample_log_header (native endianness)
+ *   records: gpu byte (< 0xff), varint zigzag time delta (us),
+ *            varint valid (SAMPLE_LOG_BIT), then for every valid field
+ *            varint zigzag delta from previous value of that GPU
+ * Deltas start from header start_us and zero values in every segment.
+ * 0xff also occurs inside varints, so a segment starts only where it is
+ * followed by a valid header; reader resyncs on that after damage such as
+ * a record cut short by a crash. */
+
+#define SAMPLE_LOG_MAGIC 0x4c555047	// "GPUL"
+#define SAMPLE_LOG_VERSION 1
+#define SAMPLE_LOG_SEGMENT 0xff
+#define SAMPLE_LOG_QUEUE 4096	// must be power of 2
+#define SAMPLE_LOG_MAX_GPUS 16
+#define SAMPLE_LOG_FLUSH_MS 1000
+#define SAMPLE_LOG_SYNC_MS 30000
+
+/* logged values, fixed point */
+enum sample_log_field {
+	SAMPLE_LOG_BUSY,	/* + enum gpu_block, 0.01 % */
+	SAMPLE_LOG_VRAM = SAMPLE_LOG_BUSY + GPU_BLOCK_COUNT,	/* MiB */
+	SAMPLE_LOG_GTT,		/* MiB */
+	SAMPLE_LOG_SCLK,	/* MHz */
+	SAMPLE_LOG_MCLK,	/* MHz */
+	SAMPLE_LOG_POWER,	/* 0.1 W */
+	SAMPLE_LOG_TEMP,	/* 0.1 degree C, junction or edge */
+	SAMPLE_LOG_FIELDS
+};
+
+#define SAMPLE_LOG_BIT(f) (1u << (f))
+
+struct sample_log_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t fields;	// SAMPLE_LOG_FIELDS
+	uint64_t start_us;
+};
+
+struct sample_log_entry {
+	uint64_t time_us;	// wall clock
+	uint32_t valid;		// SAMPLE_LOG_BIT() of fields
+	uint8_t gpu;
+	int32_t value[SAMPLE_LOG_FIELDS];
+};
+
+struct sample_log {
+	// sampler to writer
+	atomic_uint head;
+	atomic_uint tail;
+	atomic_uint dropped;
+	struct sample_log_entry queue[SAMPLE_LOG_QUEUE];
+
+	pthread_t thread;	// 0 if not running
+	int wake_fd;		// eventfd, signalled on stop
+	char path[256];
+	uint64_t max_bytes;
+	unsigned int keep;
+
+	// writer thread only
+	int fd;
+	uint64_t size;
+	uint64_t time_us;	// of previous record
+	int32_t prev[SAMPLE_LOG_MAX_GPUS][SAMPLE_LOG_FIELDS];
+	uint8_t buf[65536];
+	size_t len;
+};
+
+/* opens path for appending and starts writer; returns 0 on success, -1
+ * without a writer if path can't be opened */
+int sample_log_start(struct sample_log *log, const char *path, uint64_t max_bytes, unsigned int keep);
+
+/* writes what is queued and stops writer; no-op if not running */
+void sample_log_stop(struct sample_log *log);
+
+/* queues sample, never blocks; returns false if queue is full */
+bool sample_log_push(struct sample_log *log, unsigned int gpu, const struct gpu_stats *s);
+
+struct sample_log_reader {
+	FILE *f;
+	uint64_t time_us;
+	int32_t prev[SAMPLE_LOG_MAX_GPUS][SAMPLE_LOG_FIELDS];
+};
+
+/* returns 0 on success */
+int sample_log_reader_open(struct sample_log_reader *r, const char *path);
+void sample_log_reader_close(struct sample_log_reader *r);
+
+/* returns 1 with next sample in out, 0 at end of file, -1 if damaged
+ * bytes were skipped; reading goes on from next segment after -1 */
+int sample_log_read(struct sample_log_reader *r, struct sample_log_entry *out);
+
+#endif
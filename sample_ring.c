@@ -0,0 +1,91 @@
+#include "sample_ring.h"
+
+bool sample_ring_push(struct sample_ring *ring, const struct sample *s) {
+	unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+	if(head - tail >= SAMPLE_RING_SIZE) {
+		atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+		return false;
+	}
+	ring->samples[head & (SAMPLE_RING_SIZE - 1)] = *s;
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+	return true;
+}
+
+size_t sample_ring_drain(struct sample_ring *ring, struct sample *out, size_t max) {
+	unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	size_t n = 0;
+	for(; tail != head && n < max; ++tail, ++n) {
+		out[n] = ring->samples[tail & (SAMPLE_RING_SIZE - 1)];
+	}
+	atomic_store_explicit(&ring->tail, tail, memory_order_release);
+	return n;
+}
+
+static inline void swap(float *a, float *b) {
+	float t = *a;
+	*a = *b;
+	*b = t;
+}
+
+/* k-th smallest value (Hoare's selection), average O(n) */
+static float select_kth(float *v, size_t n, size_t k) {
+	size_t lo = 0, hi = n - 1;
+	while(lo < hi) {
+		// median of three as pivot, keeps sorted/constant input linear
+		size_t mid = lo + (hi - lo) / 2;
+		if(v[mid] < v[lo]) swap(&v[mid], &v[lo]);
+		if(v[hi] < v[lo]) swap(&v[hi], &v[lo]);
+		if(v[hi] < v[mid]) swap(&v[hi], &v[mid]);
+		float pivot = v[mid];
+
+		size_t i = lo, j = hi;
+		while(i <= j) {
+			while(v[i] < pivot) i++;
+			while(pivot < v[j]) j--;
+			if(i <= j) {
+				swap(&v[i], &v[j]);
+				i++;
+				if(j == 0) {
+					break;
+				}
+				j--;
+			}
+		}
+
+		if(k <= j) {
+			hi = j;
+		} else if(k >= i) {
+			lo = i;
+		} else {
+			break;
+		}
+	}
+	return v[k];
+}
+
+float sample_reduce(float *values, size_t n, enum sample_reduction reduction) {
+	switch(reduction) {
+	case REDUCE_MAX: {
+		float m = values[0];
+		for(size_t i = 1; i < n; ++i) {
+			if(values[i] > m) {
+				m = values[i];
+			}
+		}
+		return m;
+	}
+	case REDUCE_P95:
+		// nearest-rank percentile
+		return select_kth(values, n, (n * 95 + 99) / 100 - 1);
+	case REDUCE_MEAN:
+	default: {
+		float sum = 0;
+		for(size_t i = 0; i < n; ++i) {
+			sum += values[i];
+		}
+		return sum / (float)n;
+	}
+	}
+}
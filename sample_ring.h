@@ -0,0 +1,45 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* enough for a few hundred samples between chart columns */
+#define SAMPLE_RING_SIZE 512	// must be power of 2
+
+enum sample_reduction {
+	REDUCE_MEAN,
+	REDUCE_MAX,
+	REDUCE_P95,
+	REDUCE_COUNT
+};
+
+/* values charted for one sample */
+struct sample {
+	uint64_t time_us;
+	float gpu_pipe;
+	float shader_clock;
+};
+
+/* Single-producer single-consumer ring; sampler thread pushes every decoded
+ * sample, GTK thread drains it once per chart column. */
+struct sample_ring {
+	atomic_uint head;	// written by producer
+	atomic_uint tail;	// written by consumer
+	atomic_uint dropped;	// samples lost because ring was full
+	struct sample samples[SAMPLE_RING_SIZE];
+};
+
+/* returns false (and counts drop) if ring is full */
+bool sample_ring_push(struct sample_ring *ring, const struct sample *s);
+
+/* moves up to max oldest samples to out, returns count */
+size_t sample_ring_drain(struct sample_ring *ring, struct sample *out, size_t max);
+
+/* Reduces n values to one. Runs in O(n) without allocation; values is used
+ * as scratch space and reordered. n must be > 0 */
+float sample_reduce(float *values, size_t n, enum sample_reduction reduction);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef STATS_SEQLOCK_H
+#define STATS_SEQLOCK_H
+
+#include <stdatomic.h>
+#include <string.h>
+#include "gpu_stats.h"
+
+/* Single-writer seqlock around gpu_stats. Writer never waits; readers
+ * retry if they raced with a write. seq is odd while write is in progress,
+ * seq/2 is the number of published samples (generation). */
+struct stats_seqlock {
+	atomic_uint seq;
+	struct gpu_stats stats;
+};
+
+static inline void stats_seqlock_write(struct stats_seqlock *sl, const struct gpu_stats *stats) {
+	unsigned int seq = atomic_load_explicit(&sl->seq, memory_order_relaxed);
+	atomic_store_explicit(&sl->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	memcpy(&sl->stats, stats, sizeof(*stats));
+	atomic_store_explicit(&sl->seq, seq + 2, memory_order_release);
+}
+
+static inline unsigned int stats_seqlock_generation(struct stats_seqlock *sl) {
+	return atomic_load_explicit(&sl->seq, memory_order_acquire) >> 1;
+}
+
+/* copies consistent snapshot into out, returns its generation */
+static inline unsigned int stats_seqlock_read(struct stats_seqlock *sl, struct gpu_stats *out) {
+	unsigned int seq0, seq1;
+	do {
+		seq0 = atomic_load_explicit(&sl->seq, memory_order_acquire);
+		memcpy(out, &sl->stats, sizeof(*out));
+		atomic_thread_fence(memory_order_acquire);
+		seq1 = atomic_load_explicit(&sl->seq, memory_order_relaxed);
+	} while((seq0 & 1) || seq0 != seq1);
+	return seq0 >> 1;
+}
+
+#endif
@@ -0,0 +1,198 @@
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/time.h>
+#include "stream_record.h"
+
+/* copies chunk header and data behind head, unless there isn't room */
+static bool queue_put(struct stream_writer *w, const uint32_t chunk[2], const char *data) {
+	const size_t head = atomic_load_explicit(&w->head, memory_order_relaxed);
+	const size_t tail = atomic_load_explicit(&w->tail, memory_order_acquire);
+	const size_t len = 2 * sizeof(chunk[0]) + chunk[1];
+	if(STREAM_QUEUE_SIZE - (head - tail) < len) {
+		return false;
+	}
+
+	const char *parts[2] = { (const char *)chunk, data };
+	const size_t sizes[2] = { 2 * sizeof(chunk[0]), chunk[1] };
+	size_t at = head;
+	for(int i = 0; i < 2; ++i) {
+		const size_t off = at & (STREAM_QUEUE_SIZE - 1);
+		const size_t first = sizes[i] < STREAM_QUEUE_SIZE - off ? sizes[i] : STREAM_QUEUE_SIZE - off;
+		memcpy(w->queue + off, parts[i], first);
+		memcpy(w->queue, parts[i] + first, sizes[i] - first);
+		at += sizes[i];
+	}
+	atomic_store_explicit(&w->head, at, memory_order_release);
+	return true;
+}
+
+/* writes everything queued; after a write error the rest is discarded */
+static void drain(struct stream_writer *w) {
+	size_t tail = atomic_load_explicit(&w->tail, memory_order_relaxed);
+	const size_t head = atomic_load_explicit(&w->head, memory_order_acquire);
+	while(tail != head && w->fd >= 0) {
+		const size_t off = tail & (STREAM_QUEUE_SIZE - 1);
+		const size_t len = head - tail < STREAM_QUEUE_SIZE - off ? head - tail : STREAM_QUEUE_SIZE - off;
+		const ssize_t r = write(w->fd, w->queue + off, len);
+		if(r < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			fprintf(stderr, "can't record radeontop output to %s: %s\n", w->path, strerror(errno));
+			close(w->fd);
+			w->fd = -1;
+			break;
+		}
+		tail += (size_t)r;
+	}
+	atomic_store_explicit(&w->tail, head, memory_order_release);
+}
+
+static void *writer_thread(void *arg) {
+	struct stream_writer *w = arg;
+	while(1) {
+		struct pollfd pfd = { .fd = w->wake_fd, .events = POLLIN };
+		const int r = poll(&pfd, 1, STREAM_FLUSH_MS);
+		drain(w);
+		if(r > 0) {
+			break;	// close
+		}
+	}
+	if(w->fd >= 0) {
+		close(w->fd);
+		w->fd = -1;
+	}
+	return NULL;
+}
+
+int stream_writer_open(struct stream_writer *w, const char *path) {
+	snprintf(w->path, sizeof(w->path), "%s", path);
+	w->thread = 0;
+	w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if(w->fd < 0) {
+		fprintf(stderr, "can't create %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	w->last_ns = (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+
+	const struct stream_header h = {
+		.magic = STREAM_MAGIC,
+		.version = STREAM_VERSION,
+		.start_us = (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec,
+	};
+	if(write(w->fd, &h, sizeof(h)) != (ssize_t)sizeof(h)) {
+		fprintf(stderr, "can't write %s: %s\n", path, strerror(errno));
+		close(w->fd);
+		w->fd = -1;
+		return -1;
+	}
+
+	// fault queue in now rather than on first chunks from sampler
+	memset(w->queue, 0, sizeof(w->queue));
+	atomic_store_explicit(&w->head, 0, memory_order_relaxed);
+	atomic_store_explicit(&w->tail, 0, memory_order_relaxed);
+	atomic_store_explicit(&w->dropped, 0, memory_order_relaxed);
+
+	w->wake_fd = eventfd(0, EFD_CLOEXEC);
+	if(w->wake_fd < 0) {
+		fprintf(stderr, "can't create eventfd: %s\n", strerror(errno));
+		close(w->fd);
+		w->fd = -1;
+		return -1;
+	}
+	if(pthread_create(&w->thread, NULL, writer_thread, w) != 0) {
+		fprintf(stderr, "can't start radeontop output recorder\n");
+		close(w->wake_fd);
+		close(w->fd);
+		w->fd = -1;
+		w->thread = 0;
+		return -1;
+	}
+	return 0;
+}
+
+void stream_writer_close(struct stream_writer *w) {
+	if(!w->thread) {
+		return;
+	}
+	const uint64_t one = 1;
+	if(write(w->wake_fd, &one, sizeof(one)) < 0) {
+		fprintf(stderr, "can't stop radeontop output recorder: %s\n", strerror(errno));
+	}
+	pthread_join(w->thread, NULL);
+	w->thread = 0;
+	close(w->wake_fd);
+
+	const unsigned int dropped = atomic_load_explicit(&w->dropped, memory_order_relaxed);
+	if(dropped) {
+		fprintf(stderr, "%u chunks of radeontop output didn't fit in queue, left out of %s\n",
+				dropped, w->path);
+	}
+}
+
+void stream_writer_chunk(struct stream_writer *w, uint64_t now_ns, const char *data, size_t len) {
+	if(!w->thread) {
+		return;
+	}
+	while(len) {
+		const uint64_t delay_us = (now_ns - w->last_ns) / 1000;
+		const uint32_t chunk[2] = {
+			delay_us > UINT32_MAX ? UINT32_MAX : (uint32_t)delay_us,
+			(uint32_t)(len < STREAM_MAX_CHUNK ? len : STREAM_MAX_CHUNK),
+		};
+		if(!queue_put(w, chunk, data)) {
+			atomic_fetch_add_explicit(&w->dropped, 1, memory_order_relaxed);
+			return;
+		}
+		w->last_ns = now_ns;
+		data += chunk[1];
+		len -= chunk[1];
+	}
+}
+
+int stream_reader_open(struct stream_reader *r, const char *path) {
+	r->f = fopen(path, "rb");
+	if(!r->f) {
+		fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if(fread(&r->header, sizeof(r->header), 1, r->f) != 1 ||
+			r->header.magic != STREAM_MAGIC || r->header.version != STREAM_VERSION) {
+		fprintf(stderr, "%s is not a radeontop recording\n", path);
+		stream_reader_close(r);
+		return -1;
+	}
+	return 0;
+}
+
+void stream_reader_close(struct stream_reader *r) {
+	if(r->f) {
+		fclose(r->f);
+		r->f = NULL;
+	}
+}
+
+ssize_t stream_reader_next(struct stream_reader *r, uint32_t *delay_us, char *buf) {
+	uint32_t chunk[2];
+	const size_t n = fread(chunk, 1, sizeof(chunk), r->f);
+	if(n == 0 && feof(r->f)) {
+		return 0;
+	}
+	if(n != sizeof(chunk) || chunk[1] > STREAM_MAX_CHUNK ||
+			fread(buf, 1, chunk[1], r->f) != chunk[1]) {
+		return -1;
+	}
+	*delay_us = chunk[0];
+	return (ssize_t)chunk[1];
+}
@@ -0,0 +1,72 @@
+#ifndef STREAM_RECORD_H
+#define STREAM_RECORD_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/* Raw radeontop stdout, as read, with receive times.
+ *
+ * File layout (native endianness):
+ *   struct stream_header
+ *   chunks of: uint32 delay_us (since previous chunk, or since start_us for
+ *   the first one), uint32 len, len bytes of output
+ * Delays over UINT32_MAX us are saturated. */
+
+#define STREAM_MAGIC 0x53545247	// "GRTS"
+#define STREAM_VERSION 1
+#define STREAM_MAX_CHUNK 65536
+#define STREAM_QUEUE_SIZE 262144	// bytes, must be power of 2
+#define STREAM_FLUSH_MS 1000
+
+struct stream_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	uint64_t start_us;	// wall clock when recording started
+};
+
+/* Recorder never writes on caller's thread: chunks are copied into a
+ * single-producer single-consumer byte queue, which a writer thread appends
+ * to file every STREAM_FLUSH_MS. A chunk that doesn't fit into queue is
+ * dropped (and counted); delay of the next one still includes it. */
+struct stream_writer {
+	// caller to writer
+	atomic_size_t head;	// bytes queued so far
+	atomic_size_t tail;	// bytes written (or dropped on error) so far
+	atomic_uint dropped;	// chunks
+	uint8_t queue[STREAM_QUEUE_SIZE];
+
+	pthread_t thread;	// 0 if not recording
+	int wake_fd;		// eventfd, signalled on close
+	char path[256];
+	uint64_t last_ns;	// CLOCK_MONOTONIC of previous chunk, caller only
+
+	int fd;			// writer thread only, -1 after write error
+};
+
+/* creates (truncating) path and starts writer; returns 0 on success */
+int stream_writer_open(struct stream_writer *w, const char *path);
+
+/* writes what is queued and stops writer; no-op if not recording */
+void stream_writer_close(struct stream_writer *w);
+
+/* queues one read(), never blocks; now_ns is CLOCK_MONOTONIC */
+void stream_writer_chunk(struct stream_writer *w, uint64_t now_ns, const char *data, size_t len);
+
+struct stream_reader {
+	FILE *f;
+	struct stream_header header;
+};
+
+/* returns 0 on success */
+int stream_reader_open(struct stream_reader *r, const char *path);
+void stream_reader_close(struct stream_reader *r);
+
+/* reads next chunk into buf (STREAM_MAX_CHUNK bytes); returns its length,
+ * 0 at end of file, -1 if file is damaged */
+ssize_t stream_reader_next(struct stream_reader *r, uint32_t *delay_us, char *buf);
+
+#endif
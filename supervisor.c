@@ -0,0 +1,92 @@
+#include <string.h>
+#include "supervisor.h"
+
+void supervisor_init(struct supervisor *sv, uint32_t seed) {
+	memset(sv, 0, sizeof(*sv));
+	sv->random = seed ? seed : 1;
+}
+
+void supervisor_started(struct supervisor *sv, uint64_t now_ms) {
+	sv->started_ms = now_ms;
+}
+
+void supervisor_running(struct supervisor *sv, uint64_t now_ms) {
+	if(sv->failures && now_ms - sv->started_ms >= SUPERVISOR_STABLE_MS) {
+		sv->failures = 0;
+		sv->crash_loop = false;
+		memset(sv->failure_ms, 0, sizeof(sv->failure_ms));
+	}
+}
+
+// xorshift32, only to spread restarts of several instances apart
+static uint32_t next_random(struct supervisor *sv) {
+	uint32_t x = sv->random;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return sv->random = x;
+}
+
+uint64_t supervisor_failed(struct supervisor *sv, uint64_t now_ms) {
+	supervisor_running(sv, now_ms);
+
+	sv->failure_ms[sv->failure_pos] = now_ms;
+	sv->failure_pos = (sv->failure_pos + 1) % SUPERVISOR_LOOP_FAILURES;
+	// next slot to overwrite holds the oldest of last SUPERVISOR_LOOP_FAILURES
+	const uint64_t oldest = sv->failure_ms[sv->failure_pos];
+	if(oldest && now_ms - oldest < SUPERVISOR_LOOP_WINDOW_MS) {
+		sv->crash_loop = true;
+	}
+
+	uint64_t delay = SUPERVISOR_MAX_DELAY_MS;
+	if(!sv->crash_loop && sv->failures < 16) {
+		delay = (uint64_t)SUPERVISOR_BASE_DELAY_MS << sv->failures;
+		if(delay > SUPERVISOR_MAX_DELAY_MS) {
+			delay = SUPERVISOR_MAX_DELAY_MS;
+		}
+	}
+	sv->failures++;
+
+	// equal jitter: at least half of delay, so backoff still grows
+	return delay / 2 + next_random(sv) % (delay / 2 + 1);
+}
+
+void stderr_ring_append(struct stderr_ring *ring, const char *data, size_t len) {
+	if(len > STDERR_RING_SIZE) {
+		ring->written += len - STDERR_RING_SIZE;
+		data += len - STDERR_RING_SIZE;
+		len = STDERR_RING_SIZE;
+	}
+	size_t pos = ring->written & (STDERR_RING_SIZE - 1);
+	size_t first = len < STDERR_RING_SIZE - pos ? len : STDERR_RING_SIZE - pos;
+	memcpy(ring->buf + pos, data, first);
+	memcpy(ring->buf, data + first, len - first);
+	ring->written += len;
+}
+
+size_t stderr_ring_last_line(const struct stderr_ring *ring, char *out, size_t size) {
+	const uint64_t begin = ring->written > STDERR_RING_SIZE ? ring->written - STDERR_RING_SIZE : 0;
+	uint64_t end = ring->written;
+#define AT(i) ring->buf[(i) & (STDERR_RING_SIZE - 1)]
+	while(end > begin && (AT(end - 1) == '\n' || AT(end - 1) == '\r')) {
+		end--;
+	}
+	uint64_t start = end;
+	while(start > begin && AT(start - 1) != '\n') {
+		start--;
+	}
+	if(size == 0) {
+		return 0;
+	}
+	if(end - start > size - 1) {
+		start = end - (size - 1);
+	}
+	size_t n = 0;
+	for(uint64_t i = start; i < end; ++i) {
+		char c = AT(i);
+		out[n++] = (c >= ' ' && c != 0x7f) ? c : ' ';
+	}
+#undef AT
+	out[n] = '\0';
+	return n;
+}
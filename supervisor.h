@@ -0,0 +1,53 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Restart policy for backend process: exponential backoff with jitter,
+ * reset once backend has been running for a while, and crash loop
+ * detection that holds off at maximum delay until backend is stable. */
+
+#define SUPERVISOR_BASE_DELAY_MS 1000
+#define SUPERVISOR_MAX_DELAY_MS 60000
+#define SUPERVISOR_STABLE_MS 30000	// running that long clears failures
+#define SUPERVISOR_LOOP_FAILURES 5	// that many failures
+#define SUPERVISOR_LOOP_WINDOW_MS 60000	// within that time is a crash loop
+
+enum supervisor_state {
+	SUPERVISOR_UP,
+	SUPERVISOR_DOWN,	// waiting for restart
+	SUPERVISOR_CRASH_LOOP,	// same, backed off to maximum delay
+};
+
+struct supervisor {
+	unsigned int failures;	// since last stable run
+	uint64_t started_ms;
+	uint64_t failure_ms[SUPERVISOR_LOOP_FAILURES];	// ring of recent failures
+	unsigned int failure_pos;
+	bool crash_loop;
+	uint32_t random;
+};
+
+void supervisor_init(struct supervisor *sv, uint32_t seed);
+void supervisor_started(struct supervisor *sv, uint64_t now_ms);
+/* clears failures if backend has been up for SUPERVISOR_STABLE_MS */
+void supervisor_running(struct supervisor *sv, uint64_t now_ms);
+/* records failure, returns delay before next start */
+uint64_t supervisor_failed(struct supervisor *sv, uint64_t now_ms);
+
+/* Keeps last STDERR_RING_SIZE bytes written by backend to stderr. Pipe has
+ * to be drained anyway, or a chatty child blocks on write. */
+#define STDERR_RING_SIZE 2048	// must be power of 2
+
+struct stderr_ring {
+	uint64_t written;
+	char buf[STDERR_RING_SIZE];
+};
+
+void stderr_ring_append(struct stderr_ring *ring, const char *data, size_t len);
+/* copies last non-empty line (possibly truncated to its end) to out, returns its length */
+size_t stderr_ring_last_line(const struct stderr_ring *ring, char *out, size_t size);
+
+#endif
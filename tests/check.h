@@ -0,0 +1,56 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+#include <string.h>
+
+/* Minimal checks for test programs: a failed check is printed and counted,
+ * and the test goes on, so one run shows every failure. main() ends with
+ * return check_report(); */
+
+static int check_failures;
+
+#define CHECK(cond) do { \
+	if(!(cond)) { \
+		fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+		check_failures++; \
+	} \
+} while(0)
+
+#define CHECK_INT(a, b) do { \
+	const long long check_a = (long long)(a), check_b = (long long)(b); \
+	if(check_a != check_b) { \
+		fprintf(stderr, "%s:%d: %s == %lld, expected %s == %lld\n", \
+				__FILE__, __LINE__, #a, check_a, #b, check_b); \
+		check_failures++; \
+	} \
+} while(0)
+
+#define CHECK_FLOAT(a, b, eps) do { \
+	const double check_a = (double)(a), check_b = (double)(b); \
+	if(check_a < check_b - (eps) || check_a > check_b + (eps)) { \
+		fprintf(stderr, "%s:%d: %s == %g, expected %g\n", \
+				__FILE__, __LINE__, #a, check_a, check_b); \
+		check_failures++; \
+	} \
+} while(0)
+
+#define CHECK_STR(a, b) do { \
+	const char *check_a = (a), *check_b = (b); \
+	if(strcmp(check_a, check_b)) { \
+		fprintf(stderr, "%s:%d: %s == \"%s\", expected \"%s\"\n", \
+				__FILE__, __LINE__, #a, check_a, check_b); \
+		check_failures++; \
+	} \
+} while(0)
+
+static inline int check_report(const char *name) {
+	if(check_failures) {
+		fprintf(stderr, "%s: %d checks failed\n", name, check_failures);
+		return 1;
+	}
+	printf("%s: ok\n", name);
+	return 0;
+}
+
+#endif
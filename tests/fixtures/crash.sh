@@ -0,0 +1,7 @@
+#!/bin/sh
+# radeontop that exits after a few samples with an error on stderr
+echo "Dumping to -, until termination."
+echo "1700000000.1: bus 03, gpu 10.00%, sclk 20.00% 0.500ghz"
+echo "1700000000.2: bus 03, gpu 12.00%, sclk 20.00% 0.500ghz"
+echo "Failed to open DRM node, no VRAM support." >&2
+exit 1
@@ -0,0 +1,6 @@
+#!/bin/sh
+# radeontop that stops printing without exiting and ignores SIGTERM
+trap '' TERM
+echo "Dumping to -, until termination."
+echo "1700000000.1: bus 03, gpu 10.00%, sclk 20.00% 0.500ghz"
+exec sleep 600
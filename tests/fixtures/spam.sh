@@ -0,0 +1,11 @@
+#!/bin/sh
+# radeontop that floods stderr while printing samples; its stderr pipe is
+# full in a moment unless someone drains it
+echo "Dumping to -, until termination."
+i=0
+while [ $i -lt 200 ]; do
+	printf 'warning %d: %0900d\n' $i 0 >&2
+	echo "1700000000.$i: bus 03, gpu 10.00%, sclk 20.00% 0.500ghz"
+	i=$((i + 1))
+done
+echo "done spamming" >&2
@@ -0,0 +1,129 @@
+/* Burst capture: samples beyond BURST_MAX_SAMPLES are counted as overflow,
+ * values are rounded and clamped into their fixed point fields, memory
+ * past 64 GiB included, and burst_write output reads back as header and
+ * records. */
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include "check.h"
+#include "burst.h"
+
+#define T0 1700000000000000ull
+
+static struct burst b, back;
+
+/* sample i, 1 ms apart */
+static void make_stats(unsigned int i, struct gpu_stats *s) {
+	*s = (struct gpu_stats){
+		.sample_time_us = T0 + i * 1000ull,
+		.latency_us = (int32_t)i,
+		.bus = 3,
+		.vram_mb = 1000.0f + (float)i,
+		.gtt_mb = 50.0f,
+		.sclk_ghz = 1.8f,
+		.mclk_ghz = 0.875f,
+		.valid = ~0u,
+	};
+	for(int k = 0; k < GPU_BLOCK_COUNT; ++k) {
+		s->busy[k] = (float)((i + (unsigned int)k) % 101);
+	}
+}
+
+static void check_overflow(void) {
+	burst_reset(&b);
+	struct gpu_stats s;
+	for(unsigned int i = 0; i < BURST_MAX_SAMPLES + 5; ++i) {
+		make_stats(i, &s);
+		burst_add(&b, &s);
+	}
+	CHECK_INT(b.header.magic, BURST_MAGIC);
+	CHECK_INT(b.header.version, BURST_VERSION);
+	CHECK_INT(b.header.record_size, sizeof(struct burst_record));
+	CHECK_INT(b.header.count, BURST_MAX_SAMPLES);
+	CHECK_INT(b.header.overflow, 5);
+	CHECK_INT(b.header.start_us, T0);
+	CHECK_INT(b.header.bus, 3);
+	const struct burst_record *last = &b.records[BURST_MAX_SAMPLES - 1];
+	CHECK_INT(last->offset_us, (BURST_MAX_SAMPLES - 1) * 1000);
+	CHECK_INT(last->latency_us, BURST_MAX_SAMPLES - 1);
+	CHECK_INT(last->vram_mb, 1000 + BURST_MAX_SAMPLES - 1);
+	// only fields up to sclk are kept
+	CHECK_INT(last->valid, GPU_FIELD_BIT(GPU_FIELD_SCLK + 1) - 1);
+
+	// starts over
+	burst_reset(&b);
+	CHECK_INT(b.header.count, 0);
+	CHECK_INT(b.header.overflow, 0);
+	make_stats(7, &s);
+	burst_add(&b, &s);
+	CHECK_INT(b.header.start_us, T0 + 7000);
+	CHECK_INT(b.records[0].offset_us, 0);
+}
+
+static void check_fixed(void) {
+	struct gpu_stats s;
+	make_stats(0, &s);
+	s.busy[GPU_BLOCK_GPU] = 12.34f;
+	s.busy[GPU_BLOCK_EE] = 12.346f;	// rounded up
+	s.busy[GPU_BLOCK_VGT] = -3.0f;
+	s.busy[GPU_BLOCK_TA] = 100.0f;
+	s.busy[GPU_BLOCK_SX] = 655.35f;	// largest that fits
+	s.busy[GPU_BLOCK_SH] = 1000.0f;
+	s.busy[GPU_BLOCK_SPI] = NAN;
+	s.busy[GPU_BLOCK_SC] = INFINITY;
+	s.vram_mb = 200000.0f;	// 195 GiB
+	s.gtt_mb = -1.0f;
+	s.sclk_ghz = 70.0f;
+	s.mclk_ghz = 0.0004f;
+	burst_reset(&b);
+	burst_add(&b, &s);
+
+	const struct burst_record *r = &b.records[0];
+	CHECK_INT(r->busy[GPU_BLOCK_GPU], 1234);
+	CHECK_INT(r->busy[GPU_BLOCK_EE], 1235);
+	CHECK_INT(r->busy[GPU_BLOCK_VGT], 0);
+	CHECK_INT(r->busy[GPU_BLOCK_TA], 10000);
+	CHECK_INT(r->busy[GPU_BLOCK_SX], 65535);
+	CHECK_INT(r->busy[GPU_BLOCK_SH], 65535);
+	CHECK_INT(r->busy[GPU_BLOCK_SPI], 0);
+	CHECK_INT(r->busy[GPU_BLOCK_SC], 65535);
+	CHECK_INT(r->vram_mb, 200000);
+	CHECK_INT(r->gtt_mb, 0);
+	CHECK_INT(r->sclk_mhz, 65535);
+	CHECK_INT(r->mclk_mhz, 0);
+}
+
+static void check_write(void) {
+	char path[] = "/tmp/test_burst.XXXXXX";
+	const int fd = mkstemp(path);
+	CHECK(fd >= 0);
+	close(fd);
+
+	burst_reset(&b);
+	struct gpu_stats s;
+	for(unsigned int i = 0; i < 100; ++i) {
+		make_stats(i, &s);
+		burst_add(&b, &s);
+	}
+	CHECK_INT(burst_write(&b, path), 0);
+
+	FILE *f = fopen(path, "rb");
+	CHECK(f != NULL);
+	if(f) {
+		CHECK_INT(fread(&back.header, sizeof(back.header), 1, f), 1);
+		CHECK(!memcmp(&back.header, &b.header, sizeof(b.header)));
+		CHECK_INT(fread(back.records, sizeof(back.records[0]), BURST_MAX_SAMPLES, f), 100);
+		CHECK(!memcmp(back.records, b.records, 100 * sizeof(b.records[0])));
+		fclose(f);
+	}
+	unlink(path);
+
+	CHECK_INT(burst_write(&b, "/nonexistent/dir/burst"), -1);
+}
+
+int main(void) {
+	check_overflow();
+	check_fixed();
+	check_write();
+	return check_report("burst");
+}
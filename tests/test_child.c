@@ -0,0 +1,188 @@
+/* Stop latency of a reader polling radeontop stdout, stderr, pidfd and a
+ * stop eventfd, as the sampler loop does, with a child that streams, one
+ * that stalls, one that is paused and one that exits. A paused child
+ * writes nothing and resumes within a tick. */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "check.h"
+#include "radeontop_child.h"
+#include "line_reader.h"
+#include "radeontop_parse.h"
+
+#define STOP_MAX_MS 200
+#define EXIT_MAX_MS 200
+
+struct reader {
+	struct radeontop_child child;
+	struct line_reader lines;
+	struct stderr_ring stderr_ring;
+	int wake_fd;
+	atomic_uint samples;
+	atomic_bool exited;	// child went away before stop
+	atomic_ullong last_sample_ms;
+	uint64_t exit_seen_ms;
+};
+
+static uint64_t monotonic_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void sleep_ms(unsigned int ms) {
+	struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000 };
+	while(nanosleep(&ts, &ts) != 0 && errno == EINTR);
+}
+
+static void *reader_thread(void *arg) {
+	struct reader *r = arg;
+	while(1) {
+		struct pollfd fds[] = {
+			{ .fd = r->wake_fd, .events = POLLIN },
+			{ .fd = r->child.out_fd, .events = POLLIN },
+			{ .fd = r->child.err_fd, .events = POLLIN },
+			{ .fd = r->child.pidfd, .events = POLLIN },
+		};
+		if(poll(fds, 4, -1) < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		if(fds[0].revents) {
+			break;
+		}
+		if(fds[2].revents && r->child.err_fd >= 0) {
+			radeontop_child_drain_stderr(&r->child, &r->stderr_ring);
+		}
+		if(fds[1].revents || fds[3].revents) {
+			ssize_t n;
+			while((n = line_reader_fill(&r->lines, r->child.out_fd)) > 0) {
+				const char *line;
+				size_t len;
+				struct gpu_stats stats;
+				while(line_reader_next(&r->lines, &line, &len)) {
+					if(radeontop_parse_line(line, len, &stats)) {
+						atomic_fetch_add(&r->samples, 1);
+						atomic_store(&r->last_sample_ms, monotonic_ms());
+					}
+				}
+			}
+			if(n == 0 || fds[3].revents) {
+				r->exit_seen_ms = monotonic_ms();
+				atomic_store(&r->exited, true);
+				break;
+			}
+		}
+	}
+	radeontop_child_stop(&r->child);
+	return NULL;
+}
+
+static void start(struct reader *r, pthread_t *thread, const char *const *cmdline) {
+	memset(r, 0, sizeof(*r));
+	line_reader_init(&r->lines);
+	r->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	CHECK(r->wake_fd >= 0);
+	CHECK_INT(radeontop_child_spawn(&r->child, cmdline), 0);
+	CHECK(r->child.out_fd >= 0);
+	CHECK(r->child.err_fd >= 0);
+	pthread_create(thread, NULL, reader_thread, r);
+}
+
+static void wait_samples(struct reader *r, unsigned int n) {
+	const uint64_t deadline = monotonic_ms() + 5000;
+	while(atomic_load(&r->samples) < n && monotonic_ms() < deadline) {
+		sleep_ms(5);
+	}
+	CHECK(atomic_load(&r->samples) >= n);
+}
+
+/* returns ms from stop request to reader thread and child being gone */
+static uint64_t stop(struct reader *r, pthread_t thread) {
+	const uint64_t start_ms = monotonic_ms();
+	const uint64_t one = 1;
+	CHECK(write(r->wake_fd, &one, sizeof(one)) == sizeof(one));
+	pthread_join(thread, NULL);
+	const uint64_t elapsed = monotonic_ms() - start_ms;
+	close(r->wake_fd);
+	CHECK_INT(r->child.out_fd, -1);
+	CHECK_INT(r->child.pidfd, -1);
+	return elapsed;
+}
+
+int main(void) {
+	struct reader r;
+	pthread_t thread;
+
+	// streaming child
+	start(&r, &thread, (const char *[]){ "./fake-radeontop", "-r", "200", NULL });
+	wait_samples(&r, 20);
+	uint64_t ms = stop(&r, thread);
+	printf("stop, streaming: %llu ms\n", (unsigned long long)ms);
+	CHECK(ms < STOP_MAX_MS);
+	CHECK(!atomic_load(&r.exited));
+
+	// child stalled without closing stdout, as a hung radeontop
+	start(&r, &thread, (const char *[]){ "./fake-radeontop", "-r", "50", "-s", "600000", "-S", "1", NULL });
+	wait_samples(&r, 10);
+	while(monotonic_ms() - atomic_load(&r.last_sample_ms) < 300) {
+		sleep_ms(50);
+	}
+	const unsigned int stalled_at = atomic_load(&r.samples);
+	sleep_ms(100);
+	CHECK_INT(atomic_load(&r.samples), stalled_at);
+	ms = stop(&r, thread);
+	printf("stop, stalled: %llu ms\n", (unsigned long long)ms);
+	CHECK(ms < STOP_MAX_MS);
+
+	// paused child, as radeontop of a chart that can't be seen
+	start(&r, &thread, (const char *[]){ "./fake-radeontop", "-r", "200", NULL });
+	wait_samples(&r, 5);
+	radeontop_child_pause(&r.child, true);
+	sleep_ms(50);	// lines already in pipe
+	const unsigned int paused_at = atomic_load(&r.samples);
+	sleep_ms(300);
+	CHECK_INT(atomic_load(&r.samples), paused_at);
+	const uint64_t resume_ms = monotonic_ms();
+	radeontop_child_pause(&r.child, false);
+	wait_samples(&r, paused_at + 1);
+	// 5 ms tick, with room for a loaded machine
+	printf("resume: %llu ms\n", (unsigned long long)(atomic_load(&r.last_sample_ms) - resume_ms));
+	CHECK(atomic_load(&r.last_sample_ms) - resume_ms < 100);
+	radeontop_child_pause(&r.child, true);
+	sleep_ms(50);
+	ms = stop(&r, thread);
+	printf("stop, paused: %llu ms\n", (unsigned long long)ms);
+	CHECK(ms < STOP_MAX_MS);
+
+	// child exit is noticed by itself, without a stop request
+	start(&r, &thread, (const char *[]){ "./fake-radeontop", "-r", "1000", "-n", "20", NULL });
+	const uint64_t start_ms = monotonic_ms();
+	const uint64_t deadline = start_ms + 5000;
+	while(!atomic_load(&r.exited) && monotonic_ms() < deadline) {
+		sleep_ms(5);
+	}
+	CHECK(atomic_load(&r.exited));
+	CHECK_INT(atomic_load(&r.samples), 20);
+	// 20 lines at 1 kHz take 20 ms
+	CHECK(r.exit_seen_ms - atomic_load(&r.last_sample_ms) < EXIT_MAX_MS);
+	stop(&r, thread);
+
+	// a command that doesn't exist either fails to spawn or exits at once
+	struct radeontop_child missing;
+	if(radeontop_child_spawn(&missing, (const char *[]){ "./tests/no-such-radeontop", NULL }) == 0) {
+		struct pollfd pfd = { .fd = missing.out_fd, .events = POLLIN };
+		CHECK_INT(poll(&pfd, 1, 1000), 1);
+		radeontop_child_stop(&missing);
+	}
+
+	return check_report("child");
+}
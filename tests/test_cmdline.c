@@ -0,0 +1,28 @@
+#include "check.h"
+#include "cmdline.h"
+
+static void split(const char *in, size_t max, const char *const *expected) {
+	char buf[256];
+	const char *out[16];
+	cmdline_split(out, max, buf, in);
+	size_t i = 0;
+	for(; expected[i]; ++i) {
+		CHECK(out[i] != NULL);
+		if(out[i]) {
+			CHECK_STR(out[i], expected[i]);
+		}
+	}
+	CHECK(out[i] == NULL);
+}
+
+int main(void) {
+	split("/usr/bin/radeontop -d - -t 1", 16,
+			(const char *[]){ "/usr/bin/radeontop", "-d", "-", "-t", "1", NULL });
+	split("  radeontop \t -b  03\n", 16, (const char *[]){ "radeontop", "-b", "03", NULL });
+	split("", 16, (const char *[]){ NULL });
+	split("   ", 16, (const char *[]){ NULL });
+	// what doesn't fit is cut, list stays NULL-terminated
+	split("a b c d e", 3, (const char *[]){ "a", "b", NULL });
+	split("a b", 3, (const char *[]){ "a", "b", NULL });
+	return check_report("cmdline");
+}
@@ -0,0 +1,178 @@
+/* Exporter response stays within its buffer and ends with "# EOF" when
+ * metrics don't fit, is served whole over a socket, and bad TCP ports are
+ * refused. A response larger than socket buffer is finished as socket drains.
+ * A stale socket is replaced, any other file is left alone. */
+#define _GNU_SOURCE	// memrchr
+#include <stdlib.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "check.h"
+#include "exporter.h"
+
+#define MANY_GPUS 200
+
+static struct exporter e;
+static struct gpu_stats stats[MANY_GPUS];
+static struct exporter_gpu gpus[MANY_GPUS];
+
+/* every line of body is whole, body ends with "# EOF\n" */
+static void check_body(void) {
+	CHECK(e.body_len < sizeof(e.body));
+	CHECK(e.body_len >= 6);
+	CHECK(memcmp(e.body + e.body_len - 6, "# EOF\n", 6) == 0);
+	size_t eofs = 0;
+	for(const char *p = e.body, *end = e.body + e.body_len; p < end; ) {
+		const char *nl = memchr(p, '\n', (size_t)(end - p));
+		CHECK(nl != NULL);
+		if(!nl) {
+			break;
+		}
+		// a line cut short would miss its value after the last space
+		const char *sp = memrchr(p, ' ', (size_t)(nl - p));
+		CHECK(sp && sp + 1 < nl);
+		eofs += nl - p == 5 && !memcmp(p, "# EOF", 5);
+		p = nl + 1;
+	}
+	CHECK_INT(eofs, 1);
+}
+
+/* scrapes with a socket buffer far smaller than response if slow is set;
+ * returns true if exporter had to wait for socket to finish response */
+static bool scrape(const char *path, bool slow) {
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	strcpy(addr.sun_path, path);
+	CHECK(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+	const char req[] = "GET /metrics HTTP/1.0\r\n\r\n";
+	CHECK(send(fd, req, sizeof(req) - 1, 0) == (ssize_t)sizeof(req) - 1);
+
+	// accept, then read request, respond and finish response
+	static char resp[EXPORTER_BUF_SIZE + 1024], want[EXPORTER_BUF_SIZE];
+	const size_t want_len = e.body_len;
+	memcpy(want, e.body, want_len);
+	size_t len = 0;
+	bool waited = false;
+	for(int round = 0; round < 1000; ++round) {
+		struct pollfd fds[1 + EXPORTER_MAX_CLIENTS];
+		const int n = exporter_pollfds(&e, fds);
+		CHECK(poll(fds, (nfds_t)n, 1000) > 0);
+		exporter_handle(&e, fds, n);
+		if(round == 0 && slow) {
+			const int size = 4096;
+			CHECK(setsockopt(e.clients[0].fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) == 0);
+		} else if(round == 1 && slow) {
+			// next sample while response is on its way
+			exporter_render(&e, gpus, 1, 2000000);
+		}
+		waited |= e.clients[0].out != NULL;
+
+		ssize_t r = 0;
+		while(round > 0 && (r = recv(fd, resp + len, sizeof(resp) - len, MSG_DONTWAIT)) > 0) {
+			len += (size_t)r;
+		}
+		if(r == 0 && round > 0) {
+			break;
+		}
+	}
+	close(fd);
+
+	const char *body = strstr(resp, "\r\n\r\n");
+	CHECK(body != NULL);
+	if(body) {
+		body += 4;
+		const char *cl = strstr(resp, "Content-Length: ");
+		CHECK(cl != NULL);
+		CHECK_INT(cl ? strtoul(cl + 16, NULL, 10) : 0, want_len);
+		CHECK_INT(resp + len - body, want_len);
+		CHECK(memcmp(body, want, want_len) == 0);
+	}
+	return waited;
+}
+
+int main(void) {
+	for(int i = 0; i < MANY_GPUS; ++i) {
+		stats[i] = (struct gpu_stats){
+			.valid = ~0u,
+			.vram_mb = 468.35f, .gtt_mb = 38.53f,
+			.sclk_ghz = 0.35f, .mclk_ghz = 1.75f,
+			.power_w = 42.5f, .fan_rpm = 1200,
+			.throttle = GPU_THROTTLE_CLOCK,
+		};
+		for(int b = 0; b < GPU_BLOCK_COUNT; ++b) {
+			stats[i].busy[b] = 12.5f;
+		}
+		gpus[i] = (struct exporter_gpu){ .id = i, .stats = &stats[i], .samples = 1234567 };
+	}
+
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/test_exporter.%d", (int)getpid());
+	char address[80];
+	snprintf(address, sizeof(address), "unix:%s", path);
+	CHECK_INT(exporter_open(&e, address), 0);
+
+	// fits
+	exporter_render(&e, gpus, 2, 1000000);
+	check_body();
+	CHECK(!e.truncated);
+	CHECK(strstr(e.body, "gkrellmradeontop_busy_ratio{gpu=\"1\",block=\"cb\"} 0.1250\n") != NULL);
+	CHECK(!scrape(path, false));
+
+	// doesn't fit: lines are left out whole, EOF is still there
+	exporter_render(&e, gpus, MANY_GPUS, 1000000);
+	check_body();
+	CHECK(e.truncated);
+	CHECK(e.body_len > sizeof(e.body) - 200);
+	scrape(path, false);
+
+	// response is finished as socket takes it, even if rendered again meanwhile
+	CHECK(scrape(path, true));
+	CHECK_INT(e.cut_responses, 0);
+
+	// and back
+	exporter_render(&e, gpus, 1, 1000000);
+	check_body();
+	scrape(path, false);
+	exporter_close(&e);
+	CHECK(access(path, F_OK) != 0);
+
+	static const char *const bad[] = {
+		"tcp:", "tcp:abc", "tcp:0", "tcp:-1", "tcp:65536", "tcp:9100x",
+		"tcp:99999999999999999999",
+	};
+	for(size_t i = 0; i < sizeof(bad)/sizeof(bad[0]); ++i) {
+		CHECK_INT(exporter_open(&e, bad[i]), -1);
+		CHECK_INT(e.listen_fd, -1);
+	}
+
+	// socket left behind by a crash is replaced
+	const int stale = socket(AF_UNIX, SOCK_STREAM, 0);
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	strcpy(addr.sun_path, path);
+	CHECK(bind(stale, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+	close(stale);
+	CHECK_INT(exporter_open(&e, address), 0);
+	exporter_close(&e);
+
+	// regular file at socket path is kept
+	FILE *f = fopen(path, "w");
+	CHECK(f != NULL);
+	if(f) {
+		fputs("precious\n", f);
+		fclose(f);
+	}
+	CHECK_INT(exporter_open(&e, address), -1);
+	CHECK_INT(e.listen_fd, -1);
+	char kept[16] = "";
+	f = fopen(path, "r");
+	CHECK(f != NULL);
+	if(f) {
+		CHECK(fgets(kept, sizeof(kept), f) != NULL);
+		fclose(f);
+	}
+	CHECK_STR(kept, "precious\n");
+	unlink(path);
+
+	return check_report("exporter");
+}
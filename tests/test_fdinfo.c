@@ -0,0 +1,235 @@
+/* DRM fdinfo scanner against a scratch <root>/<pid>/{comm,fd,fdinfo} tree:
+ * engine time deltas as busy ratios, a dup()ed client counted once, per GPU
+ * filtering, processes and fds appearing and going away, and the listing
+ * budget going round robin so that processes with high pids get listed. */
+#define _XOPEN_SOURCE 700	// nftw()
+#include <stdlib.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include "check.h"
+#include "fdinfo.h"
+
+#define PDEV_A "0000:03:00.0"
+#define PDEV_B "0000:0a:00.0"
+#define SECOND_NS 1000000000ull
+
+static char scratch[] = "/tmp/test_fdinfo.XXXXXX";
+static struct fdinfo_scanner scanner;
+
+static void add_proc(int pid, const char *comm) {
+	char path[256];
+	snprintf(path, sizeof(path), "%s/%d", scratch, pid);
+	CHECK(mkdir(path, 0755) == 0);
+	snprintf(path, sizeof(path), "%s/%d/fd", scratch, pid);
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/%d/fdinfo", scratch, pid);
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/%d/comm", scratch, pid);
+	FILE *f = fopen(path, "w");
+	CHECK(f != NULL);
+	if(f) {
+		fprintf(f, "%s\n", comm);
+		fclose(f);
+	}
+}
+
+/* (re)writes fdinfo of an amdgpu client */
+static void set_fdinfo(int pid, int fd, const char *pdev, unsigned int client_id,
+		unsigned long long gfx_ns, unsigned long long compute_ns, unsigned int vram_kib) {
+	char path[256];
+	snprintf(path, sizeof(path), "%s/%d/fdinfo/%d", scratch, pid, fd);
+	FILE *f = fopen(path, "w");
+	CHECK(f != NULL);
+	if(f) {
+		fprintf(f, "pos:\t0\nflags:\t02100002\ndrm-driver:\tamdgpu\ndrm-pdev:\t%s\n"
+				"drm-client-id:\t%u\ndrm-engine-gfx:\t%llu ns\ndrm-engine-compute:\t%llu ns\n"
+				"drm-memory-vram:\t%u KiB\ndrm-memory-gtt:\t4 KiB\n",
+				pdev, client_id, gfx_ns, compute_ns, vram_kib);
+		fclose(f);
+	}
+}
+
+/* opens render node as fd; fdinfo is written by set_fdinfo() */
+static void add_fd(int pid, int fd) {
+	char path[256];
+	snprintf(path, sizeof(path), "%s/%d/fd/%d", scratch, pid, fd);
+	CHECK(symlink("/dev/dri/renderD128", path) == 0);
+}
+
+static void close_fd(int pid, int fd) {
+	char path[256];
+	snprintf(path, sizeof(path), "%s/%d/fd/%d", scratch, pid, fd);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/%d/fdinfo/%d", scratch, pid, fd);
+	unlink(path);
+}
+
+static int remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+	(void)st;
+	(void)type;
+	(void)ftw;
+	return remove(path);
+}
+
+static void remove_tree(const char *path) {
+	nftw(path, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+static void remove_proc(int pid) {
+	char path[256];
+	snprintf(path, sizeof(path), "%s/%d", scratch, pid);
+	remove_tree(path);
+}
+
+static const struct fdinfo_client *find_client(const struct fdinfo_client *c, size_t n, int pid) {
+	for(size_t i = 0; i < n; ++i) {
+		if(c[i].pid == pid) {
+			return &c[i];
+		}
+	}
+	return NULL;
+}
+
+static void check_clients(void) {
+	struct fdinfo_client top[8];
+	const struct fdinfo_client *c;
+	size_t n;
+
+	add_proc(100, "game");
+	add_fd(100, 5);
+	set_fdinfo(100, 5, PDEV_A, 1, 0, 0, 1024);
+	// a non-DRM fd isn't read, even with amdgpu fdinfo
+	add_proc(200, "shell");
+	char path[256];
+	snprintf(path, sizeof(path), "%s/200/fd/3", scratch);
+	CHECK(symlink("/dev/null", path) == 0);
+	set_fdinfo(200, 3, PDEV_A, 9, 0, 0, 1024);
+	add_proc(300, "compute");
+	add_fd(300, 7);
+	set_fdinfo(300, 7, PDEV_B, 2, 0, 0, 2048);
+
+	fdinfo_init(&scanner, scratch);
+	fdinfo_scan(&scanner, 1 * SECOND_NS);
+	n = fdinfo_top(&scanner, "", top, 8);
+	CHECK_INT(n, 2);
+	c = find_client(top, n, 100);
+	CHECK(c != NULL);
+	if(c) {
+		// nothing to take a delta from yet
+		CHECK_STR(c->comm, "game");
+		CHECK_FLOAT(c->gfx, 0, 0);
+		CHECK_INT(c->vram_bytes, 1024 * 1024);
+		CHECK_INT(c->gtt_bytes, 4096);
+	}
+	CHECK(find_client(top, n, 200) == NULL);
+
+	// engine time over a second, and a dup() of the same client
+	set_fdinfo(100, 5, PDEV_A, 1, SECOND_NS / 2, SECOND_NS / 4, 1024);
+	set_fdinfo(300, 7, PDEV_B, 2, 0, SECOND_NS / 10, 2048);
+	add_fd(100, 6);
+	set_fdinfo(100, 6, PDEV_A, 1, SECOND_NS / 2, SECOND_NS / 4, 1024);
+	// listed again at scan 2, as a new process is
+	fdinfo_scan(&scanner, 2 * SECOND_NS);
+	n = fdinfo_top(&scanner, "", top, 8);
+	CHECK_INT(n, 2);
+	CHECK_INT(top[0].pid, 100);
+	CHECK_FLOAT(top[0].gfx, 0.5, 1e-4);
+	CHECK_FLOAT(top[0].compute, 0.25, 1e-4);
+	CHECK_INT(top[0].vram_bytes, 1024 * 1024);
+	CHECK_INT(top[1].pid, 300);
+	CHECK_FLOAT(top[1].compute, 0.1, 1e-4);
+
+	// per GPU
+	n = fdinfo_top(&scanner, PDEV_A, top, 8);
+	CHECK_INT(n, 1);
+	CHECK_INT(top[0].pid, 100);
+	n = fdinfo_top(&scanner, PDEV_B, top, 8);
+	CHECK_INT(n, 1);
+	CHECK_INT(top[0].pid, 300);
+	CHECK_INT(fdinfo_top(&scanner, "0000:ff:00.0", top, 8), 0);
+	CHECK_INT(fdinfo_top(&scanner, "", top, 1), 1);
+
+	// new process is listed on next scan
+	add_proc(400, "encoder");
+	add_fd(400, 4);
+	set_fdinfo(400, 4, PDEV_A, 3, 0, 0, 512);
+	fdinfo_scan(&scanner, 3 * SECOND_NS);
+	n = fdinfo_top(&scanner, "", top, 8);
+	CHECK_INT(n, 3);
+	c = find_client(top, n, 400);
+	CHECK(c != NULL);
+	if(c) {
+		CHECK_STR(c->comm, "encoder");
+	}
+	// no engine time since last scan
+	c = find_client(top, n, 100);
+	CHECK(c != NULL);
+	if(c) {
+		CHECK_FLOAT(c->gfx, 0, 0);
+	}
+
+	// exited process and closed fds are gone on next scan
+	remove_proc(300);
+	close_fd(400, 4);
+	close_fd(100, 5);
+	fdinfo_scan(&scanner, 4 * SECOND_NS);
+	n = fdinfo_top(&scanner, "", top, 8);
+	CHECK_INT(n, 1);
+	CHECK_INT(top[0].pid, 100);
+	CHECK_INT(top[0].vram_bytes, 1024 * 1024);
+	CHECK_INT(fdinfo_top(&scanner, PDEV_B, top, 8), 0);
+	// also when closed between listings of its process
+	close_fd(100, 6);
+	fdinfo_scan(&scanner, 5 * SECOND_NS);
+	CHECK_INT(fdinfo_top(&scanner, "", top, 8), 0);
+
+	remove_proc(100);
+	remove_proc(200);
+	remove_proc(400);
+}
+
+/* three listing budgets of processes, with GPU clients at lowest and
+ * highest pid */
+static void check_budget(void) {
+	const int procs = 3 * FDINFO_LIST_BUDGET, first = 1000, last = first + procs - 1;
+	for(int pid = first; pid <= last; ++pid) {
+		add_proc(pid, "idle");
+	}
+	add_fd(first, 5);
+	set_fdinfo(first, 5, PDEV_A, 1, 0, 0, 1024);
+	add_fd(last, 5);
+	set_fdinfo(last, 5, PDEV_A, 2, 0, 0, 1024);
+
+	struct fdinfo_client top[8];
+	fdinfo_init(&scanner, scratch);
+	fdinfo_scan(&scanner, SECOND_NS);
+	CHECK_INT(fdinfo_top(&scanner, "", top, 8), 1);
+	CHECK_INT(top[0].pid, first);
+	// processes listed once get listed again next scan, but after the rest
+	fdinfo_scan(&scanner, 2 * SECOND_NS);
+	CHECK_INT(fdinfo_top(&scanner, "", top, 8), 1);
+	fdinfo_scan(&scanner, 3 * SECOND_NS);
+	CHECK_INT(fdinfo_top(&scanner, "", top, 8), 2);
+
+	// a process that opens GPU after its first listings is still found,
+	// listing interval and its per pid offset later
+	const int late = first + procs / 2;
+	add_fd(late, 9);
+	set_fdinfo(late, 9, PDEV_A, 3, 0, 0, 1024);
+	uint32_t scans = 0;
+	while(fdinfo_top(&scanner, "", top, 8) < 3 && scans < 4 * FDINFO_RESCAN_SCANS) {
+		fdinfo_scan(&scanner, (4 + scans++) * SECOND_NS);
+	}
+	CHECK_INT(fdinfo_top(&scanner, "", top, 8), 3);
+	CHECK(scans < 2 * FDINFO_RESCAN_SCANS);
+	printf("fdinfo: GPU opened late found after %u scans\n", scans);
+}
+
+int main(void) {
+	CHECK(mkdtemp(scratch) != NULL);
+	check_clients();
+	check_budget();
+	remove_tree(scratch);
+	return check_report("fdinfo");
+}
@@ -0,0 +1,137 @@
+/* GRBM sampling driven by a scripted register source: busy bits counted
+ * into percentages, failed reads left out, counts restarted by each
+ * sample. Then the synthetic "mock" device, run the way the sampler does. */
+#include <stdlib.h>
+#include "check.h"
+#include "gpu_grbm.h"
+
+#define GUI_ACTIVE (1u << 31)
+#define CB_BUSY (1u << 30)
+#define TA_BUSY (1u << 14)
+
+struct script {
+	const uint32_t *values;	// UINT32_MAX fails the read
+	size_t n, next;
+	uint32_t bad_reg;	// register read other than GRBM_STATUS
+	bool sensors, closed;
+};
+
+static int script_read_reg(void *ctx, uint32_t reg, uint32_t *value) {
+	struct script *s = ctx;
+	if(reg != GRBM_STATUS) {
+		s->bad_reg = reg;
+	}
+	const uint32_t v = s->values[s->next++ % s->n];
+	if(v == UINT32_MAX) {
+		return -1;
+	}
+	*value = v;
+	return 0;
+}
+
+static void script_read_sensors(void *ctx, struct gpu_stats *out) {
+	struct script *s = ctx;
+	s->sensors = true;
+	out->sclk = 42;
+	out->valid |= GPU_FIELD_BIT(GPU_FIELD_SCLK);
+}
+
+static void script_close(void *ctx) {
+	struct script *s = ctx;
+	s->closed = true;
+}
+
+static void check_script(void) {
+	static const uint32_t values[] = {
+		GUI_ACTIVE | CB_BUSY, GUI_ACTIVE | TA_BUSY, GUI_ACTIVE, 0,
+		UINT32_MAX, GUI_ACTIVE | CB_BUSY | TA_BUSY, 0, 0, 0,
+	};
+	struct script s = { .values = values, .n = sizeof(values)/sizeof(values[0]) };
+	const struct gpu_grbm_source src = {
+		.ctx = &s,
+		.read_reg = script_read_reg,
+		.read_sensors = script_read_sensors,
+		.close = script_close,
+	};
+	struct gpu_grbm grbm;
+	struct gpu_stats st;
+	gpu_grbm_init(&grbm, &src);
+
+	// nothing read yet
+	CHECK(!gpu_grbm_sample(&grbm, &st));
+	CHECK_INT(st.valid, 0);
+	CHECK(!s.sensors);
+
+	for(int i = 0; i < 4; ++i) {
+		CHECK(gpu_grbm_tick(&grbm));
+	}
+	CHECK(gpu_grbm_sample(&grbm, &st));
+	CHECK_FLOAT(st.busy[GPU_BLOCK_GPU], 75, 1e-4);
+	CHECK_FLOAT(st.busy[GPU_BLOCK_CB], 25, 1e-4);
+	CHECK_FLOAT(st.busy[GPU_BLOCK_TA], 25, 1e-4);
+	CHECK_FLOAT(st.busy[GPU_BLOCK_EE], 0, 0);
+	CHECK(s.sensors);
+	CHECK_FLOAT(st.sclk, 42, 0);
+	CHECK_INT(st.valid, (GPU_FIELD_BIT(GPU_BLOCK_COUNT) - 1) |
+			GPU_FIELD_BIT(GPU_FIELD_TIMESTAMP) | GPU_FIELD_BIT(GPU_FIELD_SCLK));
+	CHECK(st.sample_time_us > 0);
+
+	// failed read isn't counted, counts start over after sample
+	CHECK(!gpu_grbm_tick(&grbm));
+	for(int i = 0; i < 4; ++i) {
+		CHECK(gpu_grbm_tick(&grbm));
+	}
+	CHECK(gpu_grbm_sample(&grbm, &st));
+	CHECK_FLOAT(st.busy[GPU_BLOCK_GPU], 25, 1e-4);
+	CHECK_FLOAT(st.busy[GPU_BLOCK_CB], 25, 1e-4);
+	CHECK_FLOAT(st.busy[GPU_BLOCK_TA], 25, 1e-4);
+	CHECK(!gpu_grbm_sample(&grbm, &st));
+
+	CHECK_INT(s.bad_reg, 0);
+	gpu_grbm_close(&grbm);
+	CHECK(s.closed);
+
+	// source without sensors
+	const struct gpu_grbm_source bare = { .ctx = &s, .read_reg = script_read_reg };
+	gpu_grbm_init(&grbm, &bare);
+	s.next = 0;
+	s.sensors = false;
+	CHECK(gpu_grbm_tick(&grbm));
+	CHECK(gpu_grbm_sample(&grbm, &st));
+	CHECK_FLOAT(st.busy[GPU_BLOCK_GPU], 100, 0);
+	CHECK(!s.sensors);
+	CHECK(!(st.valid & GPU_FIELD_BIT(GPU_FIELD_SCLK)));
+	gpu_grbm_close(&grbm);
+}
+
+static void check_mock(void) {
+	struct gpu_grbm grbm;
+	struct gpu_stats st;
+	CHECK_INT(gpu_grbm_open(&grbm, GRBM_MOCK_DEVICE, "", ""), 0);
+
+	// a second of GRBM_DEFAULT_TICKS reads, some times over
+	for(int round = 0; round < 20; ++round) {
+		for(int i = 0; i < GRBM_DEFAULT_TICKS; ++i) {
+			CHECK(gpu_grbm_tick(&grbm));
+		}
+		CHECK(gpu_grbm_sample(&grbm, &st));
+		for(int b = 0; b < GPU_BLOCK_COUNT; ++b) {
+			CHECK(st.busy[b] >= 0 && st.busy[b] <= 100);
+			// a block is only busy when whole GPU is
+			CHECK(st.busy[b] <= st.busy[GPU_BLOCK_GPU]);
+		}
+		CHECK_FLOAT(st.busy[GPU_BLOCK_EE], 0, 0);
+		CHECK(st.valid & GPU_FIELD_BIT(GPU_FIELD_VRAM));
+		CHECK(st.valid & GPU_FIELD_BIT(GPU_FIELD_SCLK));
+		CHECK(st.sclk >= 20 && st.sclk <= 100);
+	}
+	gpu_grbm_close(&grbm);
+
+	CHECK_INT(gpu_grbm_open(&grbm, "/nonexistent/renderD128", "", ""), -1);
+}
+
+int main(void) {
+	check_script();
+	check_mock();
+	return check_report("grbm");
+}
@@ -0,0 +1,136 @@
+/* History file survives its writer being killed: a child appends records
+ * until SIGKILL, then every record read back must be whole and in order.
+ * Also torn and uncounted records, wraparound, since filter and reset of
+ * an incompatible file. */
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "check.h"
+#include "history.h"
+
+struct walk {
+	size_t n;
+	uint64_t first, last;
+	unsigned int out_of_order;
+	unsigned int bad;
+};
+
+static void visit(const struct history_record *rec, void *data) {
+	struct walk *w = data;
+	if(w->n == 0) {
+		w->first = rec->time_us;
+	} else if(rec->time_us != w->last + 1) {
+		w->out_of_order++;
+	}
+	// writer derives both values from time_us
+	if(rec->gpu_pipe != (float)(rec->time_us % 100) ||
+			rec->shader_clock != (float)(rec->time_us % 1000) / 10) {
+		w->bad++;
+	}
+	w->last = rec->time_us;
+	w->n++;
+}
+
+static void append(struct history *h, uint64_t t) {
+	history_append(h, t, (float)(t % 100), (float)(t % 1000) / 10);
+}
+
+static struct walk walk(const struct history *h, uint64_t since_us) {
+	struct walk w = {0};
+	CHECK_INT(history_foreach(h, since_us, visit, &w), w.n);
+	CHECK_INT(w.out_of_order, 0);
+	CHECK_INT(w.bad, 0);
+	return w;
+}
+
+int main(void) {
+	char path[] = "/tmp/test_history.XXXXXX";
+	int fd = mkstemp(path);
+	CHECK(fd >= 0);
+	close(fd);
+
+	// empty file is reset to an empty history
+	struct history h;
+	CHECK_INT(history_open(&h, path), 0);
+	CHECK_INT(walk(&h, 0).n, 0);
+	for(uint64_t t = 1; t <= 10; ++t) {
+		append(&h, t);
+	}
+	history_close(&h);
+
+	// reopened, then a record torn by a crash mid-write is ignored
+	CHECK_INT(history_open(&h, path), 0);
+	struct walk w = walk(&h, 0);
+	CHECK_INT(w.n, 10);
+	CHECK_INT(w.first, 1);
+	CHECK_INT(w.last, 10);
+	atomic_store(&h.records[10].seq_begin, 11);
+	h.records[10].time_us = 11;
+	CHECK_INT(walk(&h, 0).n, 10);
+	// complete record whose head update was lost is still found
+	h.records[10].gpu_pipe = 11;
+	h.records[10].shader_clock = 1.1f;
+	atomic_store(&h.records[10].seq_end, 11);
+	CHECK_INT(walk(&h, 0).n, 11);
+
+	// only records since given time
+	w = walk(&h, 5);
+	CHECK_INT(w.n, 7);
+	CHECK_INT(w.first, 5);
+	CHECK_INT(walk(&h, 100).n, 0);
+	history_close(&h);
+
+	// writer killed at a random point
+	for(int round = 0; round < 5; ++round) {
+		const pid_t pid = fork();
+		if(pid == 0) {
+			struct history child;
+			if(history_open(&child, path) != 0) {
+				_exit(1);
+			}
+			uint64_t t = atomic_load(&child.header->head);
+			while(1) {
+				append(&child, ++t);
+			}
+		}
+		CHECK(pid > 0);
+		usleep(20000 + (useconds_t)round * 7000);
+		CHECK(kill(pid, SIGKILL) == 0);
+		int status;
+		CHECK(waitpid(pid, &status, 0) == pid);
+		CHECK(WIFSIGNALED(status));
+
+		CHECK_INT(history_open(&h, path), 0);
+		const uint64_t head = atomic_load(&h.header->head);
+		w = walk(&h, 0);
+		CHECK(head > 11);
+		// a torn record at head + 1 may have taken the oldest one's slot
+		CHECK(w.n >= (head < HISTORY_CAPACITY ? head : HISTORY_CAPACITY - 1));
+		CHECK(w.n <= HISTORY_CAPACITY);
+		CHECK(w.last == head || w.last == head + 1);
+		history_close(&h);
+	}
+
+	// wraparound keeps last HISTORY_CAPACITY records
+	CHECK_INT(history_open(&h, path), 0);
+	const uint64_t head = atomic_load(&h.header->head);
+	for(uint64_t t = head + 1; t <= head + HISTORY_CAPACITY + 100; ++t) {
+		append(&h, t);
+	}
+	w = walk(&h, 0);
+	CHECK_INT(w.n, HISTORY_CAPACITY);
+	CHECK_INT(w.first, head + 101);
+	w = walk(&h, head + HISTORY_CAPACITY);
+	CHECK_INT(w.n, 101);
+	history_close(&h);
+
+	// a file of other size (e.g. other version) starts over
+	CHECK(truncate(path, 4096) == 0);
+	CHECK_INT(history_open(&h, path), 0);
+	CHECK_INT(walk(&h, 0).n, 0);
+	history_close(&h);
+
+	unlink(path);
+	return check_report("history");
+}
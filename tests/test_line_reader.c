@@ -0,0 +1,176 @@
+/* Line reader over a non-blocking pipe: lines split across reads, many
+ * lines per read, lines that move to buffer start, oversize lines dropped
+ * and counted, and CRLF lines as the parser takes them. */
+#define _GNU_SOURCE	// pipe2, F_SETPIPE_SZ
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "check.h"
+#include "line_reader.h"
+#include "radeontop_parse.h"
+
+static struct line_reader lr;
+static int fds[2];
+
+static void put(const char *s, size_t len) {
+	CHECK(write(fds[1], s, len) == (ssize_t)len);
+}
+
+static void puts_pipe(const char *s) {
+	put(s, strlen(s));
+}
+
+/* reads whatever is in pipe; returns next line, NULL if none is complete */
+static const char *next(size_t *len) {
+	static char copy[LINE_READER_SIZE];
+	const char *line;
+	while(!line_reader_next(&lr, &line, len)) {
+		if(line_reader_fill(&lr, fds[0]) <= 0) {
+			return NULL;
+		}
+	}
+	memcpy(copy, line, *len);
+	copy[*len] = '\0';
+	return copy;
+}
+
+static void expect(const char *line) {
+	size_t len;
+	const char *got = next(&len);
+	CHECK(got != NULL);
+	if(got) {
+		CHECK_STR(got, line);
+		CHECK_INT(len, strlen(line));
+	}
+}
+
+static void expect_none(void) {
+	size_t len;
+	CHECK(next(&len) == NULL);
+}
+
+static void check_partial(void) {
+	line_reader_init(&lr);
+	expect_none();
+
+	puts_pipe("1700000000.1: gpu 5");
+	expect_none();
+	puts_pipe("0.00%");
+	expect_none();
+	puts_pipe("\n1700000000.2: ");
+	expect("1700000000.1: gpu 50.00%");
+	expect_none();
+	puts_pipe("gpu 1.00%\n\n");
+	expect("1700000000.2: gpu 1.00%");
+	expect("");	// empty line is a line too
+	expect_none();
+	CHECK_INT(lr.dropped, 0);
+}
+
+/* 20000 numbered lines written at once: many per read, some across
+ * buffer wraps, none lost or torn */
+static void check_burst(void) {
+	line_reader_init(&lr);
+	char chunk[65536];
+	unsigned int written = 0, read_back = 0;
+	while(written < 20000) {
+		size_t len = 0;
+		while(written < 20000 && len + 32 < sizeof(chunk) / 2) {
+			len += (size_t)snprintf(chunk + len, sizeof(chunk) - len, "line %u%s\n",
+					written, written % 7 ? "" : " with some more text");
+			written++;
+		}
+		put(chunk, len);
+
+		size_t n;
+		const char *line;
+		while((line = next(&n))) {
+			char want[64];
+			snprintf(want, sizeof(want), "line %u%s", read_back,
+					read_back % 7 ? "" : " with some more text");
+			if(strcmp(line, want)) {
+				CHECK_STR(line, want);
+				return;
+			}
+			read_back++;
+		}
+	}
+	CHECK_INT(read_back, written);
+	CHECK_INT(lr.dropped, 0);
+}
+
+static void check_oversize(void) {
+	static char big[LINE_READER_SIZE * 3];
+
+	// longest line that fits is kept, one byte more is dropped up to '\n'
+	line_reader_init(&lr);
+	for(size_t len = LINE_READER_SIZE - 1; len <= LINE_READER_SIZE; ++len) {
+		memset(big, 'x', len);
+		big[len] = '\n';
+		put(big, len + 1);
+		puts_pipe("after\n");
+		size_t n;
+		const char *line = next(&n);
+		CHECK(line != NULL);
+		if(len < LINE_READER_SIZE) {
+			CHECK_INT(n, len);
+			expect("after");
+		} else if(line) {
+			CHECK_STR(line, "after");
+		}
+	}
+	CHECK_INT(lr.dropped, 1);
+
+	// oversize line after a partial one, arriving in pieces
+	line_reader_init(&lr);
+	puts_pipe("first\nsecond");
+	expect("first");
+	put("\n", 1);
+	expect("second");
+	memset(big, 'y', sizeof(big));
+	for(size_t off = 0; off < sizeof(big); off += 5000) {
+		put(big + off, off + 5000 < sizeof(big) ? 5000 : sizeof(big) - off);
+		expect_none();
+	}
+	puts_pipe("\nthird\n");
+	expect("third");
+	expect_none();
+	CHECK_INT(lr.dropped, 1);
+}
+
+static void check_crlf(void) {
+	line_reader_init(&lr);
+	puts_pipe("1700000000.1: gpu 50.00%, sclk 25.00% 0.500ghz\r\n1700000000.2: gpu 1");
+	puts_pipe("0.00%\r");
+	puts_pipe("\n");
+
+	size_t len;
+	struct gpu_stats s;
+	const char *line = next(&len);
+	CHECK(line && len > 0 && line[len - 1] == '\r');
+	CHECK(line && radeontop_parse_line(line, len, &s));
+	CHECK_FLOAT(s.busy[GPU_BLOCK_GPU], 50, 1e-4);
+	CHECK_FLOAT(s.sclk_ghz, 0.5, 1e-6);
+	line = next(&len);
+	CHECK(line && radeontop_parse_line(line, len, &s));
+	CHECK_FLOAT(s.busy[GPU_BLOCK_GPU], 10, 1e-4);
+	expect_none();
+}
+
+int main(void) {
+	CHECK(pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0);
+	fcntl(fds[1], F_SETPIPE_SZ, 1 << 20);
+
+	check_partial();
+	check_burst();
+	check_oversize();
+	check_crlf();
+
+	// writer gone: read() returns 0
+	close(fds[1]);
+	const char *line;
+	size_t len;
+	CHECK(!line_reader_next(&lr, &line, &len));
+	CHECK_INT(line_reader_fill(&lr, fds[0]), 0);
+	return check_report("line_reader");
+}
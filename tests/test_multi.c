@@ -0,0 +1,131 @@
+/* Several fake radeontop generators serviced by one poll loop, as the
+ * sampler thread does for every GPU: samples of each child keep its bus,
+ * none are lost or mixed up, and one child exiting doesn't disturb the
+ * others. */
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include "check.h"
+#include "radeontop_child.h"
+#include "line_reader.h"
+#include "radeontop_parse.h"
+
+#define GPUS 3
+#define RUN_MS 1000
+
+struct gpu {
+	const char *bus;
+	const char *rate;
+	const char *count;	// exits after that many lines, NULL for never
+	struct radeontop_child child;
+	struct line_reader lines;
+	struct stderr_ring stderr_ring;
+	bool first_line;
+	bool exited;
+	unsigned int samples;
+	unsigned int wrong_bus;
+	unsigned int errors;
+	uint64_t last_time_us;
+	unsigned int backwards;
+};
+
+static uint64_t monotonic_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void read_lines(struct gpu *g) {
+	ssize_t n;
+	while((n = line_reader_fill(&g->lines, g->child.out_fd)) > 0) {
+		const char *line;
+		size_t len;
+		while(line_reader_next(&g->lines, &line, &len)) {
+			if(g->first_line) {
+				g->first_line = false;	// banner
+				continue;
+			}
+			struct gpu_stats stats;
+			if(!radeontop_parse_line(line, len, &stats)) {
+				g->errors++;
+				continue;
+			}
+			g->samples++;
+			if(stats.bus != strtoul(g->bus, NULL, 16)) {
+				g->wrong_bus++;
+			}
+			if(stats.sample_time_us < g->last_time_us) {
+				g->backwards++;
+			}
+			g->last_time_us = stats.sample_time_us;
+		}
+	}
+	if(n == 0) {
+		g->exited = true;
+		radeontop_child_stop(&g->child);
+	}
+}
+
+int main(void) {
+	struct gpu gpus[GPUS] = {
+		{ .bus = "03", .rate = "500" },
+		{ .bus = "0a", .rate = "200" },
+		{ .bus = "41", .rate = "1000", .count = "100" },
+	};
+
+	for(int i = 0; i < GPUS; ++i) {
+		struct gpu *g = &gpus[i];
+		const char *cmdline[] = { "./fake-radeontop", "-b", g->bus, "-r", g->rate,
+			g->count ? "-n" : NULL, g->count, NULL };
+		CHECK_INT(radeontop_child_spawn(&g->child, cmdline), 0);
+		line_reader_init(&g->lines);
+		g->first_line = true;
+	}
+
+	const uint64_t start = monotonic_ms();
+	uint64_t now;
+	while((now = monotonic_ms()) < start + RUN_MS) {
+		struct pollfd fds[GPUS * 3];
+		for(int i = 0; i < GPUS; ++i) {
+			const struct radeontop_child *c = &gpus[i].child;
+			fds[i * 3] = (struct pollfd){ .fd = c->out_fd, .events = POLLIN };
+			fds[i * 3 + 1] = (struct pollfd){ .fd = c->err_fd, .events = POLLIN };
+			fds[i * 3 + 2] = (struct pollfd){ .fd = c->pidfd, .events = POLLIN };
+		}
+		if(poll(fds, GPUS * 3, (int)(start + RUN_MS - now)) < 0 && errno != EINTR) {
+			perror("poll");
+			return 1;
+		}
+		for(int i = 0; i < GPUS; ++i) {
+			struct gpu *g = &gpus[i];
+			if(fds[i * 3 + 1].revents && g->child.err_fd >= 0) {
+				radeontop_child_drain_stderr(&g->child, &g->stderr_ring);
+			}
+			if(fds[i * 3].revents || fds[i * 3 + 2].revents) {
+				read_lines(g);
+			}
+		}
+	}
+	const uint64_t elapsed = monotonic_ms() - start;
+
+	for(int i = 0; i < GPUS; ++i) {
+		struct gpu *g = &gpus[i];
+		printf("bus %s: %u samples in %llu ms\n", g->bus, g->samples, (unsigned long long)elapsed);
+		CHECK_INT(g->errors, 0);
+		CHECK_INT(g->wrong_bus, 0);
+		CHECK_INT(g->backwards, 0);
+		if(g->count) {
+			CHECK(g->exited);
+			CHECK_INT(g->samples, atoi(g->count));
+		} else {
+			CHECK(!g->exited);
+			// lines are paced by absolute deadlines, allow for a slow start
+			const unsigned int expected = (unsigned int)(atoi(g->rate) * elapsed / 1000);
+			CHECK(g->samples >= expected * 8 / 10);
+			CHECK(g->samples <= expected + 2);
+			radeontop_child_stop(&g->child);
+		}
+	}
+	return check_report("multi");
+}
@@ -0,0 +1,110 @@
+#include "check.h"
+#include "radeontop_parse.h"
+
+#define FULL "1700000000.123456: bus 03, gpu 12.50%, ee 0.00%, vgt 1.67%, ta 8.33%, " \
+	"sx 9.17%, sh 0.00%, spi 10.83%, sc 10.00%, pa 2.50%, db 9.17%, cb 7.50%, " \
+	"vram 5.72% 468.35mb, gtt 0.47% 38.53mb, mclk 100.00% 1.750ghz, sclk 29.17% 0.350ghz"
+
+#define ALL_FIELDS (((1u << GPU_BLOCK_COUNT) - 1) | \
+	GPU_FIELD_BIT(GPU_FIELD_TIMESTAMP) | GPU_FIELD_BIT(GPU_FIELD_BUS) | \
+	GPU_FIELD_BIT(GPU_FIELD_VRAM) | GPU_FIELD_BIT(GPU_FIELD_GTT) | \
+	GPU_FIELD_BIT(GPU_FIELD_MCLK) | GPU_FIELD_BIT(GPU_FIELD_SCLK))
+
+static bool parse(const char *line, struct gpu_stats *out) {
+	return radeontop_parse_line(line, strlen(line), out);
+}
+
+static void check_full(const struct gpu_stats *s) {
+	CHECK_INT(s->valid, ALL_FIELDS);
+	CHECK_INT(s->sample_time_us, 1700000000123456ull);
+	CHECK_INT(s->bus, 3);
+	CHECK_FLOAT(s->busy[GPU_BLOCK_GPU], 12.5, 1e-4);
+	CHECK_FLOAT(s->busy[GPU_BLOCK_SPI], 10.83, 1e-4);
+	CHECK_FLOAT(s->busy[GPU_BLOCK_CB], 7.5, 1e-4);
+	CHECK_FLOAT(s->vram, 5.72, 1e-4);
+	CHECK_FLOAT(s->vram_mb, 468.35, 1e-3);
+	CHECK_FLOAT(s->gtt_mb, 38.53, 1e-3);
+	CHECK_FLOAT(s->mclk, 100, 1e-4);
+	CHECK_FLOAT(s->mclk_ghz, 1.75, 1e-4);
+	CHECK_FLOAT(s->sclk, 29.17, 1e-4);
+	CHECK_FLOAT(s->sclk_ghz, 0.35, 1e-4);
+}
+
+int main(void) {
+	struct gpu_stats s;
+
+	CHECK(parse(FULL, &s));
+	check_full(&s);
+
+	// line from line_reader has no NUL and may be followed by next line
+	const char two[] = FULL "\n1700000001.5: gpu 99.00%";
+	CHECK(radeontop_parse_line(two, sizeof(FULL) - 1, &s));
+	check_full(&s);
+
+	// CRLF, e.g. from a replayed file
+	CHECK(parse(FULL "\r", &s));
+	check_full(&s);
+	CHECK(parse("1700000000.1: gpu 50.00%\r", &s));
+	CHECK_INT(s.valid, GPU_FIELD_BIT(GPU_FIELD_TIMESTAMP) | GPU_FIELD_BIT(GPU_BLOCK_GPU));
+	CHECK_FLOAT(s.busy[GPU_BLOCK_GPU], 50, 1e-4);
+
+	// usec isn't zero-padded by radeontop
+	CHECK(parse("1700000000.5: gpu 1.00%", &s));
+	CHECK_INT(s.sample_time_us, 1700000000000005ull);
+	CHECK(parse("1700000000: gpu 1.00%", &s));
+	CHECK_INT(s.sample_time_us, 1700000000000000ull);
+
+	// missing bus, e.g. older radeontop: everything else still decoded
+	CHECK(parse("1700000000.0: gpu 12.50%, ee 0.00%, vram 5.72% 468.35mb, sclk 29.17% 0.350ghz", &s));
+	CHECK(!(s.valid & GPU_FIELD_BIT(GPU_FIELD_BUS)));
+	CHECK_INT(s.bus, 0);
+	CHECK_FLOAT(s.busy[GPU_BLOCK_GPU], 12.5, 1e-4);
+	CHECK_FLOAT(s.vram_mb, 468.35, 1e-3);
+	CHECK_FLOAT(s.sclk_ghz, 0.35, 1e-4);
+	CHECK(parse("1700000000.0: bus 0a, gpu 1.00%", &s));
+	CHECK_INT(s.bus, 10);
+	CHECK(parse("1700000000.0: bus, gpu 1.00%", &s));
+	CHECK(!(s.valid & GPU_FIELD_BIT(GPU_FIELD_BUS)));
+
+	// unknown tokens, as newer radeontop prints uvd/vce and more
+	CHECK(parse("1700000000.0: bus 03, gpu 12.50%, uvd 0.00%, vce 0.00%, h264 7.00% 2.000ghz, "
+			"GFX 1.00%, sclk 29.17% 0.350ghz", &s));
+	CHECK_INT(s.valid, GPU_FIELD_BIT(GPU_FIELD_TIMESTAMP) | GPU_FIELD_BIT(GPU_FIELD_BUS) |
+			GPU_FIELD_BIT(GPU_BLOCK_GPU) | GPU_FIELD_BIT(GPU_FIELD_SCLK));
+	CHECK_FLOAT(s.sclk, 29.17, 1e-4);
+	CHECK(!parse("1700000000.0: uvd 0.00%, vce 0.00%", &s));
+
+	// truncated fields are left out, the ones before stay
+	CHECK(parse("1700000000.0: bus 03, gpu 12.50%, ee 0.0", &s));
+	CHECK(s.valid & GPU_FIELD_BIT(GPU_BLOCK_GPU));
+	CHECK(!(s.valid & GPU_FIELD_BIT(GPU_BLOCK_EE)));
+	CHECK(parse("1700000000.0: gpu 12.50%, vram 5.72% 468", &s));
+	CHECK(!(s.valid & GPU_FIELD_BIT(GPU_FIELD_VRAM)));
+	CHECK_FLOAT(s.vram, 0, 0);
+	CHECK(parse("1700000000.0: gpu 12.50%, sclk 29.17% 0.350gh", &s));
+	CHECK(!(s.valid & GPU_FIELD_BIT(GPU_FIELD_SCLK)));
+	CHECK(parse("1700000000.0: gpu 12.50%, sclk", &s));
+	CHECK(!(s.valid & GPU_FIELD_BIT(GPU_FIELD_SCLK)));
+	// every prefix of a full line either fails or decodes what it has
+	for(size_t n = 0; n <= strlen(FULL); ++n) {
+		if(radeontop_parse_line(FULL, n, &s)) {
+			CHECK(s.valid & GPU_FIELD_BIT(GPU_FIELD_TIMESTAMP));
+			CHECK(s.busy[GPU_BLOCK_GPU] == 0 || s.busy[GPU_BLOCK_GPU] == 12.5f);
+			CHECK(s.vram_mb == 0 || (s.valid & GPU_FIELD_BIT(GPU_FIELD_VRAM)));
+			CHECK(s.sclk_ghz == 0 || (s.valid & GPU_FIELD_BIT(GPU_FIELD_SCLK)));
+		}
+	}
+	// a bad value doesn't stop next fields from being decoded
+	CHECK(parse("1700000000.0: gpu x%, ee 1.00%", &s));
+	CHECK_INT(s.valid, GPU_FIELD_BIT(GPU_FIELD_TIMESTAMP) | GPU_FIELD_BIT(GPU_BLOCK_EE));
+
+	// no timestamp or no fields
+	CHECK(!parse("Dumping to -, until termination.", &s));
+	CHECK(!parse("", &s));
+	CHECK(!parse("1700000000.0:", &s));
+	CHECK(!parse("1700000000.0: \r", &s));
+	CHECK(!parse("1700000000.0 gpu 12.50%", &s));
+	CHECK(!parse("1700000000.: gpu 12.50%", &s));
+
+	return check_report("parse");
+}
@@ -0,0 +1,105 @@
+/* Rollups driven as the chart drives them: samples close periods before
+ * the once a second advance, and every level gets all of its columns.
+ * Also late samples, skipped periods and ring wraparound. */
+#include <stdlib.h>
+#include "check.h"
+#include "rollup.h"
+
+#define START_S 6000	// a 10 min boundary
+
+static struct rollup r;
+
+/* sample of second s carries s in both channels */
+static unsigned int add(uint64_t s) {
+	const float values[ROLLUP_CHANNELS] = { (float)s, (float)s };
+	return rollup_add(&r, s, values);
+}
+
+static void check_stat(int level, size_t age, float min, float max, uint32_t count) {
+	const struct rollup_stat *st = rollup_get(&r, level, age, ROLLUP_GPU_PIPE);
+	CHECK_INT(st->count, count);
+	CHECK_FLOAT(st->min, min, 0);
+	CHECK_FLOAT(st->max, max, 0);
+	CHECK_FLOAT(rollup_mean(st), count ? (min + max) / 2 : 0, 1e-3);
+}
+
+/* 4 samples a second and a chart tick half way between them, for 10 min */
+static void check_ticks(void) {
+	unsigned int columns[ROLLUP_LEVELS] = {0}, closed = 0;
+	rollup_init(&r, START_S);
+	for(uint64_t ms = START_S * 1000ull; ms <= (START_S + 600) * 1000ull + 500; ms += 250) {
+		closed |= add(ms / 1000);
+		if(ms % 1000 == 500) {
+			closed |= rollup_advance(&r, ms / 1000);
+			for(int l = 0; l < ROLLUP_LEVELS; ++l) {
+				columns[l] += !!(closed & (1u << l));
+			}
+			closed = 0;
+		}
+	}
+	CHECK_INT(columns[0], 600);
+	CHECK_INT(columns[1], 60);
+	CHECK_INT(columns[2], 10);
+	CHECK_INT(columns[3], 1);
+
+	check_stat(0, 0, START_S + 599, START_S + 599, 4);
+	check_stat(1, 0, START_S + 590, START_S + 599, 40);
+	check_stat(2, 9, START_S, START_S + 59, 240);
+	check_stat(3, 0, START_S, START_S + 599, 2400);
+}
+
+static void check_late(void) {
+	rollup_init(&r, START_S);
+	CHECK_INT(add(START_S), 0);
+	// older than open period: counted in it, closes nothing
+	CHECK_INT(add(START_S - 5), 0);
+	CHECK_INT(rollup_advance(&r, START_S), 0);
+	CHECK_INT(rollup_advance(&r, START_S + 1), 1);
+	check_stat(0, 0, START_S - 5, START_S, 2);
+	// advancing backwards doesn't move anything
+	CHECK_INT(rollup_advance(&r, START_S - 100), 0);
+	check_stat(0, 0, START_S - 5, START_S, 2);
+}
+
+static void check_skipped(void) {
+	rollup_init(&r, START_S);
+	add(START_S);
+	// 10 s level closes at START_S + 10 too
+	CHECK_INT(add(START_S + 12), 3);
+	for(size_t age = 0; age < 11; ++age) {
+		check_stat(0, age, 0, 0, 0);
+	}
+	check_stat(0, 11, START_S, START_S, 1);
+	check_stat(1, 0, START_S, START_S, 1);
+}
+
+static void check_wrap(void) {
+	rollup_init(&r, START_S);
+	for(uint64_t s = START_S; s < START_S + 2 * ROLLUP_SLOTS; ++s) {
+		add(s);
+	}
+	const uint64_t last = START_S + 2 * ROLLUP_SLOTS - 1;
+	check_stat(0, 0, last - 1, last - 1, 1);
+	check_stat(0, ROLLUP_SLOTS - 2, last - ROLLUP_SLOTS + 1, last - ROLLUP_SLOTS + 1, 1);
+
+	// skipped slots held periods a lap ago
+	add(last + 20);
+	for(size_t age = 0; age < 19; ++age) {
+		check_stat(0, age, 0, 0, 0);
+	}
+	check_stat(0, 19, last, last, 1);
+
+	// gap longer than ring leaves nothing of before
+	add(last + 20 + 3 * ROLLUP_SLOTS);
+	for(size_t age = 0; age < ROLLUP_SLOTS - 1; ++age) {
+		check_stat(0, age, 0, 0, 0);
+	}
+}
+
+int main(void) {
+	check_ticks();
+	check_late();
+	check_skipped();
+	check_wrap();
+	return check_report("rollup");
+}
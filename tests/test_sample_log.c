@@ -0,0 +1,179 @@
+/* Sample log written and read back through 0xff bytes inside varints, a
+ * record cut short by a crash at every length and junk between segments,
+ * each followed by a new segment the reader resyncs on; no writer is
+ * started for a file that can't be opened. */
+#include <stdlib.h>
+#include <unistd.h>
+#include "check.h"
+#include "sample_log.h"
+
+#define T0 1700000000000000ull
+#define SAMPLES 200
+
+static struct sample_log log_;
+static char path[] = "/tmp/test_sample_log.XXXXXX";
+
+/* sample i of every field; vram steps by 128 MiB, a delta coded as 0xff 0x01 */
+static void make_stats(unsigned int i, struct gpu_stats *s) {
+	*s = (struct gpu_stats){0};
+	for(int b = 0; b < GPU_BLOCK_COUNT; ++b) {
+		s->busy[b] = (float)((i * 7 + (unsigned int)b * 13) % 101);
+	}
+	s->vram_mb = i % 2 ? 1000 : 872;
+	s->gtt_mb = 50.0f + (float)i;
+	s->sclk_ghz = 0.5f + (float)(i % 3) * 0.25f;
+	s->power_w = 42.5f;
+	s->temp_c[GPU_TEMP_EDGE] = 50.0f + (float)(i % 5);
+	s->sample_time_us = T0 + i * 1000ull + (i % 2 ? 0 : 128);
+	s->valid = (GPU_FIELD_BIT(GPU_BLOCK_COUNT) - 1) | GPU_FIELD_BIT(GPU_FIELD_TIMESTAMP) |
+		GPU_FIELD_BIT(GPU_FIELD_VRAM) | GPU_FIELD_BIT(GPU_FIELD_GTT) |
+		GPU_FIELD_BIT(GPU_FIELD_SCLK) | GPU_FIELD_BIT(GPU_FIELD_POWER) |
+		GPU_FIELD_BIT(GPU_FIELD_TEMP + GPU_TEMP_EDGE);
+}
+
+/* appends a segment of samples first ... first + n - 1 */
+static void write_segment(unsigned int first, unsigned int n) {
+	CHECK_INT(sample_log_start(&log_, path, 0, 0), 0);
+	for(unsigned int i = first; i < first + n; ++i) {
+		struct gpu_stats s;
+		make_stats(i, &s);
+		CHECK(sample_log_push(&log_, i % 3, &s));
+	}
+	sample_log_stop(&log_);
+}
+
+/* reads samples first ... first + n - 1 and fails on anything else */
+static void expect_samples(struct sample_log_reader *r, unsigned int first, unsigned int n) {
+	for(unsigned int i = first; i < first + n; ++i) {
+		struct sample_log_entry e;
+		struct gpu_stats s;
+		make_stats(i, &s);
+		const int got = sample_log_read(r, &e);
+		CHECK_INT(got, 1);
+		if(got != 1) {
+			return;
+		}
+		CHECK_INT(e.gpu, i % 3);
+		CHECK_INT(e.time_us, s.sample_time_us);
+		CHECK_INT(e.valid, (SAMPLE_LOG_BIT(SAMPLE_LOG_VRAM) - 1) |
+				SAMPLE_LOG_BIT(SAMPLE_LOG_VRAM) | SAMPLE_LOG_BIT(SAMPLE_LOG_GTT) |
+				SAMPLE_LOG_BIT(SAMPLE_LOG_SCLK) | SAMPLE_LOG_BIT(SAMPLE_LOG_POWER) |
+				SAMPLE_LOG_BIT(SAMPLE_LOG_TEMP));
+		CHECK_INT(e.value[SAMPLE_LOG_BUSY + GPU_BLOCK_CB], (int32_t)s.busy[GPU_BLOCK_CB] * 100);
+		CHECK_INT(e.value[SAMPLE_LOG_VRAM], (int32_t)s.vram_mb);
+		CHECK_INT(e.value[SAMPLE_LOG_GTT], (int32_t)s.gtt_mb);
+		CHECK_INT(e.value[SAMPLE_LOG_SCLK], (int32_t)(s.sclk_ghz * 1000));
+		CHECK_INT(e.value[SAMPLE_LOG_POWER], 425);
+		CHECK_INT(e.value[SAMPLE_LOG_TEMP], (int32_t)s.temp_c[GPU_TEMP_EDGE] * 10);
+	}
+}
+
+static long file_size(void) {
+	FILE *f = fopen(path, "rb");
+	CHECK(f != NULL);
+	if(!f) {
+		return 0;
+	}
+	fseek(f, 0, SEEK_END);
+	const long size = ftell(f);
+	fclose(f);
+	return size;
+}
+
+static void check_round_trip(void) {
+	truncate(path, 0);
+	write_segment(0, SAMPLES);
+	write_segment(SAMPLES, SAMPLES);
+	CHECK_INT(atomic_load(&log_.dropped), 0);
+
+	// more 0xff than the two segment markers
+	FILE *f = fopen(path, "rb");
+	unsigned int ff = 0;
+	int c;
+	while(f && (c = getc(f)) != EOF) {
+		ff += c == 0xff;
+	}
+	if(f) {
+		fclose(f);
+	}
+	CHECK(ff > 2);
+
+	struct sample_log_reader r;
+	struct sample_log_entry e;
+	CHECK_INT(sample_log_reader_open(&r, path), 0);
+	expect_samples(&r, 0, 2 * SAMPLES);
+	CHECK_INT(sample_log_read(&r, &e), 0);
+	sample_log_reader_close(&r);
+}
+
+/* last record cut short by cut bytes, then a writer starts over */
+static void check_torn(long cut) {
+	truncate(path, 0);
+	write_segment(0, SAMPLES);
+	const long size = file_size();
+	CHECK(truncate(path, size - cut) == 0);
+	write_segment(SAMPLES, SAMPLES);
+
+	struct sample_log_reader r;
+	struct sample_log_entry e;
+	CHECK_INT(sample_log_reader_open(&r, path), 0);
+	expect_samples(&r, 0, SAMPLES - 1);
+	CHECK_INT(sample_log_read(&r, &e), -1);
+	expect_samples(&r, SAMPLES, SAMPLES);
+	CHECK_INT(sample_log_read(&r, &e), 0);
+	sample_log_reader_close(&r);
+}
+
+static void check_junk(void) {
+	truncate(path, 0);
+	write_segment(0, SAMPLES);
+	// a marker with a partial header, and bytes that aren't records
+	FILE *f = fopen(path, "ab");
+	CHECK(f != NULL);
+	if(f) {
+		static const uint8_t junk[] = { 0xff, 0x47, 0x50, 0x55, 0x20, 0xff, 0xff, 0x80, 0x13 };
+		fwrite(junk, sizeof(junk), 1, f);
+		fclose(f);
+	}
+	write_segment(SAMPLES, SAMPLES);
+
+	struct sample_log_reader r;
+	struct sample_log_entry e;
+	CHECK_INT(sample_log_reader_open(&r, path), 0);
+	expect_samples(&r, 0, SAMPLES);
+	CHECK_INT(sample_log_read(&r, &e), -1);
+	expect_samples(&r, SAMPLES, SAMPLES);
+	CHECK_INT(sample_log_read(&r, &e), 0);
+	sample_log_reader_close(&r);
+
+	// damage at end of file is reported once
+	truncate(path, file_size() - 1);
+	CHECK_INT(sample_log_reader_open(&r, path), 0);
+	expect_samples(&r, 0, SAMPLES);
+	CHECK_INT(sample_log_read(&r, &e), -1);
+	expect_samples(&r, SAMPLES, SAMPLES - 1);
+	CHECK_INT(sample_log_read(&r, &e), -1);
+	CHECK_INT(sample_log_read(&r, &e), 0);
+	sample_log_reader_close(&r);
+}
+
+int main(void) {
+	const int fd = mkstemp(path);
+	CHECK(fd >= 0);
+	close(fd);
+
+	check_round_trip();
+	// every cut of the last record, from its last byte to all but its gpu byte
+	for(long cut = 1; cut < 16; ++cut) {
+		check_torn(cut);
+	}
+	check_junk();
+
+	// no writer for a file that can't be opened
+	CHECK_INT(sample_log_start(&log_, "/nonexistent/dir/log", 0, 0), -1);
+	CHECK(log_.thread == 0);
+	sample_log_stop(&log_);
+
+	unlink(path);
+	return check_report("sample_log");
+}
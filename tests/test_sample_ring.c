@@ -0,0 +1,120 @@
+/* Sample ring order, overflow and wraparound, and mean/max/p95 of known
+ * sample sequences, checked for p95 against sorting. */
+#include <stdlib.h>
+#include "check.h"
+#include "sample_ring.h"
+
+static struct sample_ring ring;
+
+static int compare_float(const void *a, const void *b) {
+	const float x = *(const float *)a, y = *(const float *)b;
+	return x < y ? -1 : x > y;
+}
+
+static float reduce(const float *in, size_t n, enum sample_reduction r) {
+	float v[SAMPLE_RING_SIZE];
+	memcpy(v, in, n * sizeof(v[0]));
+	return sample_reduce(v, n, r);
+}
+
+/* pushes values as one chart column of samples, drains and reduces them */
+static float column(const float *in, size_t n, enum sample_reduction r) {
+	for(size_t i = 0; i < n; ++i) {
+		const struct sample s = { .time_us = i, .gpu_pipe = in[i], .shader_clock = 100 - in[i] };
+		CHECK(sample_ring_push(&ring, &s));
+	}
+	struct sample out[SAMPLE_RING_SIZE];
+	float v[SAMPLE_RING_SIZE];
+	const size_t drained = sample_ring_drain(&ring, out, SAMPLE_RING_SIZE);
+	CHECK_INT(drained, n);
+	for(size_t i = 0; i < drained; ++i) {
+		CHECK_INT(out[i].time_us, i);
+		v[i] = out[i].gpu_pipe;
+	}
+	return sample_reduce(v, drained, r);
+}
+
+int main(void) {
+	struct sample out[SAMPLE_RING_SIZE];
+
+	// empty, then order kept across wraparound
+	CHECK_INT(sample_ring_drain(&ring, out, SAMPLE_RING_SIZE), 0);
+	for(unsigned int round = 0; round < 5; ++round) {
+		for(unsigned int i = 0; i < 300; ++i) {
+			const struct sample s = { .time_us = round * 1000 + i };
+			CHECK(sample_ring_push(&ring, &s));
+		}
+		CHECK_INT(sample_ring_drain(&ring, out, 100), 100);
+		CHECK_INT(out[0].time_us, round * 1000);
+		CHECK_INT(sample_ring_drain(&ring, out, SAMPLE_RING_SIZE), 200);
+		CHECK_INT(out[0].time_us, round * 1000 + 100);
+		CHECK_INT(out[199].time_us, round * 1000 + 299);
+	}
+
+	// full ring drops newest and counts it
+	for(unsigned int i = 0; i < SAMPLE_RING_SIZE + 10; ++i) {
+		const struct sample s = { .time_us = i };
+		CHECK(sample_ring_push(&ring, &s) == (i < SAMPLE_RING_SIZE));
+	}
+	CHECK_INT(atomic_load(&ring.dropped), 10);
+	CHECK_INT(sample_ring_drain(&ring, out, SAMPLE_RING_SIZE), SAMPLE_RING_SIZE);
+	CHECK_INT(out[SAMPLE_RING_SIZE - 1].time_us, SAMPLE_RING_SIZE - 1);
+
+	// one 80% spike among ten samples of a column (radeontop -t 10)
+	const float spike[10] = { 10, 10, 10, 10, 80, 10, 10, 10, 10, 10 };
+	CHECK_FLOAT(column(spike, 10, REDUCE_MEAN), 17, 1e-4);
+	CHECK_FLOAT(column(spike, 10, REDUCE_MAX), 80, 0);
+	CHECK_FLOAT(column(spike, 10, REDUCE_P95), 80, 0);
+
+	// single sample is every reduction of itself
+	const float one = 42;
+	CHECK_FLOAT(column(&one, 1, REDUCE_MEAN), 42, 0);
+	CHECK_FLOAT(column(&one, 1, REDUCE_MAX), 42, 0);
+	CHECK_FLOAT(column(&one, 1, REDUCE_P95), 42, 0);
+
+	// nearest-rank p95 of 1..100 is 95, in any order
+	float v[SAMPLE_RING_SIZE];
+	for(int i = 0; i < 100; ++i) {
+		v[i] = (float)(i + 1);
+	}
+	CHECK_FLOAT(reduce(v, 100, REDUCE_P95), 95, 0);
+	CHECK_FLOAT(reduce(v, 100, REDUCE_MEAN), 50.5, 1e-4);
+	CHECK_FLOAT(reduce(v, 100, REDUCE_MAX), 100, 0);
+	for(int i = 0; i < 100; ++i) {
+		v[i] = (float)(100 - i);
+	}
+	CHECK_FLOAT(reduce(v, 100, REDUCE_P95), 95, 0);
+	// of 20 samples it is the 19th
+	CHECK_FLOAT(reduce(v + 80, 20, REDUCE_P95), 19, 0);
+
+	// p95 ignores up to 5 spikes in 100 samples, not 6
+	for(int spikes = 0; spikes <= 6; ++spikes) {
+		for(int i = 0; i < 100; ++i) {
+			v[(i * 37) % 100] = i < spikes ? 100.0f : 5.0f;	// spikes spread out
+		}
+		CHECK_FLOAT(reduce(v, 100, REDUCE_P95), spikes <= 5 ? 5 : 100, 0);
+	}
+
+	// constant input (median-of-three pivot must not degrade or overrun)
+	for(int i = 0; i < SAMPLE_RING_SIZE; ++i) {
+		v[i] = 7;
+	}
+	CHECK_FLOAT(reduce(v, SAMPLE_RING_SIZE, REDUCE_P95), 7, 0);
+
+	// random sequences against qsort
+	srand(1);
+	for(int round = 0; round < 2000; ++round) {
+		const size_t n = 1 + (size_t)rand() % SAMPLE_RING_SIZE;
+		float sorted[SAMPLE_RING_SIZE];
+		for(size_t i = 0; i < n; ++i) {
+			// few distinct values make duplicates likely
+			v[i] = (float)(rand() % (round % 2 ? 5 : 10000)) / 100.0f;
+		}
+		memcpy(sorted, v, n * sizeof(v[0]));
+		qsort(sorted, n, sizeof(sorted[0]), compare_float);
+		CHECK_FLOAT(reduce(v, n, REDUCE_P95), sorted[(n * 95 + 99) / 100 - 1], 0);
+		CHECK_FLOAT(reduce(v, n, REDUCE_MAX), sorted[n - 1], 0);
+	}
+
+	return check_report("sample_ring");
+}
@@ -0,0 +1,112 @@
+/* Torn-read stress of stats_seqlock: a writer publishes samples whose
+ * fields all derive from one counter, readers check every snapshot is
+ * consistent and generations never go back. */
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include "check.h"
+#include "stats_seqlock.h"
+
+#define READERS 3
+#define RUN_MS 500
+
+static struct stats_seqlock seqlock;
+static atomic_bool stop;
+static atomic_uint torn, backwards;
+static atomic_ullong reads;
+
+static uint64_t monotonic_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void fill(struct gpu_stats *s, uint32_t n) {
+	memset(s, 0, sizeof(*s));
+	s->sample_time_us = n;
+	s->recv_time_ns = (uint64_t)n << 20;
+	s->valid = n;
+	s->gaps = ~n;
+	const float v = (float)(n & 0xffff);
+	for(int i = 0; i < GPU_BLOCK_COUNT; ++i) {
+		s->busy[i] = v + (float)i;
+	}
+	s->vram_mb = s->gtt_mb = s->sclk = s->fan_rpm = v;
+}
+
+static bool consistent(const struct gpu_stats *s) {
+	const uint32_t n = (uint32_t)s->sample_time_us;
+	struct gpu_stats expected;
+	fill(&expected, n);
+	return memcmp(s, &expected, sizeof(*s)) == 0;
+}
+
+static void *writer(void *arg) {
+	(void)arg;
+	struct gpu_stats s;
+	// main wrote sample 0, so generation after sample n is n + 1
+	for(uint32_t n = 1; !atomic_load_explicit(&stop, memory_order_relaxed); ++n) {
+		fill(&s, n);
+		stats_seqlock_write(&seqlock, &s);
+	}
+	return NULL;
+}
+
+static void *reader(void *arg) {
+	(void)arg;
+	struct gpu_stats s;
+	unsigned int last = 0;
+	uint64_t n = 0;
+	while(!atomic_load_explicit(&stop, memory_order_relaxed)) {
+		const unsigned int gen = stats_seqlock_read(&seqlock, &s);
+		if(gen == 0) {
+			continue;	// nothing written yet
+		}
+		if(!consistent(&s) || gen != (unsigned int)s.sample_time_us + 1) {
+			atomic_fetch_add(&torn, 1);
+		}
+		if(gen < last) {
+			atomic_fetch_add(&backwards, 1);
+		}
+		last = gen;
+		n++;
+	}
+	atomic_fetch_add(&reads, n);
+	return NULL;
+}
+
+int main(void) {
+	struct gpu_stats s;
+	CHECK_INT(stats_seqlock_generation(&seqlock), 0);
+	fill(&s, 0);
+	stats_seqlock_write(&seqlock, &s);
+	CHECK_INT(stats_seqlock_generation(&seqlock), 1);
+	CHECK_INT(stats_seqlock_read(&seqlock, &s), 1);
+	CHECK(consistent(&s));
+
+	pthread_t threads[READERS + 1];
+	pthread_create(&threads[0], NULL, writer, NULL);
+	for(int i = 1; i <= READERS; ++i) {
+		pthread_create(&threads[i], NULL, reader, NULL);
+	}
+	const uint64_t end = monotonic_ms() + RUN_MS;
+	while(monotonic_ms() < end) {
+		// GTK thread side: generation check, then read
+		const unsigned int gen = stats_seqlock_generation(&seqlock);
+		const unsigned int read_gen = stats_seqlock_read(&seqlock, &s);
+		CHECK(read_gen >= gen);
+		CHECK(consistent(&s));
+	}
+	atomic_store(&stop, true);
+	for(int i = 0; i <= READERS; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+
+	printf("seqlock: %llu reads, %u generations\n",
+			(unsigned long long)atomic_load(&reads), stats_seqlock_generation(&seqlock));
+	CHECK(atomic_load(&reads) > 0);
+	CHECK_INT(atomic_load(&torn), 0);
+	CHECK_INT(atomic_load(&backwards), 0);
+	return check_report("seqlock");
+}
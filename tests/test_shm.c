@@ -0,0 +1,189 @@
+/* Shared memory segment read concurrently with its writer: a child process
+ * publishes samples whose fields all derive from their number, reader
+ * threads of this process check they never see a torn one, follow the
+ * writer through the ring and notice it closing. */
+#include <stdlib.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "check.h"
+#include "gpu_shm.h"
+
+#define GPUS 2
+#define RUN_MS 500
+
+static char name[64];
+static struct gpu_shm_reader reader;
+static atomic_uint torn, backwards;
+static atomic_ullong reads, missed;
+
+static uint64_t monotonic_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/* sample n of gpu, sample_time_us tells n back */
+static void fill(struct gpu_stats *s, int gpu, uint64_t n) {
+	memset(s, 0, sizeof(*s));
+	s->sample_time_us = n;
+	s->recv_time_ns = n * 1000 + (uint64_t)gpu;
+	s->bus = (unsigned int)gpu + 3;
+	s->gaps = (uint32_t)n;
+	s->valid = (uint32_t)n & (GPU_FIELD_BIT(GPU_FIELD_POWER) - 1);
+	const float v = (float)(n & 0xffff);
+	for(int i = 0; i < GPU_BLOCK_COUNT; ++i) {
+		s->busy[i] = v + (float)i;
+	}
+	s->vram_mb = s->gtt_mb = s->sclk = s->sclk_ghz = v;
+}
+
+static bool consistent(const struct gpu_shm_sample *s, int gpu) {
+	const uint64_t n = s->sample_time_us;
+	struct gpu_stats e;
+	fill(&e, gpu, n);
+	if(s->recv_time_ns != e.recv_time_ns || s->bus != e.bus || s->gaps != e.gaps ||
+			s->valid != e.valid || s->vram_mb != e.vram_mb || s->gtt_mb != e.gtt_mb ||
+			s->sclk != e.sclk || s->sclk_ghz != e.sclk_ghz) {
+		return false;
+	}
+	return memcmp(s->busy, e.busy, sizeof(e.busy)) == 0;
+}
+
+static void writer(int report_fd) {
+	struct gpu_shm_writer w;
+	if(gpu_shm_create(&w, name, GPUS) != 0) {
+		_exit(1);
+	}
+	struct gpu_stats s;
+	uint64_t n = 0;
+	for(const uint64_t end = monotonic_ms() + RUN_MS; monotonic_ms() < end; ) {
+		n++;
+		for(int gpu = 0; gpu < GPUS; ++gpu) {
+			fill(&s, gpu, n);
+			gpu_shm_publish(&w, gpu, &s);
+		}
+	}
+	if(write(report_fd, &n, sizeof(n)) != sizeof(n)) {
+		_exit(1);
+	}
+	gpu_shm_destroy(&w);
+	_exit(0);
+}
+
+/* polls latest sample, as a status bar would */
+static void *latest_thread(void *arg) {
+	const int gpu = (int)(intptr_t)arg;
+	uint64_t last = 0, n_reads = 0;
+	struct gpu_shm_sample s;
+	while(!gpu_shm_closed(&reader)) {
+		const uint64_t n = gpu_shm_latest(&reader, gpu, &s);
+		if(n == 0) {
+			continue;
+		}
+		if(s.sample_time_us != n || !consistent(&s, gpu)) {
+			atomic_fetch_add(&torn, 1);
+		}
+		if(n < last) {
+			atomic_fetch_add(&backwards, 1);
+		}
+		last = n;
+		n_reads++;
+	}
+	atomic_fetch_add(&reads, n_reads);
+	return NULL;
+}
+
+/* follows every sample, as a logger would; lapped samples are skipped */
+static void *follow_thread(void *arg) {
+	const int gpu = (int)(intptr_t)arg;
+	uint64_t next = 1, n_reads = 0, n_missed = 0;
+	struct gpu_shm_sample s;
+	while(!gpu_shm_closed(&reader)) {
+		const uint64_t head = atomic_load(&((struct gpu_shm_gpu *)&reader.gpus[gpu])->head);
+		if(head >= next + GPU_SHM_RING_SIZE) {
+			n_missed += head - GPU_SHM_RING_SIZE + 1 - next;
+			next = head - GPU_SHM_RING_SIZE + 1;
+		}
+		for(; next <= head; ++next) {
+			if(!gpu_shm_read(&reader, gpu, next, &s)) {
+				n_missed++;	// overwritten while we got to it
+				continue;
+			}
+			if(s.sample_time_us != next || !consistent(&s, gpu)) {
+				atomic_fetch_add(&torn, 1);
+			}
+			n_reads++;
+		}
+	}
+	atomic_fetch_add(&reads, n_reads);
+	atomic_fetch_add(&missed, n_missed);
+	return NULL;
+}
+
+int main(void) {
+	snprintf(name, sizeof(name), "/gkrellmradeontop-test-%d", (int)getpid());
+	CHECK_INT(gpu_shm_attach(&reader, name), -1);
+
+	int report[2];
+	CHECK(pipe(report) == 0);
+	const pid_t pid = fork();
+	if(pid == 0) {
+		close(report[0]);
+		writer(report[1]);
+	}
+	close(report[1]);
+
+	const uint64_t deadline = monotonic_ms() + 2000;
+	while(gpu_shm_attach(&reader, name) != 0 && monotonic_ms() < deadline) {
+		usleep(1000);
+	}
+	CHECK(reader.header != NULL);
+	if(!reader.header) {
+		kill(pid, SIGKILL);
+		return check_report("shm");
+	}
+	CHECK_INT(reader.header->gpu_count, GPUS);
+	CHECK_INT(reader.header->writer_pid, pid);
+
+	pthread_t threads[GPUS * 2];
+	for(int gpu = 0; gpu < GPUS; ++gpu) {
+		pthread_create(&threads[gpu * 2], NULL, latest_thread, (void *)(intptr_t)gpu);
+		pthread_create(&threads[gpu * 2 + 1], NULL, follow_thread, (void *)(intptr_t)gpu);
+	}
+	for(int i = 0; i < GPUS * 2; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+
+	uint64_t written = 0;
+	CHECK(read(report[0], &written, sizeof(written)) == sizeof(written));
+	int status;
+	CHECK(waitpid(pid, &status, 0) == pid);
+	CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	printf("shm: %llu samples written per GPU, %llu read, %llu lapped\n",
+			(unsigned long long)written, (unsigned long long)atomic_load(&reads),
+			(unsigned long long)atomic_load(&missed));
+	CHECK(gpu_shm_closed(&reader));
+	CHECK(atomic_load(&reads) > 0);
+	CHECK_INT(atomic_load(&torn), 0);
+	CHECK_INT(atomic_load(&backwards), 0);
+
+	// mapping outlives writer, last samples are still there
+	struct gpu_shm_sample s;
+	for(int gpu = 0; gpu < GPUS; ++gpu) {
+		CHECK_INT(gpu_shm_latest(&reader, gpu, &s), written);
+		CHECK(consistent(&s, gpu));
+		CHECK(!gpu_shm_read(&reader, gpu, written - GPU_SHM_RING_SIZE, &s));
+		CHECK(gpu_shm_read(&reader, gpu, written - GPU_SHM_RING_SIZE + 1, &s));
+	}
+	CHECK(!gpu_shm_read(&reader, GPUS, 1, &s));
+	gpu_shm_detach(&reader);
+
+	// segment name is gone with its writer
+	CHECK_INT(gpu_shm_attach(&reader, name), -1);
+	return check_report("shm");
+}
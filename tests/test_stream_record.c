@@ -0,0 +1,116 @@
+/* Recording of radeontop output read back whole and in order, with its
+ * delays; a burst larger than the queue drops whole chunks without
+ * blocking the caller, and recording doesn't open what it can't create. */
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "check.h"
+#include "stream_record.h"
+
+#define CHUNKS 1000
+
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/* chunk i is 1 to 4000 bytes of one letter, both picked by i */
+static size_t make_chunk(char *buf, unsigned int i) {
+	const size_t len = (size_t)i % 4000 + 1;
+	memset(buf, 'a' + (int)(i % 26), len);
+	return len;
+}
+
+static struct stream_writer w;
+
+int main(void) {
+	char path[] = "/tmp/test_stream_record.XXXXXX";
+	int fd = mkstemp(path);
+	CHECK(fd >= 0);
+	close(fd);
+
+	static char buf[STREAM_MAX_CHUNK], want[STREAM_MAX_CHUNK];
+	struct stream_reader r;
+	uint32_t delay_us;
+	ssize_t len;
+
+	// chunks 1 ms apart, one of them over STREAM_MAX_CHUNK is split
+	CHECK_INT(stream_writer_open(&w, path), 0);
+	uint64_t now = monotonic_ns();
+	for(unsigned int i = 0; i < 100; ++i) {
+		now += 1000000;
+		const size_t n = make_chunk(want, i);
+		stream_writer_chunk(&w, now, want, n);
+	}
+	static char big[STREAM_MAX_CHUNK + 100];
+	memset(big, 'z', sizeof(big));
+	stream_writer_chunk(&w, now + 5000000, big, sizeof(big));
+	stream_writer_close(&w);
+	CHECK_INT(atomic_load(&w.dropped), 0);
+
+	CHECK_INT(stream_reader_open(&r, path), 0);
+	for(unsigned int i = 0; i < 100; ++i) {
+		len = stream_reader_next(&r, &delay_us, buf);
+		const size_t n = make_chunk(want, i);
+		CHECK_INT(len, n);
+		CHECK(len == (ssize_t)n && !memcmp(buf, want, n));
+		if(i > 0) {
+			CHECK_INT(delay_us, 1000);
+		}
+	}
+	CHECK_INT(stream_reader_next(&r, &delay_us, buf), STREAM_MAX_CHUNK);
+	CHECK_INT(delay_us, 5000);
+	CHECK_INT(stream_reader_next(&r, &delay_us, buf), 100);
+	CHECK_INT(delay_us, 0);
+	CHECK_INT(stream_reader_next(&r, &delay_us, buf), 0);
+	stream_reader_close(&r);
+
+	// more than queue holds at once: caller never waits, whole chunks drop
+	CHECK_INT(stream_writer_open(&w, path), 0);
+	now = monotonic_ns();
+	uint64_t slowest = 0;
+	for(unsigned int i = 0; i < CHUNKS; ++i) {
+		const size_t n = make_chunk(want, i);
+		const uint64_t t = monotonic_ns();
+		stream_writer_chunk(&w, now + i * 1000ull, want, n);
+		const uint64_t spent = monotonic_ns() - t;
+		slowest = spent > slowest ? spent : slowest;
+	}
+	stream_writer_close(&w);
+	const unsigned int dropped = atomic_load(&w.dropped);
+	printf("stream_record: %u of %u chunks dropped, slowest queued in %llu us\n",
+			dropped, CHUNKS, (unsigned long long)slowest / 1000);
+	CHECK(dropped > 0);
+	CHECK(slowest < 10000000);
+
+	// what was kept is intact and in order; delays cover dropped chunks
+	CHECK_INT(stream_reader_open(&r, path), 0);
+	unsigned int kept = 0, next = 0;
+	uint64_t at_us = 0, first_us = 0;
+	while((len = stream_reader_next(&r, &delay_us, buf)) > 0) {
+		at_us += delay_us;
+		if(kept == 0) {
+			first_us = at_us;	// first chunk always fits
+		}
+		// chunk number from its time, as they were written 1 us apart
+		const unsigned int i = (unsigned int)(at_us - first_us);
+		CHECK(i >= next);
+		CHECK_INT(len, make_chunk(want, i));
+		CHECK(!memcmp(buf, want, (size_t)len));
+		next = i + 1;
+		kept++;
+	}
+	CHECK_INT(len, 0);
+	CHECK_INT(kept + dropped, CHUNKS);
+	stream_reader_close(&r);
+
+	// nothing is recorded where file can't be created
+	CHECK_INT(stream_writer_open(&w, "/nonexistent/dir/rec"), -1);
+	CHECK(w.thread == 0);
+	stream_writer_chunk(&w, monotonic_ns(), "x", 1);
+	stream_writer_close(&w);
+
+	unlink(path);
+	return check_report("stream_record");
+}
@@ -0,0 +1,205 @@
+/* Restart policy and stderr capture, then fixture radeontops that crash,
+ * hang and flood stderr, run as the sampler loop runs radeontop. */
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include "check.h"
+#include "radeontop_child.h"
+#include "line_reader.h"
+#include "radeontop_parse.h"
+
+#define STOP_MAX_MS 200
+
+struct run {
+	struct radeontop_child child;
+	struct line_reader lines;
+	struct stderr_ring stderr_ring;
+	unsigned int samples;
+	bool exited;
+};
+
+static uint64_t monotonic_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void check_supervisor(void) {
+	struct supervisor sv;
+	supervisor_init(&sv, 1);
+
+	// backoff grows with equal jitter: delay is within [d/2, d] of 1, 2, 4, ... s
+	uint64_t now = 1000000;
+	for(unsigned int i = 0; i < 4; ++i) {
+		supervisor_started(&sv, now);
+		const uint64_t d = (uint64_t)SUPERVISOR_BASE_DELAY_MS << i;
+		const uint64_t delay = supervisor_failed(&sv, now);
+		CHECK(delay >= d / 2 && delay <= d);
+		CHECK(!sv.crash_loop);
+		now += delay + 20000;	// failures 20 s apart aren't a loop yet
+	}
+
+	// running long enough clears it
+	supervisor_started(&sv, now);
+	supervisor_running(&sv, now + SUPERVISOR_STABLE_MS);
+	CHECK_INT(sv.failures, 0);
+	CHECK(supervisor_failed(&sv, now + SUPERVISOR_STABLE_MS) <= SUPERVISOR_BASE_DELAY_MS);
+
+	// 5 quick failures are a crash loop, held at maximum delay
+	supervisor_init(&sv, 7);
+	now = 1000000;
+	for(unsigned int i = 0; i < SUPERVISOR_LOOP_FAILURES; ++i) {
+		supervisor_started(&sv, now);
+		const uint64_t delay = supervisor_failed(&sv, now + 100);
+		now += 1000;
+		CHECK(sv.crash_loop == (i == SUPERVISOR_LOOP_FAILURES - 1));
+		if(sv.crash_loop) {
+			CHECK(delay >= SUPERVISOR_MAX_DELAY_MS / 2);
+		}
+	}
+	// a short run doesn't end it, a stable one does
+	supervisor_started(&sv, now);
+	supervisor_failed(&sv, now + 5000);
+	CHECK(sv.crash_loop);
+	supervisor_started(&sv, now + 100000);
+	supervisor_running(&sv, now + 100000 + SUPERVISOR_STABLE_MS);
+	CHECK(!sv.crash_loop);
+
+	// backoff never exceeds maximum, however long it fails
+	supervisor_init(&sv, 3);
+	for(unsigned int i = 0; i < 40; ++i) {
+		now += 200000;
+		supervisor_started(&sv, now);
+		CHECK(supervisor_failed(&sv, now + 10) <= SUPERVISOR_MAX_DELAY_MS);
+	}
+
+	// two instances with other seeds restart apart
+	struct supervisor a, b;
+	supervisor_init(&a, 11);
+	supervisor_init(&b, 12);
+	for(int i = 0; i < 3; ++i) {
+		supervisor_failed(&a, 1000000);
+		supervisor_failed(&b, 1000000);
+	}
+	CHECK(supervisor_failed(&a, 1000000) != supervisor_failed(&b, 1000000));
+}
+
+static void check_stderr_ring(void) {
+	struct stderr_ring ring = {0};
+	char line[64];
+	CHECK_INT(stderr_ring_last_line(&ring, line, sizeof(line)), 0);
+
+	stderr_ring_append(&ring, "first\nsecond\r\n\n", 15);
+	stderr_ring_last_line(&ring, line, sizeof(line));
+	CHECK_STR(line, "second");
+
+	// line split over appends and ring wraparound, control chars blanked
+	char big[STDERR_RING_SIZE + 100];
+	memset(big, 'x', sizeof(big));
+	big[sizeof(big) - 1] = '\n';
+	stderr_ring_append(&ring, big, sizeof(big));
+	stderr_ring_append(&ring, "cannot\topen ", 12);
+	stderr_ring_append(&ring, "device\n", 7);
+	stderr_ring_last_line(&ring, line, sizeof(line));
+	CHECK_STR(line, "cannot open device");
+
+	// too long line keeps its end
+	stderr_ring_append(&ring, big, sizeof(big) - 1);
+	stderr_ring_append(&ring, "END", 3);
+	CHECK_INT(stderr_ring_last_line(&ring, line, 8), 7);
+	CHECK_STR(line, "xxxxEND");
+}
+
+/* services child until it exits or timeout_ms passes */
+static void run_for(struct run *r, int timeout_ms, bool drain) {
+	const uint64_t end = monotonic_ms() + (uint64_t)timeout_ms;
+	uint64_t now;
+	while(!r->exited && (now = monotonic_ms()) < end) {
+		struct pollfd fds[3] = {
+			{ .fd = r->child.out_fd, .events = POLLIN },
+			{ .fd = drain ? r->child.err_fd : -1, .events = POLLIN },
+			{ .fd = r->child.pidfd, .events = POLLIN },
+		};
+		if(poll(fds, 3, (int)(end - now)) <= 0) {
+			continue;
+		}
+		if(fds[1].revents && r->child.err_fd >= 0) {
+			radeontop_child_drain_stderr(&r->child, &r->stderr_ring);
+		}
+		if(fds[0].revents || fds[2].revents) {
+			ssize_t n;
+			while((n = line_reader_fill(&r->lines, r->child.out_fd)) > 0) {
+				const char *line;
+				size_t len;
+				struct gpu_stats stats;
+				while(line_reader_next(&r->lines, &line, &len)) {
+					r->samples += radeontop_parse_line(line, len, &stats);
+				}
+			}
+			if(n == 0) {
+				// rest of stderr is already in the pipe
+				if(drain && r->child.err_fd >= 0) {
+					radeontop_child_drain_stderr(&r->child, &r->stderr_ring);
+				}
+				r->exited = true;
+			}
+		}
+	}
+}
+
+static void start(struct run *r, const char *script) {
+	memset(r, 0, sizeof(*r));
+	line_reader_init(&r->lines);
+	CHECK_INT(radeontop_child_spawn(&r->child, (const char *[]){ script, NULL }), 0);
+}
+
+static uint64_t stop(struct run *r) {
+	const uint64_t start_ms = monotonic_ms();
+	radeontop_child_stop(&r->child);
+	return monotonic_ms() - start_ms;
+}
+
+int main(void) {
+	check_supervisor();
+	check_stderr_ring();
+
+	char last[128];
+	struct run r;
+
+	// crash: samples before it and its last words are kept
+	start(&r, "./tests/fixtures/crash.sh");
+	run_for(&r, 2000, true);
+	CHECK(r.exited);
+	CHECK_INT(r.samples, 2);
+	stderr_ring_last_line(&r.stderr_ring, last, sizeof(last));
+	CHECK_STR(last, "Failed to open DRM node, no VRAM support.");
+	stop(&r);
+
+	// hang: output stops but child stays; stop kills it though it ignores SIGTERM
+	start(&r, "./tests/fixtures/hang.sh");
+	run_for(&r, 300, true);
+	CHECK(!r.exited);
+	CHECK_INT(r.samples, 1);
+	const uint64_t ms = stop(&r);
+	printf("stop, hung: %llu ms\n", (unsigned long long)ms);
+	CHECK(ms < STOP_MAX_MS);
+
+	// stderr flood: blocks child unless stderr is drained
+	start(&r, "./tests/fixtures/spam.sh");
+	run_for(&r, 500, false);
+	CHECK(!r.exited);
+	CHECK(r.samples < 200);
+	stop(&r);
+
+	start(&r, "./tests/fixtures/spam.sh");
+	run_for(&r, 5000, true);
+	CHECK(r.exited);
+	CHECK_INT(r.samples, 200);
+	CHECK(r.stderr_ring.written > 150000);
+	stderr_ring_last_line(&r.stderr_ring, last, sizeof(last));
+	CHECK_STR(last, "done spamming");
+	stop(&r);
+
+	return check_report("supervisor");
+}
@@ -0,0 +1,198 @@
+/* amdgpu sysfs and hwmon readers against the fixture tree in
+ * tests/fixtures/sysfs, and runtime PM status followed through suspend and
+ * resume in a scratch tree whose files are rewritten under the open fd. */
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "check.h"
+#include "gpu_sysfs.h"
+#include "gpu_pm.h"
+
+#define FIXTURE_ROOT "./tests/fixtures/sysfs"
+
+static char scratch[] = "/tmp/test_sysfs.XXXXXX";
+
+static void write_attr(const char *name, const char *content) {
+	char path[256];
+	snprintf(path, sizeof(path), "%s/card0/device/power/%s", scratch, name);
+	FILE *f = fopen(path, "w");
+	CHECK(f != NULL);
+	if(f) {
+		fputs(content, f);
+		fclose(f);
+	}
+}
+
+static void remove_attr(const char *name) {
+	char path[256];
+	snprintf(path, sizeof(path), "%s/card0/device/power/%s", scratch, name);
+	unlink(path);
+}
+
+static void check_sysfs(void) {
+	struct gpu_sysfs sysfs;
+	struct gpu_stats st;
+	char pdev[64];
+
+	// discrete GPU with every file
+	CHECK_INT(gpu_sysfs_open(&sysfs, FIXTURE_ROOT, "card0"), 0);
+	CHECK(gpu_sysfs_sample(&sysfs, &st));
+	CHECK_FLOAT(st.busy[GPU_BLOCK_GPU], 37, 0);
+	CHECK_FLOAT(st.sclk, 50, 1e-4);
+	CHECK_FLOAT(st.sclk_ghz, 1.2, 1e-6);
+	CHECK_FLOAT(st.mclk, 100, 1e-4);
+	CHECK_FLOAT(st.mclk_ghz, 0.875, 1e-6);
+	CHECK_FLOAT(st.vram_mb, 1024, 1e-3);
+	CHECK_FLOAT(st.vram, 12.5, 1e-4);
+	CHECK_FLOAT(st.gtt_mb, 50, 1e-3);
+	CHECK_FLOAT(st.gtt, 12.5, 1e-4);
+	const uint32_t all = GPU_FIELD_BIT(GPU_BLOCK_GPU) | GPU_FIELD_BIT(GPU_FIELD_TIMESTAMP) |
+		GPU_FIELD_BIT(GPU_FIELD_SCLK) | GPU_FIELD_BIT(GPU_FIELD_MCLK) |
+		GPU_FIELD_BIT(GPU_FIELD_VRAM) | GPU_FIELD_BIT(GPU_FIELD_GTT);
+	CHECK_INT(st.valid, all);
+	CHECK(st.sample_time_us > 0);
+	// re-read from same fds
+	CHECK(gpu_sysfs_sample(&sysfs, &st));
+	CHECK_FLOAT(st.busy[GPU_BLOCK_GPU], 37, 0);
+	gpu_sysfs_close(&sysfs);
+	CHECK_INT(sysfs.busy_fd, -1);
+	CHECK_INT(sysfs.gtt_total_fd, -1);
+
+	// APU with load only
+	CHECK_INT(gpu_sysfs_open(&sysfs, FIXTURE_ROOT, "card1"), 0);
+	CHECK_INT(sysfs.sclk_fd, -1);
+	CHECK(gpu_sysfs_sample(&sysfs, &st));
+	CHECK_FLOAT(st.busy[GPU_BLOCK_GPU], 5, 0);
+	CHECK_INT(st.valid, GPU_FIELD_BIT(GPU_BLOCK_GPU) | GPU_FIELD_BIT(GPU_FIELD_TIMESTAMP));
+	gpu_sysfs_close(&sysfs);
+
+	CHECK_INT(gpu_sysfs_open(&sysfs, FIXTURE_ROOT, "card9"), -1);
+
+	// PCI address is the name device links to
+	gpu_sysfs_pdev(FIXTURE_ROOT, "card0", pdev, sizeof(pdev));
+	CHECK_STR(pdev, "0000:03:00.0");
+	gpu_sysfs_pdev(FIXTURE_ROOT, "card1", pdev, sizeof(pdev));
+	CHECK_STR(pdev, "");
+	gpu_sysfs_pdev(FIXTURE_ROOT, "card9", pdev, sizeof(pdev));
+	CHECK_STR(pdev, "");
+}
+
+static void check_hwmon(void) {
+	struct gpu_hwmon hwmon;
+	struct gpu_stats st = {0};
+
+	// sensors are taken by label, card0 lists junction first
+	CHECK_INT(gpu_hwmon_open(&hwmon, FIXTURE_ROOT, "card0"), 0);
+	gpu_hwmon_sample(&hwmon, &st);
+	CHECK_FLOAT(st.power_w, 42, 1e-4);
+	CHECK_FLOAT(st.power_cap_w, 150, 1e-4);
+	CHECK_FLOAT(st.temp_c[GPU_TEMP_EDGE], 51, 1e-4);
+	CHECK_FLOAT(st.temp_crit_c[GPU_TEMP_EDGE], 100, 1e-4);
+	CHECK_FLOAT(st.temp_c[GPU_TEMP_JUNCTION], 63.5, 1e-4);
+	CHECK_FLOAT(st.temp_crit_c[GPU_TEMP_JUNCTION], 110, 1e-4);
+	CHECK_FLOAT(st.temp_c[GPU_TEMP_MEM], 60, 1e-4);
+	CHECK_FLOAT(st.fan_rpm, 1250, 0);
+	CHECK_FLOAT(st.fan_max_rpm, 3300, 0);
+	const uint32_t all = GPU_FIELD_BIT(GPU_FIELD_POWER) | GPU_FIELD_BIT(GPU_FIELD_FAN) |
+		GPU_FIELD_BIT(GPU_FIELD_TEMP + GPU_TEMP_EDGE) |
+		GPU_FIELD_BIT(GPU_FIELD_TEMP + GPU_TEMP_JUNCTION) |
+		GPU_FIELD_BIT(GPU_FIELD_TEMP + GPU_TEMP_MEM);
+	CHECK_INT(st.valid, all);
+	// sampled again through the same fds, adding to other fields
+	st = (struct gpu_stats){ .valid = GPU_FIELD_BIT(GPU_BLOCK_GPU) };
+	gpu_hwmon_sample(&hwmon, &st);
+	CHECK_INT(st.valid, all | GPU_FIELD_BIT(GPU_BLOCK_GPU));
+	CHECK_FLOAT(st.power_w, 42, 1e-4);
+	gpu_hwmon_close(&hwmon);
+	CHECK_INT(hwmon.power_fd, -1);
+	CHECK_INT(hwmon.temp_fd[GPU_TEMP_MEM], -1);
+
+	// APU: power1_input, unlabeled temp1 is edge, no fan
+	st = (struct gpu_stats){0};
+	CHECK_INT(gpu_hwmon_open(&hwmon, FIXTURE_ROOT, "card1"), 0);
+	gpu_hwmon_sample(&hwmon, &st);
+	CHECK_FLOAT(st.power_w, 15, 1e-4);
+	CHECK_FLOAT(st.power_cap_w, 0, 0);
+	CHECK_FLOAT(st.temp_c[GPU_TEMP_EDGE], 45, 1e-4);
+	CHECK_FLOAT(st.temp_crit_c[GPU_TEMP_EDGE], 0, 0);
+	CHECK_INT(st.valid, GPU_FIELD_BIT(GPU_FIELD_POWER) | GPU_FIELD_BIT(GPU_FIELD_TEMP + GPU_TEMP_EDGE));
+	gpu_hwmon_close(&hwmon);
+
+	// no hwmon at all: nothing read, nothing valid
+	CHECK_INT(gpu_hwmon_open(&hwmon, FIXTURE_ROOT, "card9"), -1);
+	st = (struct gpu_stats){0};
+	gpu_hwmon_sample(&hwmon, &st);
+	CHECK_INT(st.valid, 0);
+}
+
+static void check_pm(void) {
+	struct gpu_pm pm;
+
+	CHECK_INT(gpu_pm_open(&pm, FIXTURE_ROOT, "card0"), 0);
+	CHECK_INT(pm.autosuspend_ms, 2000);
+	CHECK_INT(gpu_pm_status(&pm), GPU_PM_ACTIVE);
+	gpu_pm_close(&pm);
+	CHECK_INT(pm.status_fd, -1);
+	CHECK_INT(gpu_pm_status(&pm), GPU_PM_UNKNOWN);
+	CHECK_INT(gpu_pm_open(&pm, FIXTURE_ROOT, "card1"), -1);
+
+	CHECK(mkdtemp(scratch) != NULL);
+	char path[256];
+	snprintf(path, sizeof(path), "%s/card0", scratch);
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/card0/device", scratch);
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/card0/device/power", scratch);
+	mkdir(path, 0755);
+
+	// device without runtime PM
+	write_attr("runtime_status", "unsupported\n");
+	CHECK_INT(gpu_pm_open(&pm, scratch, "card0"), -1);
+	CHECK_INT(pm.status_fd, -1);
+
+	// autosuspend off, or its file missing, leaves default
+	write_attr("runtime_status", "active\n");
+	write_attr("autosuspend_delay_ms", "-1\n");
+	CHECK_INT(gpu_pm_open(&pm, scratch, "card0"), 0);
+	CHECK_INT(pm.autosuspend_ms, GPU_PM_DEFAULT_AUTOSUSPEND_MS);
+	gpu_pm_close(&pm);
+	remove_attr("autosuspend_delay_ms");
+	CHECK_INT(gpu_pm_open(&pm, scratch, "card0"), 0);
+	CHECK_INT(pm.autosuspend_ms, GPU_PM_DEFAULT_AUTOSUSPEND_MS);
+
+	// a suspend and resume as PM core reports it, seen through the open fd
+	static const struct {
+		const char *content;
+		enum gpu_pm_status status;
+	} steps[] = {
+		{ "active\n", GPU_PM_ACTIVE },
+		{ "suspending\n", GPU_PM_TRANSITION },
+		{ "suspended\n", GPU_PM_SUSPENDED },
+		{ "resuming\n", GPU_PM_TRANSITION },
+		{ "active\n", GPU_PM_ACTIVE },
+		{ "error\n", GPU_PM_UNKNOWN },
+		{ "", GPU_PM_UNKNOWN },
+		{ "suspended\n", GPU_PM_SUSPENDED },
+	};
+	for(size_t i = 0; i < sizeof(steps)/sizeof(steps[0]); ++i) {
+		write_attr("runtime_status", steps[i].content);
+		CHECK_INT(gpu_pm_status(&pm), steps[i].status);
+	}
+	gpu_pm_close(&pm);
+
+	remove_attr("runtime_status");
+	CHECK_INT(gpu_pm_open(&pm, scratch, "card0"), -1);
+	rmdir(path);
+	snprintf(path, sizeof(path), "%s/card0/device", scratch);
+	rmdir(path);
+	snprintf(path, sizeof(path), "%s/card0", scratch);
+	rmdir(path);
+	rmdir(scratch);
+}
+
+int main(void) {
+	check_sysfs();
+	check_hwmon();
+	check_pm();
+	return check_report("sysfs");
+}